@@ -1,4 +1,5 @@
 #include <render/render.h>
+#include <scene/scenesnapshot.h>
 
 #include <cxxopts.hpp>
 #include <iostream>
@@ -15,6 +16,11 @@ int main(int argc, char** argv)
         ("t, texture", "texture path", cxxopts::value<std::string>()->default_value("misc/"))
                 ("width", "window width", cxxopts::value<uint32_t>()->default_value("800"))
                 ("height", "window height", cxxopts::value<uint32_t>()->default_value("600"))
+                ("c, convert", "save model as binary scene snapshot (.nevk) and exit", cxxopts::value<std::string>()->default_value(""))
+                ("o, optimize", "reorder mesh triangles and vertices for vertex cache at import")
+                ("overdraw", "reorder mesh triangles for overdraw too, implies --optimize")
+                ("vertex-layout", "GPU vertex layout: full (24 bytes) or compact (16 bytes, quantized positions)", cxxopts::value<std::string>()->default_value("full"))
+                ("vertex-pulling", "fetch and decode vertices in shaders from storage buffers instead of vertex input")
                     ("h, help", "Print usage");
 
     options.parse_positional({ "m", "t" });
@@ -39,6 +45,29 @@ int main(int argc, char** argv)
         std::cerr << "texture file doesn't exist";
         exit(0);
     }
+    nevk::VertexLayout vertexLayout;
+    if (!nevk::findVertexLayout(result["vertex-layout"].as<std::string>(), vertexLayout))
+    {
+        std::cerr << "unknown vertex layout";
+        exit(0);
+    }
+
+    // convert model to snapshot, no window or GPU needed
+    std::string snapshot(result["convert"].as<std::string>());
+    if (!snapshot.empty())
+    {
+        nevk::Scene scene;
+        nevk::ModelLoader loader;
+        loader.setMeshOptimization(result.count("optimize") > 0, result.count("overdraw") > 0);
+        const bool isObj = fs::path(mesh).extension() == ".obj";
+        const bool loaded = isObj ? loader.loadModel(mesh, texture, scene) : loader.loadModelGltf(mesh, scene);
+        if (!loaded || !nevk::SceneSnapshot::save(scene, snapshot))
+        {
+            std::cerr << "conversion failed";
+            return 1;
+        }
+        return 0;
+    }
 
     // initialise & run render
     Render r;
@@ -47,6 +76,10 @@ int main(int argc, char** argv)
     r.MTL_PATH = texture;
     r.WIDTH = result["width"].as<uint32_t>();
     r.HEIGHT = result["height"].as<uint32_t>();
+    r.OPTIMIZE_MESHES = result.count("optimize") > 0;
+    r.OPTIMIZE_OVERDRAW = result.count("overdraw") > 0;
+    r.VERTEX_LAYOUT = vertexLayout;
+    r.VERTEX_PULLING = result.count("vertex-pulling") > 0;
 
     r.run();
 
@@ -1,29 +1,87 @@
 #pragma once
 
 #include "scene/scene.h"
-#include "texturemanager/texturemanager.h"
+#include "scene/vertexlayout.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 namespace nevk
 {
 
+// Vertex attribute packing, layouts match shaders/pack.h.
+// Normals and tangents are octahedral: 16 bits per axis for normal, 15 bits per axis and handedness in bit 30 for tangent.
+// Input does not need to be normalized, zero vector is packed as 0
+uint32_t packUV(const glm::float2& uv);
+uint32_t packNormal(const glm::float3& normal);
+uint32_t packTangent(const glm::float3& tangent, float handedness);
+glm::float2 unpackUV(uint32_t val);
+glm::float3 unpackNormal(uint32_t val);
+glm::float4 unpackTangent(uint32_t val);
+
+// Batched versions over vertex arrays (SSE/AVX with scalar tail), results are equal to single vertex functions
+// when modelloader.cpp is built without FP contraction, as CMakeLists.txt does
+void packNormals(const glm::float3* normals, size_t count, Scene::Vertex* vertices);
+// w of tangent is bitangent handedness
+void packTangents(const glm::float4* tangents, size_t count, Scene::Vertex* vertices);
+void unpackNormals(const Scene::Vertex* vertices, size_t count, glm::float3* normals);
+void unpackTangents(const Scene::Vertex* vertices, size_t count, glm::float4* tangents);
+
+// Tangent of CompactVertex: angle around unpacked normal in 15 bits, handedness in bit 15
+uint16_t packTangentAngle(const glm::float3& normal, const glm::float4& tangent);
+glm::float4 unpackTangentAngle(const glm::float3& normal, uint16_t val);
+// Scene vertices in compact layout, positions are quantized to bounds of mesh owning them (see getPositionQuantization).
+// Vertices of no mesh are zero
+std::vector<CompactVertex> packCompactVertices(const std::vector<Mesh>& meshes, const Scene::Vertex* vertices, size_t count);
+
+// Image decoded by import, index in image list is texture id used by scene materials.
+// Import stays on CPU, images are uploaded to GPU by separate stage (see TextureManager::loadTextureBatch)
+struct ImportedImage
+{
+    std::string name; // image file path, or model path with image index for embedded images
+    std::vector<uint8_t> pixels; // RGBA8, single white texel if image could not be decoded
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
 class ModelLoader
 {
 private:
-    nevk::TextureManager* mTexManager = nullptr;
+    bool mOptimizeVertexCache = false;
+    bool mOptimizeOverdraw = false;
 
 public:
-    explicit ModelLoader(nevk::TextureManager* texManager)
-        : mTexManager(texManager){};
 
-    bool loadModel(const std::string& MODEL_PATH, const std::string& MTL_PATH, nevk::Scene& mScene);
+    // Optional import step per mesh: triangles are reordered for post-transform vertex cache
+    // and optionally for overdraw, again within every meshlet, then vertices for fetch locality.
+    // ACMR and ATVR are reported for uploaded order
+    void setMeshOptimization(const bool vertexCache, const bool overdraw)
+    {
+        mOptimizeVertexCache = vertexCache || overdraw;
+        mOptimizeOverdraw = overdraw;
+    }
+
+    // images may be null, then they are not decoded and only texture paths are kept in scene
+    bool loadModel(const std::string& MODEL_PATH, const std::string& MTL_PATH, nevk::Scene& mScene, std::vector<ImportedImage>* images = nullptr);
+
+    bool loadModelGltf(const std::string& modelPath, nevk::Scene& mScene, std::vector<ImportedImage>* images = nullptr);
 
-    bool loadModelGltf(const std::string& modelPath, nevk::Scene& mScene);
+    /// <summary>
+    /// Merges bitwise identical vertices and remaps indices, keeps order of first occurrence
+    /// </summary>
+    /// <param name="vertices">vertices, shrunk to unique ones</param>
+    /// <param name="indices">indices into vertices, remapped in place</param>
+    /// <returns>Number of unique vertices</returns>
+    static size_t weldVertices(std::vector<Scene::Vertex>& vertices, std::vector<uint32_t>& indices);
 
-    // TODO: could be static
-    void computeTangent(std::vector<Scene::Vertex>& _vertices,
-                        const std::vector<uint32_t>& _indices) const;
+    /// <summary>
+    /// Computes per-vertex tangents of indexed mesh: unit face tangents are accumulated with corner angle weights,
+    /// then orthogonalized to vertex normal. Handedness is stored in bit 30, see packTangent()
+    /// </summary>
+    /// <param name="vertices">vertices with positions, normals and UVs, tangents are overwritten</param>
+    /// <param name="indices">triangle list</param>
+    /// <returns>Nothing</returns>
+    static void computeTangents(std::vector<Scene::Vertex>& vertices, const std::vector<uint32_t>& indices);
 };
 } // namespace nevk
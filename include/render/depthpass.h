@@ -3,6 +3,7 @@
 #include "resourcemanager/resourcemanager.h"
 
 #include <scene/scene.h>
+#include <scene/vertexlayout.h>
 #include <vulkan/vulkan.h>
 
 #include <vector>
@@ -32,6 +33,7 @@ private:
     VkPipelineLayout mPipelineLayout;
     VkShaderModule mSS;
     VkBuffer mInstanceBuffer = VK_NULL_HANDLE;
+    VkBuffer mPositionBuffer = VK_NULL_HANDLE; // read by shader with vertex pulling
 
     ResourceManager* mResMngr;
 
@@ -70,6 +72,9 @@ private:
     bool needDesciptorSetUpdate = true;
     int imageviewcounter = 0;
 
+    VertexLayout mVertexLayout = VertexLayout::eFull;
+    bool mVertexPulling = false;
+
 public:
     DepthPass(/* args */);
     ~DepthPass();
@@ -86,15 +91,29 @@ public:
     float zFar = 50.f;
 
     void createShadowPass();
+    // must be set before init(), shader has to be compiled for the same layout
+    void setVertexLayout(VertexLayout layout)
+    {
+        mVertexLayout = layout;
+    }
+    // positions are read from storage buffer instead of vertex input, set before init()
+    void setVertexPulling(bool enable)
+    {
+        mVertexPulling = enable;
+    }
     void init(VkDevice& device, bool enableValidation, const char* ssCode, uint32_t ssCodeSize, VkDescriptorPool descpool,
         ResourceManager* resMngr, uint32_t width, uint32_t height);
-    void record(VkCommandBuffer& cmd, VkBuffer vertexBuffer, VkBuffer indexBuffer, nevk::Scene& scene, 
-        uint32_t width, uint32_t height, uint32_t imageIndex, uint32_t cameraIndex);
+    // LOD is selected for camera, shadow map resolution does not matter for it
+    // positionBuffer is position stream of vertex layout, with vertex pulling it is read through setPositionBuffer() instead.
+    // indexBuffer16 holds meshes with 16 bit indices, see MeshDraw
+    void record(VkCommandBuffer& cmd, VkBuffer positionBuffer, VkBuffer indexBuffer, VkBuffer indexBuffer16, const std::vector<MeshDraw>& meshDraws, nevk::Scene& scene,
+        uint32_t width, uint32_t height, uint32_t imageIndex, const Scene::VisibleInstances& visible, Camera& camera, uint32_t cameraHeight);
     void createFrameBuffers(VkImageView& shadowImageView, uint32_t width, uint32_t height);
     void onDestroy();
 
     void updateUniformBuffer(uint32_t currentImage, const glm::float4x4& lightSpaceMatrix);
     
     void setInstanceBuffer(VkBuffer instanceBuffer);
+    void setPositionBuffer(VkBuffer positionBuffer);
 };
 } // namespace nevk
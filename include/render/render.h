@@ -21,12 +21,15 @@
 #include <resourcemanager/resourcemanager.h>
 #include <scene/scene.h>
 #include <shadermanager/ShaderManager.h>
+#include <texturemanager/texturemanager.h>
 #include <ui/ui.h>
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <future>
 #include <memory>
 #include <optional>
 #include <stdexcept>
@@ -37,6 +40,9 @@ const int MAX_FRAMES_IN_FLIGHT = 3;
 const uint32_t SHADOW_MAP_WIDTH = 1024;
 const uint32_t SHADOW_MAP_HEIGHT = 1024;
 
+// Geometry of loaded scene is uploaded in batches of whole meshes of about this size
+const uint64_t GEOMETRY_UPLOAD_BATCH_SIZE = 8 * 1024 * 1024;
+
 const std::vector<const char*> validationLayers = {
     "VK_LAYER_KHRONOS_validation"
 };
@@ -56,6 +62,18 @@ const bool enableValidationLayers = true;
 #endif
 
 
+// This struct should match shader's version
+struct InstanceConstants
+{
+    glm::float4x4 model;
+    glm::float4x4 normalMatrix;
+    glm::float3 posScale; // dequantization of compact vertex positions, see nevk::getPositionQuantization()
+    int32_t materialId;
+    glm::float3 posBias;
+    uint32_t vertexLayout; // nevk::VertexLayout of mesh vertices, decoded by shaders with vertex pulling
+};
+static_assert(sizeof(InstanceConstants) == 160, "InstanceConstants must match std430 layout of shader struct");
+
 struct QueueFamilyIndices
 {
     std::optional<uint32_t> graphicsFamily;
@@ -89,6 +107,12 @@ public:
     std::string MTL_PATH;
     uint32_t WIDTH;
     uint32_t HEIGHT;
+    bool OPTIMIZE_MESHES = false;
+    bool OPTIMIZE_OVERDRAW = false;
+    // layout of GPU vertex buffer, selects shader variant and pipeline vertex input
+    nevk::VertexLayout VERTEX_LAYOUT = nevk::VertexLayout::eFull;
+    // shaders fetch vertices from storage buffers and decode any layout, pipelines have no vertex input
+    bool VERTEX_PULLING = false;
 
     void initWindow();
     void initVulkan();
@@ -128,19 +152,39 @@ private:
 
     nevk::RenderPass mPass;
     nevk::RenderPass mPbrPass;
-    nevk::ModelLoader* modelLoader = nullptr;
     nevk::ComputePass mComputePass;
     nevk::DepthPass mDepthPass;
 
+    // views of visibility stage, order is fixed so per view sort history survives between frames
+    enum ViewIndex : uint32_t
+    {
+        eCameraView = 0,
+        eLightView = 1,
+        eViewCount
+    };
+    std::vector<nevk::Scene::View> mViews;
+
     struct SceneRenderData
     {
         uint32_t cameraIndex = 0;
         uint32_t mIndicesCount = 0;
-        uint32_t mInstanceCount = 0;
+        uint32_t mInstanceCount = 0; // capacity of instance buffer, grown in drawFrame() when instances are added
         nevk::Buffer* mVertexBuffer = nullptr;
+        nevk::Buffer* mPositionBuffer = nullptr; // positions only for depth passes, see VertexLayoutDesc::positionStride
         nevk::Buffer* mMaterialBuffer = nullptr;
-        nevk::Buffer* mIndexBuffer = nullptr;
+        nevk::Buffer* mIndexBuffer = nullptr; // 32 bit mesh local indices
+        nevk::Buffer* mIndexBuffer16 = nullptr; // 16 bit mesh local indices of meshes with fewer than 65536 vertices
         nevk::Buffer* mInstanceBuffer = nullptr;
+        nevk::Buffer* mMeshletBuffer = nullptr; // Scene::Meshlet records, index ranges are relative to MeshDraw::firstIndex[0]
+        // texture of texture manager per scene texture id, materials are remapped on upload. Empty keeps ids as they are
+        std::vector<int> mTextureIds;
+        // where meshes are in index buffers, set before scene is rendered and fixed until compaction
+        std::vector<nevk::MeshDraw> mMeshDraws;
+        // meshes [0; count) have vertices and indices uploaded, others are not drawn while geometry streams in
+        std::atomic<uint32_t> mResidentMeshCount{ 0 };
+        // persistently mapped upload ring for dirty instances, slot per frame in flight
+        nevk::Buffer* mInstanceStaging[MAX_FRAMES_IN_FLIGHT] = {};
+        uint32_t mInstanceStagingCapacity[MAX_FRAMES_IN_FLIGHT] = {};
 
         nevk::ResourceManager* mResManager = nullptr;
         explicit SceneRenderData(nevk::ResourceManager* resManager)
@@ -154,10 +198,18 @@ private:
             {
                 mResManager->destroyBuffer(mVertexBuffer);
             }
+            if (mPositionBuffer)
+            {
+                mResManager->destroyBuffer(mPositionBuffer);
+            }
             if (mIndexBuffer)
             {
                 mResManager->destroyBuffer(mIndexBuffer);
             }
+            if (mIndexBuffer16)
+            {
+                mResManager->destroyBuffer(mIndexBuffer16);
+            }
             if (mMaterialBuffer)
             {
                 mResManager->destroyBuffer(mMaterialBuffer);
@@ -166,12 +218,54 @@ private:
             {
                 mResManager->destroyBuffer(mInstanceBuffer);
             }
+            if (mMeshletBuffer)
+            {
+                mResManager->destroyBuffer(mMeshletBuffer);
+            }
+            for (nevk::Buffer* staging : mInstanceStaging)
+            {
+                if (staging)
+                {
+                    mResManager->destroyBuffer(staging);
+                }
+            }
         }
     };
 
     SceneRenderData* mCurrentSceneRenderData = nullptr;
     SceneRenderData* mDefaultSceneRenderData = nullptr;
 
+    // Scene built on loader thread: parsed, textures and small buffers uploaded, geometry buffers allocated.
+    // It replaces current scene at start of frame, then its geometry streams in while it is rendered
+    struct SceneLoad
+    {
+        std::string modelPath;
+        nevk::Scene* scene = nullptr;
+        SceneRenderData* renderData = nullptr;
+        nevk::TextureManager* texManager = nullptr;
+        std::promise<bool> readyPromise;
+        std::future<bool> ready;
+        std::future<void> done; // geometry streamed, loader thread finished
+        std::atomic<bool> cancel{ false };
+        bool swapped = false;
+    };
+    std::unique_ptr<SceneLoad> mSceneLoad;
+    std::string mNextModelPath; // requested while other scene was loading
+    // loader has own workers, so visibility of frames does not queue behind import tasks
+    nevk::ThreadPool mLoadThreadPool;
+
+    // Replaced scene is kept until frames which may use it are finished
+    struct RetiredScene
+    {
+        nevk::Scene* scene;
+        SceneRenderData* renderData;
+        nevk::TextureManager* texManager;
+        uint32_t framesLeft;
+    };
+    std::vector<RetiredScene> mRetiredScenes;
+    std::vector<nevk::Scene::VisibleInstances> mResidentVisibility;
+    VkCommandPool mUploadCommandPool = VK_NULL_HANDLE;
+
     VkDescriptorPool mDescriptorPool;
 
     struct FrameData
@@ -200,11 +294,19 @@ private:
     nevk::Ui mUi;
     nevk::ShaderManager mShaderManager;
     nevk::Scene* mScene = nullptr;
+    nevk::ThreadPool mThreadPool;
     nevk::Scene* mDefaultScene = nullptr;
 
     bool isPBR = true;
 
+    // Starts loading on loader thread, current scene is rendered until new one is ready
     void loadScene(const std::string& modelPath);
+    // Runs on loader thread
+    void buildScene(SceneLoad& load);
+    // Called at start of frame: swaps in ready scene, finishes load and releases retired scenes
+    void updateSceneLoading();
+    void waitSceneLoading();
+    void releaseScene(RetiredScene& retired);
 
     void createDefaultScene();
 
@@ -256,16 +358,38 @@ private:
 
     void setCamera();
 
-    void createVertexBuffer(nevk::Scene& scene);
-    void createMaterialBuffer(nevk::Scene& scene);
-    void createIndexBuffer(nevk::Scene& scene);
-    void createInstanceBuffer(nevk::Scene& scene);
+    void createVertexBuffer(nevk::Scene& scene, SceneRenderData& data);
+    // Allocates vertex buffer and position stream of depth passes, both are filled together
+    void createVertexBuffers(size_t vertexCount, SceneRenderData& data);
+    void createMaterialBuffer(nevk::Scene& scene, SceneRenderData& data);
+    void createIndexBuffer(nevk::Scene& scene, SceneRenderData& data);
+    void createMeshletBuffer(nevk::Scene& scene, SceneRenderData& data);
+    // buffer holds at least capacity instances, all scene instances are uploaded
+    void createInstanceBuffer(nevk::Scene& scene, SceneRenderData& data, uint32_t capacity = 0);
+    void fillInstanceConstants(const nevk::Scene& scene, uint32_t instanceId, InstanceConstants& constants);
+    // Vertices in VERTEX_LAYOUT, compact ones are encoded into storage
+    const void* getLayoutVertices(const std::vector<nevk::Mesh>& meshes, const nevk::Scene::Vertex* vertices, size_t count, std::vector<nevk::CompactVertex>& storage);
+    // Copies data into device local buffer through temporary staging buffer
+    void uploadBuffer(nevk::Buffer* dst, VkDeviceSize dstOffset, const void* src, VkDeviceSize size);
+    // Uploads vertices and indices in mesh order into buffers of full size, in batches of GEOMETRY_UPLOAD_BATCH_SIZE.
+    // Vertices are in VERTEX_LAYOUT, position stream is extracted from them. Every batch publishes resident mesh count. Stops early when cancel is set
+    void streamGeometry(const std::vector<nevk::Mesh>& meshes, const void* vertices, const nevk::GpuIndices& indices, SceneRenderData& data, const std::atomic<bool>& cancel);
+    void createIndexBuffers(const nevk::GpuIndices& indices, SceneRenderData& data);
+    // Leaves only instances of resident meshes, while geometry of current scene streams in
+    const std::vector<nevk::Scene::VisibleInstances>& filterResident(const std::vector<nevk::Scene::VisibleInstances>& visibility);
+    // Records copies of dirty instances into instance buffer and resets scene dirty set
+    void updateInstanceBuffer(VkCommandBuffer& cmd, nevk::Scene& scene, uint32_t frameIndex);
+    // Upload stage of import: decoded images become textures. Returns texture per image,
+    // images with same name share texture, so ids may differ from image order
+    std::vector<int> uploadTextures(const std::vector<nevk::ImportedImage>& images, nevk::TextureManager& texManager);
+    // Returns texture per entry of Scene::mTexturePaths
+    std::vector<int> loadSnapshotTextures(nevk::Scene& scene, nevk::TextureManager& texManager);
 
     void createDescriptorPool();
 
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
-    void recordCommandBuffer(VkCommandBuffer& cmd, uint32_t imageIndex);
+    void recordCommandBuffer(VkCommandBuffer& cmd, uint32_t imageIndex, const std::vector<nevk::Scene::VisibleInstances>& visibility);
 
     void createCommandBuffers();
 
@@ -2,9 +2,11 @@
 #include "debugUtils.h"
 
 #include <scene/scene.h>
+#include <scene/vertexlayout.h>
 #include <vulkan/vulkan.h>
 
 #include <array>
+#include <cstdint>
 #include <resourcemanager.h>
 #include <vector>
 
@@ -83,58 +85,59 @@ private:
     VkFormat mDepthBufferFormat;
     uint32_t mWidth, mHeight;
 
-    static VkVertexInputBindingDescription getBindingDescription()
+    VertexLayout mVertexLayout = VertexLayout::eFull;
+    bool mVertexPulling = false;
+
+    VkShaderModule createShaderModule(const char* code, uint32_t codeSize);
+
+public:
+    // Vertex input of layout, attributeCount limits attributes to first ones
+    static VkVertexInputBindingDescription getBindingDescription(const VertexLayoutDesc& layout)
     {
         VkVertexInputBindingDescription bindingDescription{};
         bindingDescription.binding = 0;
-        bindingDescription.stride = sizeof(Scene::Vertex);
+        bindingDescription.stride = layout.stride;
         bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
         return bindingDescription;
     }
 
-    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions()
+    static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(const VertexLayoutDesc& layout, size_t attributeCount = SIZE_MAX)
     {
         std::vector<VkVertexInputAttributeDescription> attributeDescriptions = {};
 
-        VkVertexInputAttributeDescription attributeDescription;
-
-        attributeDescription.binding = 0;
-        attributeDescription.location = 0;
-        attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-        attributeDescription.offset = offsetof(Scene::Vertex, pos);
-        attributeDescriptions.emplace_back(attributeDescription);
-
-        attributeDescription.binding = 0;
-        attributeDescription.location = 1;
-        attributeDescription.format = VK_FORMAT_R32_UINT;
-        attributeDescription.offset = offsetof(Scene::Vertex, tangent);
-        attributeDescriptions.emplace_back(attributeDescription);
-
-        attributeDescription.binding = 0;
-        attributeDescription.location = 2;
-        attributeDescription.format = VK_FORMAT_R32_UINT;
-        attributeDescription.offset = offsetof(Scene::Vertex, normal);
-        attributeDescriptions.emplace_back(attributeDescription);
-
-        attributeDescription.binding = 0;
-        attributeDescription.location = 3;
-        attributeDescription.format = VK_FORMAT_R32_UINT;
-        attributeDescription.offset = offsetof(Scene::Vertex, uv);
-        attributeDescriptions.emplace_back(attributeDescription);
+        for (size_t i = 0; i < layout.attributes.size() && i < attributeCount; ++i)
+        {
+            VkVertexInputAttributeDescription attributeDescription;
+            attributeDescription.binding = 0;
+            attributeDescription.location = layout.attributes[i].location;
+            attributeDescription.offset = layout.attributes[i].offset;
+            switch (layout.attributes[i].format)
+            {
+            case VertexAttributeFormat::eFloat3:
+                attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
+                break;
+            case VertexAttributeFormat::eUShort4:
+                attributeDescription.format = VK_FORMAT_R16G16B16A16_UINT;
+                break;
+            case VertexAttributeFormat::eUInt:
+            default:
+                attributeDescription.format = VK_FORMAT_R32_UINT;
+                break;
+            }
+            attributeDescriptions.emplace_back(attributeDescription);
+        }
 
         return attributeDescriptions;
     }
 
-    VkShaderModule createShaderModule(const char* code, uint32_t codeSize);
-
-public:
     int imageViewCounter = 0;
 
     std::vector<VkImageView> mTextureImageView;
     VkImageView mShadowImageView = VK_NULL_HANDLE;
     VkBuffer mMaterialBuffer = VK_NULL_HANDLE;
     VkBuffer mInstanceBuffer = VK_NULL_HANDLE;
+    VkBuffer mVertexBuffer = VK_NULL_HANDLE; // read by shader with vertex pulling
 
     bool needDesciptorSetUpdate;
 
@@ -154,12 +157,26 @@ public:
         mDepthBufferFormat = format;
     }
 
+    // must be set before init(), shaders have to be compiled for the same layout
+    void setVertexLayout(VertexLayout layout)
+    {
+        mVertexLayout = layout;
+    }
+
+    // Vertices are read from storage buffer set by setVertexBuffer() instead of vertex input,
+    // pipeline does not depend on vertex layout then. Must be set before init()
+    void setVertexPulling(bool enable)
+    {
+        mVertexPulling = enable;
+    }
+
     void setShadowImageView(VkImageView shadowImageView);
     void setTextureImageView(const std::vector<VkImageView>& textureImageView);
     void setTextureSampler(VkSampler textureSampler);
     void setShadowSampler(VkSampler shadowSampler);
     void setMaterialBuffer(VkBuffer materialBuffer);
     void setInstanceBuffer(VkBuffer instanceBuffer);
+    void setVertexBuffer(VkBuffer vertexBuffer);
 
     void init(VkDevice& device, bool enableValidation, const char* vsCode, uint32_t vsCodeSize, const char* psCode, uint32_t psCodeSize, VkDescriptorPool descpool, ResourceManager* resMngr, uint32_t width, uint32_t height)
     {
@@ -190,6 +207,7 @@ public:
 
     RenderPass(/* args */);
     ~RenderPass();
-    void record(VkCommandBuffer& cmd, VkBuffer vertexBuffer, VkBuffer indexBuffer, nevk::Scene& scene, uint32_t width, uint32_t height, uint32_t imageIndex, uint32_t cameraIndex);
+    // indexBuffer16 holds meshes with 16 bit indices, see MeshDraw. vertexBuffer is not bound with vertex pulling
+    void record(VkCommandBuffer& cmd, VkBuffer vertexBuffer, VkBuffer indexBuffer, VkBuffer indexBuffer16, const std::vector<MeshDraw>& meshDraws, nevk::Scene& scene, uint32_t width, uint32_t height, uint32_t imageIndex, const Scene::VisibleInstances& visible, Camera& camera);
 };
 } // namespace nevk
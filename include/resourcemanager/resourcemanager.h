@@ -2,6 +2,7 @@
 #include <vulkan/vulkan.h>
 
 #include <memory>
+#include <mutex>
 
 namespace nevk
 {
@@ -19,6 +20,10 @@ class ResourceManager
     VkCommandPool mCommandPool;
     VkQueue mGraphicsQueue;
 
+    // single time commands may be recorded on loader thread while render thread submits frames
+    std::mutex mCommandPoolMutex;
+    std::mutex mQueueMutex;
+
 public:
     ResourceManager(VkDevice device, VkPhysicalDevice physicalDevice, VkInstance instance, VkCommandPool commandPool, VkQueue graphicsQueue);
     ~ResourceManager();
@@ -33,8 +38,16 @@ public:
     void destroyImage(Image* image);
     VkImage getVkImage(const Image* image);
 
+    // Command pool stays locked from begin to end, so single time commands of different threads are serialized.
+    // End waits for own submit only, frames of render thread keep running
     VkCommandBuffer beginSingleTimeCommands();
     void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+
+    // Graphics queue is externally synchronized, every vkQueueSubmit and vkQueuePresentKHR on it must hold this lock
+    std::mutex& getQueueMutex()
+    {
+        return mQueueMutex;
+    }
 };
 } // namespace nevk
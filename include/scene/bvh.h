@@ -0,0 +1,120 @@
+#pragma once
+
+#include "glm-wrapper.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace nevk
+{
+
+struct AABB
+{
+    glm::float3 minimum{ 0.0f };
+    glm::float3 maximum{ 0.0f };
+
+    static AABB empty();
+
+    void expand(const AABB& other);
+    void expand(const glm::float3& point);
+
+    glm::float3 center() const
+    {
+        return (minimum + maximum) * 0.5f;
+    }
+
+    glm::float3 extent() const
+    {
+        return (maximum - minimum) * 0.5f;
+    }
+
+    float surfaceArea() const;
+
+    // Bounds of this box after transformation (Arvo's method)
+    AABB transform(const glm::float4x4& m) const;
+};
+
+class Frustum
+{
+public:
+    enum class Result
+    {
+        eOutside,
+        eIntersect,
+        eInside
+    };
+
+    // Extracts planes from view-projection matrix, expects [0; 1] clip depth
+    explicit Frustum(const glm::float4x4& viewToClip);
+
+    Result test(const AABB& box) const;
+    // Tests up to 4 boxes at once, bit i of result is set when box i is not outside
+    uint32_t testVisible4(const AABB* const boxes[4], uint32_t count) const;
+
+private:
+    glm::float4 mPlanes[6];
+};
+
+class Bvh
+{
+public:
+    struct Node
+    {
+        AABB bounds;
+        uint32_t first; // first primitive in mPrimIds covered by node
+        uint32_t count; // amount of primitives covered by node
+        uint32_t left; // index of left child, right is left + 1; 0 for leaves
+        uint32_t parent;
+    };
+
+    /// <summary>
+    /// Builds tree from scratch
+    /// </summary>
+    /// <param name="ids">ids of primitives to put into tree</param>
+    /// <param name="bounds">world space bounds indexed by primitive id</param>
+    /// <returns>Nothing</returns>
+    void build(const std::vector<uint32_t>& ids, const std::vector<AABB>& bounds);
+    /// <summary>
+    /// Updates node bounds after primitives were moved, topology stays the same
+    /// </summary>
+    /// <param name="dirtyIds">ids of moved primitives, ids not in tree are skipped</param>
+    /// <param name="bounds">world space bounds indexed by primitive id</param>
+    /// <returns>Nothing</returns>
+    void refit(const std::vector<uint32_t>& dirtyIds, const std::vector<AABB>& bounds);
+    /// <summary>
+    /// Appends ids of primitives which bounds intersect frustum
+    /// </summary>
+    /// <param name="frustum">view frustum</param>
+    /// <param name="bounds">world space bounds indexed by primitive id</param>
+    /// <param name="result">output list</param>
+    /// <returns>Nothing</returns>
+    void cull(const Frustum& frustum, const std::vector<AABB>& bounds, std::vector<uint32_t>& result) const;
+
+    // True when refits degraded tree quality enough to justify rebuild
+    bool needsRebuild() const;
+
+    bool empty() const
+    {
+        return mNodes.empty();
+    }
+
+    const std::vector<Node>& getNodes() const
+    {
+        return mNodes;
+    }
+
+private:
+    static constexpr uint32_t kMaxLeafSize = 4;
+    static constexpr uint32_t kInvalidNode = (uint32_t)-1;
+
+    std::vector<Node> mNodes;
+    std::vector<uint32_t> mPrimIds;
+    std::vector<uint32_t> mLeafOfPrim; // primitive id -> leaf node index
+    std::vector<uint32_t> mRefitNodes;
+    std::vector<uint8_t> mRefitMarks;
+    float mBuildArea = 0.0f;
+
+    void subdivide(uint32_t nodeIndex, const std::vector<AABB>& bounds);
+};
+
+} // namespace nevk
@@ -70,6 +70,8 @@ public:
     float getFarClip();
     void setFov(float fov);
     void setPerspective(float fov, float aspect, float znear, float zfar);
+    // Pixels covered by unit length at unit distance, for viewport of given height
+    float getPixelScale(float viewportHeight);
     glm::float4x4& getPerspective();
     glm::float4x4 getView();
     void updateAspectRatio(float aspect);
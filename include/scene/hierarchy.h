@@ -0,0 +1,86 @@
+#pragma once
+
+#include "glm-wrapper.hpp"
+#include "threadpool.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace nevk
+{
+
+// Tree of nodes with local transforms and cached world transforms
+class TransformHierarchy
+{
+public:
+    static constexpr uint32_t kInvalidNode = (uint32_t)-1;
+
+    size_t size() const
+    {
+        return mLocal.size();
+    }
+
+    /// <summary>
+    /// Creates node, its world transform is computed immediately
+    /// </summary>
+    /// <param name="parent">parent node or kInvalidNode for root</param>
+    /// <param name="localTransform">transform relative to parent</param>
+    /// <returns>Node id</returns>
+    uint32_t createNode(uint32_t parent, const glm::float4x4& localTransform);
+    // Marks node dirty, whole subtree gets new world transforms on next update()
+    void setLocalTransform(uint32_t node, const glm::float4x4& localTransform);
+
+    const glm::float4x4& getLocalTransform(const uint32_t node) const
+    {
+        return mLocal[node];
+    }
+
+    const glm::float4x4& getWorldTransform(const uint32_t node) const
+    {
+        return mWorld[node];
+    }
+
+    uint32_t getParent(const uint32_t node) const
+    {
+        return mParent[node];
+    }
+
+    const std::vector<uint32_t>& getChildren(const uint32_t node) const
+    {
+        return mChildren[node];
+    }
+
+    bool hasDirtyNodes() const
+    {
+        return !mDirtyNodes.empty();
+    }
+
+    /// <summary>
+    /// Recomputes world transforms of dirty subtrees level by level,
+    /// nodes of one level depend only on previous level and are processed in parallel
+    /// </summary>
+    /// <param name="pool">thread pool, may be null</param>
+    /// <returns>Nodes which world transform was recomputed</returns>
+    const std::vector<uint32_t>& update(ThreadPool* pool);
+
+private:
+    static constexpr uint32_t kParallelGrain = 1024; // nodes per task
+
+    std::vector<glm::float4x4> mLocal;
+    std::vector<glm::float4x4> mWorld;
+    std::vector<uint32_t> mParent;
+    std::vector<uint32_t> mLevel; // depth of node, roots are 0
+    std::vector<std::vector<uint32_t>> mChildren;
+    std::vector<uint8_t> mDirty;
+    std::vector<uint32_t> mDirtyNodes;
+
+    // update() scratch
+    std::vector<uint32_t> mUpdated;
+    std::vector<std::vector<uint32_t>> mDirtyByLevel;
+    std::vector<uint32_t> mCurrentLevel;
+    std::vector<uint32_t> mNextLevel;
+    std::vector<uint32_t> mStamps; // node visited in update with current stamp
+    uint32_t mStamp = 0;
+};
+
+} // namespace nevk
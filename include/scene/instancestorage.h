@@ -0,0 +1,145 @@
+#pragma once
+
+#include "glm-wrapper.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace nevk
+{
+
+template <typename T, size_t Alignment = 32>
+struct AlignedAllocator
+{
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Alignment>;
+    };
+
+    AlignedAllocator() = default;
+
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&)
+    {
+    }
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+    }
+
+    void deallocate(T* ptr, size_t)
+    {
+        ::operator delete(ptr, std::align_val_t(Alignment));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const
+    {
+        return true;
+    }
+
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Alignment>&) const
+    {
+        return false;
+    }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+struct Instance
+{
+    glm::mat4 transform;
+    uint32_t mMeshId;
+    uint32_t mMaterialId;
+    glm::float3 massCenter;
+};
+
+// Instances stored as structure of arrays, so per-frame loops touch only fields they need
+class InstanceStorage
+{
+public:
+    enum Flags : uint8_t
+    {
+        eNone = 0,
+        eTransparent = 1 << 0,
+        eRemoved = 1 << 1,
+    };
+
+    size_t size() const
+    {
+        return mMeshIds.size();
+    }
+
+    bool empty() const
+    {
+        return mMeshIds.empty();
+    }
+
+    void resize(size_t count);
+    void set(uint32_t id, const Instance& inst, uint8_t flags);
+
+    // Gathers all fields of instance, prefer per-field getters in hot loops
+    Instance operator[](size_t id) const;
+
+    const glm::float4x4& getTransform(uint32_t id) const
+    {
+        return mTransforms[id];
+    }
+
+    void setTransform(uint32_t id, const glm::float4x4& transform)
+    {
+        mTransforms[id] = transform;
+    }
+
+    uint32_t getMeshId(uint32_t id) const
+    {
+        return mMeshIds[id];
+    }
+
+    uint32_t getMaterialId(uint32_t id) const
+    {
+        return mMaterialIds[id];
+    }
+
+    glm::float3 getMassCenter(uint32_t id) const
+    {
+        return glm::float3(mCenterX[id], mCenterY[id], mCenterZ[id]);
+    }
+
+    uint8_t getFlags(uint32_t id) const
+    {
+        return mFlags[id];
+    }
+
+    void setFlags(uint32_t id, uint8_t flags)
+    {
+        mFlags[id] = flags;
+    }
+
+    /// <summary>
+    /// Computes squared distances from point to mass centers of all instances
+    /// </summary>
+    /// <param name="point">point in world space</param>
+    /// <param name="out">output array with at least size() elements</param>
+    /// <returns>Nothing</returns>
+    void computeDistances2(const glm::float3& point, float* out) const;
+
+private:
+    AlignedVector<glm::float4x4> mTransforms;
+    AlignedVector<float> mCenterX;
+    AlignedVector<float> mCenterY;
+    AlignedVector<float> mCenterZ;
+    AlignedVector<uint32_t> mMeshIds;
+    AlignedVector<uint32_t> mMaterialIds;
+    AlignedVector<uint8_t> mFlags;
+};
+
+} // namespace nevk
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "scene.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace nevk
+{
+
+// Size of simulated FIFO post-transform cache
+constexpr uint32_t kVertexCacheSize = 16;
+// Meshlet limits, common mesh shader friendly values
+constexpr uint32_t kMeshletMaxVertices = 64;
+constexpr uint32_t kMeshletMaxTriangles = 124;
+// LOD chain stops before levels with fewer triangles
+constexpr uint32_t kMinLodTriangles = 16;
+
+// Result of post-transform vertex cache simulation
+struct VertexCacheStats
+{
+    size_t transformedVertices = 0; // cache misses
+    size_t triangles = 0;
+    size_t vertices = 0; // distinct vertices referenced by indices
+
+    // Average cache miss ratio, transformed vertices per triangle: 3 is worst, about 0.5 is best for regular grids
+    float acmr() const
+    {
+        return triangles ? (float)transformedVertices / triangles : 0.0f;
+    }
+
+    // Average transform to vertex ratio: 1 means every vertex is transformed once
+    float atvr() const
+    {
+        return vertices ? (float)transformedVertices / vertices : 0.0f;
+    }
+
+    VertexCacheStats& operator+=(const VertexCacheStats& other)
+    {
+        transformedVertices += other.transformedVertices;
+        triangles += other.triangles;
+        vertices += other.vertices;
+        return *this;
+    }
+};
+
+/// <summary>
+/// Simulates FIFO post-transform vertex cache over triangle list
+/// </summary>
+/// <param name="indices">triangle list</param>
+/// <param name="vertexCount">number of vertices indices refer to</param>
+/// <param name="cacheSize">simulated cache size</param>
+/// <returns>Cache statistics</returns>
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = kVertexCacheSize);
+
+/// <summary>
+/// Reorders triangles for post-transform vertex cache locality (Tipsify: fans around vertices
+/// chosen by cache age and remaining valence, dead ends resolved from recently used vertices)
+/// </summary>
+/// <param name="indices">triangle list, reordered in place</param>
+/// <param name="vertexCount">number of vertices indices refer to</param>
+/// <param name="cacheSize">target cache size</param>
+/// <returns>Nothing</returns>
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = kVertexCacheSize);
+
+/// <summary>
+/// Reorders clusters of cache optimized triangle list to reduce overdraw from any view direction:
+/// clusters facing away from mesh center are drawn first. Clusters are split where cache is flushed anyway
+/// and where their miss ratio stays within threshold of whole run
+/// </summary>
+/// <param name="vertices">mesh vertices, only positions are used</param>
+/// <param name="indices">triangle list after optimizeVertexCache, reordered in place</param>
+/// <param name="threshold">allowed ACMR degradation, e.g. 1.05 gives up to 5%</param>
+/// <param name="cacheSize">simulated cache size</param>
+/// <returns>Nothing</returns>
+void optimizeOverdraw(const std::vector<Scene::Vertex>& vertices, std::vector<uint32_t>& indices, float threshold = 1.05f, uint32_t cacheSize = kVertexCacheSize);
+
+/// <summary>
+/// Splits triangle list into meshlets grown over shared vertices, preferring triangles which add fewest new vertices
+/// and then ones closest to meshlet center.
+/// Triangles are reordered so every meshlet is contiguous range of indices, seeds follow input order
+/// </summary>
+/// <param name="vertices">mesh vertices, positions are used for bounds and normal cones</param>
+/// <param name="indices">triangle list, reordered in place</param>
+/// <param name="meshlets">output meshlets with index ranges relative to start of indices</param>
+/// <param name="maxVertices">distinct vertices per meshlet limit</param>
+/// <param name="maxTriangles">triangles per meshlet limit</param>
+/// <returns>Nothing</returns>
+void buildMeshlets(const std::vector<Scene::Vertex>& vertices,
+                   std::vector<uint32_t>& indices,
+                   std::vector<Meshlet>& meshlets,
+                   uint32_t maxVertices = kMeshletMaxVertices,
+                   uint32_t maxTriangles = kMeshletMaxTriangles);
+
+/// <summary>
+/// Reorders triangles inside every meshlet for post-transform vertex cache,
+/// meshlet index ranges, bounds and cones stay valid
+/// </summary>
+/// <param name="indices">triangle list after buildMeshlets(), reordered in place</param>
+/// <param name="vertexCount">number of vertices indices refer to</param>
+/// <param name="meshlets">meshlets built from indices</param>
+/// <param name="cacheSize">target cache size</param>
+/// <returns>Nothing</returns>
+void optimizeMeshletVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, const std::vector<Meshlet>& meshlets, uint32_t cacheSize = kVertexCacheSize);
+
+/// <summary>
+/// Simplifies triangle list by quadric error edge collapses, vertices are kept and only indices change.
+/// Vertices on UV, normal or tangent seams (same position, different attributes) and border corners are locked,
+/// other border vertices only slide along border
+/// </summary>
+/// <param name="vertices">mesh vertices</param>
+/// <param name="indices">triangle list</param>
+/// <param name="targetIndexCount">simplification stops once result has this many indices or less</param>
+/// <param name="targetError">simplification stops before collapse exceeding this local space deviation</param>
+/// <param name="resultError">local space deviation of result from input</param>
+/// <returns>Simplified triangle list</returns>
+std::vector<uint32_t> simplifyMesh(const std::vector<Scene::Vertex>& vertices,
+                                   const std::vector<uint32_t>& indices,
+                                   size_t targetIndexCount,
+                                   float targetError,
+                                   float& resultError);
+
+/// <summary>
+/// Builds LOD chain for Scene::setMeshLods(), every level has about half of triangles of previous one.
+/// Each level is simplified from full detail, so errors do not accumulate between levels
+/// </summary>
+/// <param name="vertices">mesh vertices</param>
+/// <param name="indices">full detail triangle list</param>
+/// <param name="maxError">local space deviation limit of coarsest level</param>
+/// <returns>Levels from finest to coarsest, empty when mesh is too small or cannot be simplified</returns>
+std::vector<Scene::LodGeometry> buildLodChain(const std::vector<Scene::Vertex>& vertices,
+                                              const std::vector<uint32_t>& indices,
+                                              float maxError = std::numeric_limits<float>::max());
+
+/// <summary>
+/// Reorders vertices in order of first use by indices, unreferenced vertices are removed
+/// </summary>
+/// <param name="vertices">vertices, reordered and shrunk in place</param>
+/// <param name="indices">triangle list, remapped in place</param>
+/// <returns>Number of remaining vertices</returns>
+size_t optimizeVertexFetch(std::vector<Scene::Vertex>& vertices, std::vector<uint32_t>& indices);
+
+} // namespace nevk
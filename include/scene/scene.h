@@ -1,34 +1,67 @@
 #pragma once
 
+#include "bvh.h"
 #include "camera.h"
 #include "glm-wrapper.hpp"
+#include "hierarchy.h"
+#include "instancestorage.h"
+#include "sort.h"
+#include "threadpool.h"
 
 #include <cstdint>
+#include <memory>
 #include <set>
 #include <stack>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 
 namespace nevk
 {
 
+// Simplified levels per mesh, full detail range is not counted
+constexpr uint32_t kMaxMeshLods = 4;
+
+// Simplified index range, refers to same vertices as full detail mesh
+struct MeshLod
+{
+    uint32_t mIndex; // Index of 1st index in index buffer
+    uint32_t mCount; // amount of indices in level
+    float mError; // local space deviation from full detail
+};
+
 struct Mesh
 {
     uint32_t mIndex; // Index of 1st index in index buffer
     uint32_t mCount; // amount of indices in mesh
+    uint32_t mVertexOffset; // Index of 1st vertex in vertex buffer
+    uint32_t mVertexCount; // amount of vertices in mesh
+    AABB mBounds; // local space bounds
+    uint32_t mMeshletOffset; // Index of 1st meshlet in meshlet buffer
+    uint32_t mMeshletCount; // amount of meshlets, 0 when mesh was not split
+    MeshLod mLods[kMaxMeshLods]; // coarser with each level, errors grow
+    uint32_t mLodCount; // amount of simplified levels, 0 when only full detail exists
 };
 
-struct Instance
+// Cluster of mesh triangles with bounded vertex and triangle counts, layout matches storage buffer (std430)
+struct Meshlet
 {
-    glm::mat4 transform;
-    uint32_t mMeshId;
-    uint32_t mMaterialId;
-    glm::float3 massCenter;
+    glm::float4 mBoundingSphere; // local space center and radius
+    // Normal cone: axis and cutoff, all triangles face away from eye when
+    // dot(center - eye, axis) >= cutoff * length(center - eye) + radius. Cutoff is 1 when cone is too wide
+    glm::float4 mCone;
+    uint32_t mIndex; // Index of 1st index, relative to mesh mIndex
+    uint32_t mCount; // amount of indices in meshlet
+    uint32_t mVertexCount; // amount of distinct vertices
+    uint32_t mPad;
 };
 
 
 class Scene
 {
+    friend class SceneSnapshot;
+
 private:
     std::vector<Camera> mCameras;
 
@@ -40,7 +73,79 @@ private:
 
     std::set<uint32_t> mDirtyInstances;
 
+    // Generation of each slot, bumped on removal so stale handles are rejected
+    std::vector<uint8_t> mInstanceGenerations;
+    std::vector<uint8_t> mMeshGenerations;
+    std::vector<uint8_t> mMaterialGenerations;
+    std::vector<uint32_t> mMeshInstanceCounts; // live instances per mesh slot, such meshes can't be removed
+    std::vector<uint32_t> mMaterialInstanceCounts; // live instances per material slot, such materials can't be removed
+
+    std::vector<uint32_t> mRenderListPos; // instance index -> position in mOpaqueInstances or mTransparentInstances
+    uint32_t mDeadVertexCount = 0; // vertices of removed meshes, reclaimed by compactGeometry()
+    uint32_t mDeadIndexCount = 0;
+    uint32_t mDeadMeshletCount = 0; // meshlets of removed meshes and replaced by setMeshlets()
+
+    static uint32_t makeHandle(const uint32_t index, const uint8_t generation)
+    {
+        return ((uint32_t)generation << kIndexBits) | index;
+    }
+
+    static bool isValidHandle(const std::vector<uint8_t>& generations, const uint32_t handle)
+    {
+        const uint32_t index = handleIndex(handle);
+        return handle != kInvalidId && index < generations.size() && generations[index] == (handle >> kIndexBits);
+    }
+
+    // Bumps generation of removed slot. Returns false when slot reaches kRetiredGeneration:
+    // it is never reused then, as next generation would wrap and revive stale handles
+    static bool bumpGeneration(std::vector<uint8_t>& generations, const uint32_t index)
+    {
+        return ++generations[index] != kRetiredGeneration;
+    }
+
+    std::unordered_multimap<uint64_t, uint32_t> mMeshCache; // content hash -> mesh handle
+    std::vector<uint64_t> mMeshHashes; // per mesh slot, 0 if mesh is not in cache
+
+    TransformHierarchy mHierarchy;
+    std::vector<std::vector<uint32_t>> mNodeInstances; // instance handles following node world transform
+    ThreadPool* mThreadPool = nullptr;
+
+    std::vector<AABB> mInstanceBounds; // world space bounds per instance
+    Bvh mOpaqueBvh;
+    Bvh mTransparentBvh;
+    bool mNeedBvhRebuild = true;
+    std::vector<uint32_t> mBvhRefitInstances;
+
+    AlignedVector<float> mInstanceDistances; // squared distance to view, per instance
+    InstanceSorter mOpaqueSorter;
+    InstanceSorter mTransparentSorter;
+
+    // Per view state of computeVisibility(), each view is processed by one task
+    struct ViewState
+    {
+        AlignedVector<float> distances; // squared distance to view, per instance
+        InstanceSorter opaqueSorter;
+        InstanceSorter transparentSorter;
+    };
+    std::vector<ViewState> mViewStates;
+
+    void updateBvh();
+
 public:
+    // Ids returned by create* are handles: low 24 bits are slot index, high 8 bits are slot generation.
+    // Freshly created slots have generation 0, so their handles are equal to indices.
+    // Slot is retired after 255 removals, so no live handle has generation 255 and equals kInvalidId.
+    static constexpr uint32_t kInvalidId = (uint32_t)-1;
+    static constexpr uint8_t kRetiredGeneration = 0xFF;
+    static constexpr uint32_t kIndexBits = 24;
+    static constexpr uint32_t kIndexMask = (1u << kIndexBits) - 1;
+
+    // Slot index of handle, used to address GPU buffers and render lists
+    static uint32_t handleIndex(const uint32_t handle)
+    {
+        return handle & kIndexMask;
+    }
+
     struct Vertex
     {
         glm::float3 pos;
@@ -49,6 +154,22 @@ public:
         uint32_t uv;
     };
 
+    // Non-owning view of mesh geometry, indices are relative to first vertex of view
+    struct MeshView
+    {
+        const Vertex* vertices = nullptr;
+        size_t vertexCount = 0;
+        const uint32_t* indices = nullptr;
+        size_t indexCount = 0;
+    };
+
+    // Simplified triangle list of mesh, indices are relative to mesh vertices like in createMesh()
+    struct LodGeometry
+    {
+        std::vector<uint32_t> indices;
+        float error = 0.0f; // local space deviation from full detail
+    };
+
     struct Material
     {
         glm::float4 ambient; // Ka
@@ -98,6 +219,10 @@ public:
 
     bool transparentMode = true;
     bool opaqueMode = true;
+    bool frustumCulling = true;
+    bool stateSorting = false; // sort opaque instances by makeDrawSortKey instead of pure depth
+    float lodPixelError = 1.0f; // allowed on screen deviation of simplified meshes in pixels, 0 draws full detail
+    float shadowLodPixelError = 4.0f; // shadow casters tolerate coarser levels than camera view
 
     glm::float4 mLightPosition{ 10.0, 10.0, 10.0, 1.0 };
 
@@ -105,26 +230,68 @@ public:
     std::vector<uint32_t> mIndices;
 
     std::vector<Mesh> mMeshes;
+    std::vector<Meshlet> mMeshlets;
     std::vector<Material> mMaterials;
-    std::vector<Instance> mInstances;
+    InstanceStorage mInstances;
+    std::vector<std::string> mTexturePaths; // image file per texture id, empty for images embedded into model
 
     std::vector<uint32_t> mTransparentInstances;
     std::vector<uint32_t> mOpaqueInstances;
 
+    std::vector<uint32_t> mVisibleTransparentInstances;
+    std::vector<uint32_t> mVisibleOpaqueInstances;
+
     Scene() = default;
 
     ~Scene() = default;
 
     std::vector<Vertex>& getVertices()
     {
+        materializeGeometry();
         return mVertices;
     }
 
     std::vector<uint32_t>& getIndices()
     {
+        materializeGeometry();
         return mIndices;
     }
 
+    // Geometry of all meshes, valid for mapped geometry as well, use as upload source
+    const Vertex* getVertexData() const
+    {
+        return mMappedGeometryOwner ? mMappedGeometry.vertices : mVertices.data();
+    }
+
+    size_t getVertexCount() const
+    {
+        return mMappedGeometryOwner ? mMappedGeometry.vertexCount : mVertices.size();
+    }
+
+    const uint32_t* getIndexData() const
+    {
+        return mMappedGeometryOwner ? mMappedGeometry.indices : mIndices.data();
+    }
+
+    size_t getIndexCount() const
+    {
+        return mMappedGeometryOwner ? mMappedGeometry.indexCount : mIndices.size();
+    }
+
+    bool hasMappedGeometry() const
+    {
+        return mMappedGeometryOwner != nullptr;
+    }
+
+    /// <summary>
+    /// Makes scene use geometry it does not own, e.g. arrays inside memory mapped snapshot.
+    /// Geometry is copied into scene storage on first modification
+    /// </summary>
+    /// <param name="owner">keeps memory of geometry alive</param>
+    /// <param name="geometry">vertices and indices of all meshes, indices are global</param>
+    /// <returns>Nothing</returns>
+    void setMappedGeometry(std::shared_ptr<const void> owner, const MeshView& geometry);
+
     std::vector<Material>& getMaterials()
     {
         return mMaterials;
@@ -151,7 +318,7 @@ public:
         return mCameras.size();
     }
 
-    const std::vector<Instance>& getInstances() const
+    const InstanceStorage& getInstances() const
     {
         return mInstances;
     }
@@ -161,6 +328,11 @@ public:
         return mMeshes;
     }
 
+    const std::vector<Meshlet>& getMeshlets() const
+    {
+        return mMeshlets;
+    }
+
     void updateCamerasParams(int width, int height)
     {
         for (Camera& camera: mCameras)
@@ -175,13 +347,54 @@ public:
     /// <param name="ib">Indices</param>
     /// <returns>Mesh id in scene</returns>
     uint32_t createMesh(const std::vector<Vertex>& vb, const std::vector<uint32_t>& ib);
+    uint32_t createMesh(const MeshView& mesh);
+    // Convenience overload, not faster ingestion: buffers are taken over only as first mesh of empty scene without larger
+    // storage reserved by reserveGeometry(). Otherwise geometry is copied once like with MeshView and moved buffers are
+    // released right away. Bulk import should reserve storage and pass views
+    uint32_t createMesh(std::vector<Vertex>&& vb, std::vector<uint32_t>&& ib);
+    /// <summary>
+    /// Creates many meshes, storage grows once for all of them
+    /// </summary>
+    /// <param name="meshes">Views of mesh geometry</param>
+    /// <returns>Mesh ids in scene, in order of views</returns>
+    std::vector<uint32_t> createMeshes(const std::vector<MeshView>& meshes);
+    /// <summary>
+    /// Reserves storage for geometry that is going to be added, loaders call it before import
+    /// </summary>
+    /// <param name="vertexCount">amount of vertices to be added</param>
+    /// <param name="indexCount">amount of indices to be added</param>
+    /// <returns>Nothing</returns>
+    void reserveGeometry(size_t vertexCount, size_t indexCount);
+    /// <summary>
+    /// Returns existing mesh with exactly the same vertices and indices or creates new one
+    /// </summary>
+    /// <param name="vb">Vertices</param>
+    /// <param name="ib">Indices</param>
+    /// <returns>Mesh id in scene</returns>
+    uint32_t getOrCreateMesh(const std::vector<Vertex>& vb, const std::vector<uint32_t>& ib);
+    // moved buffers are consumed as by createMesh(&&) when new mesh is created, left as they are for existing mesh
+    uint32_t getOrCreateMesh(std::vector<Vertex>&& vb, std::vector<uint32_t>&& ib);
+    /// <summary>
+    /// Attaches meshlets to mesh, previous meshlets of mesh are replaced
+    /// </summary>
+    /// <param name="meshId">valid mesh id</param>
+    /// <param name="meshlets">meshlets covering mesh index range, see buildMeshlets()</param>
+    /// <returns>False for stale mesh id or meshlet outside of mesh</returns>
+    bool setMeshlets(uint32_t meshId, const std::vector<Meshlet>& meshlets);
+    /// <summary>
+    /// Attaches simplified levels to mesh, previous levels of mesh are replaced
+    /// </summary>
+    /// <param name="meshId">valid mesh id</param>
+    /// <param name="lods">levels from finest to coarsest, at most kMaxMeshLods, see buildLodChain()</param>
+    /// <returns>False for stale mesh id, too many levels or index outside of mesh vertices</returns>
+    bool setMeshLods(uint32_t meshId, const std::vector<LodGeometry>& lods);
     /// <summary>
     /// Creates Instance
     /// </summary>
     /// <param name="meshId">valid mesh id</param>
     /// <param name="materialId">valid material id</param>
     /// <param name="transform">transform</param>
-    /// <returns>Instance id in scene</returns>
+    /// <returns>Instance id in scene, kInvalidId for stale mesh or material id</returns>
     uint32_t createInstance(uint32_t meshId, uint32_t materialId, const glm::mat4& transform, const glm::float3& massCenter);
     /// <summary>
     /// Creates Material
@@ -205,25 +418,156 @@ public:
     uint32_t addMaterial(const Material& material);
 
     /// <summary>
-    /// Removes instance/mesh/material
+    /// Removes instance/mesh/material, removed instances are taken out of render lists,
+    /// geometry of removed meshes is reclaimed by compactGeometry()
     /// </summary>
     /// <param name="meshId">valid mesh id</param>
     /// <param name="materialId">valid material id</param>
     /// <param name="instId">valid instance id</param>
+    /// <returns>False for stale or invalid id, or for mesh or material still used by instances</returns>
+    bool removeInstance(uint32_t instId);
+    bool removeMesh(uint32_t meshId);
+    bool removeMaterial(uint32_t materialId);
+
+    bool isInstanceValid(const uint32_t instId) const
+    {
+        return isValidHandle(mInstanceGenerations, instId);
+    }
+
+    bool isMeshValid(const uint32_t meshId) const
+    {
+        return isValidHandle(mMeshGenerations, meshId);
+    }
+
+    bool isMaterialValid(const uint32_t materialId) const
+    {
+        return isValidHandle(mMaterialGenerations, materialId);
+    }
+
+    /// <summary>
+    /// Checks whether removed meshes occupy more than half of vertex or index storage
+    /// </summary>
+    /// <returns>True if compactGeometry() is worth running</returns>
+    bool needsCompaction() const;
+    /// <summary>
+    /// Drops vertices and indices of removed meshes and remaps ranges of live meshes,
+    /// vertex and index buffers have to be recreated after this call
+    /// </summary>
     /// <returns>Nothing</returns>
-    void removeInstance(uint32_t instId);
-    void removeMesh(uint32_t meshId);
-    void removeMaterial(uint32_t materialId);
+    void compactGeometry();
 
-    std::vector<uint32_t>& getOpaqueInstancesToRender(const glm::float3& camPos);
+    /// <summary>
+    /// Collects opaque instances inside frustum sorted front to back
+    /// </summary>
+    /// <param name="camPos">view position used for sorting</param>
+    /// <param name="viewToClip">view-projection matrix of view</param>
+    /// <returns>Instance ids</returns>
+    std::vector<uint32_t>& getOpaqueInstancesToRender(const glm::float3& camPos, const glm::float4x4& viewToClip);
+    /// <summary>
+    /// Collects transparent instances inside frustum sorted back to front
+    /// </summary>
+    /// <param name="camPos">view position used for sorting</param>
+    /// <param name="viewToClip">view-projection matrix of view</param>
+    /// <returns>Instance ids</returns>
+    std::vector<uint32_t>& getTransparentInstancesToRender(const glm::float3& camPos, const glm::float4x4& viewToClip);
 
-    std::vector<uint32_t>& getTransparentInstancesToRender(const glm::float3& camPos);
+    // View for visibility stage: camera, shadow light, etc.
+    struct View
+    {
+        glm::float3 position; // used for sorting
+        glm::float4x4 viewToClip;
+    };
+
+    struct VisibleInstances
+    {
+        std::vector<uint32_t> opaque; // front to back or by state
+        std::vector<uint32_t> transparent; // back to front
+    };
+
+    /// <summary>
+    /// Culls and sorts instances for all views at once, views are processed in parallel on thread pool.
+    /// Keep view order stable between frames, sorting reuses last frame order of view with same index
+    /// </summary>
+    /// <param name="views">active views of frame</param>
+    /// <returns>Visible instances per view, valid until next call</returns>
+    const std::vector<VisibleInstances>& computeVisibility(const std::vector<View>& views);
+    /// <summary>
+    /// Collects meshlets of instance which intersect view frustum and do not face away from view position
+    /// </summary>
+    /// <param name="instId">valid instance id</param>
+    /// <param name="view">view to test against</param>
+    /// <param name="result">indices into getMeshlets(), cleared first</param>
+    /// <returns>Nothing</returns>
+    void getVisibleMeshlets(uint32_t instId, const View& view, std::vector<uint32_t>& result) const;
+    /// <summary>
+    /// Selects coarsest level of instance mesh whose deviation projected at instance distance stays within limit
+    /// </summary>
+    /// <param name="instanceIndex">index of instance, as in render lists</param>
+    /// <param name="eye">camera position</param>
+    /// <param name="pixelScale">pixels covered by unit length at unit distance, see Camera::getPixelScale()</param>
+    /// <param name="maxPixelError">allowed deviation in pixels, e.g. lodPixelError</param>
+    /// <returns>0 for full detail, i for mesh mLods[i - 1]</returns>
+    uint32_t selectLod(uint32_t instanceIndex, const glm::float3& eye, float pixelScale, float maxPixelError) const;
+
+    // Index range of mesh level returned by selectLod()
+    static void getLodRange(const Mesh& mesh, const uint32_t lod, uint32_t& indexOffset, uint32_t& indexCount)
+    {
+        indexOffset = lod == 0 ? mesh.mIndex : mesh.mLods[lod - 1].mIndex;
+        indexCount = lod == 0 ? mesh.mCount : mesh.mLods[lod - 1].mCount;
+    }
+
+    const std::vector<AABB>& getInstanceBounds() const
+    {
+        return mInstanceBounds;
+    }
+
+    void setThreadPool(ThreadPool* pool)
+    {
+        mThreadPool = pool;
+    }
+
+    ThreadPool* getThreadPool() const
+    {
+        return mThreadPool;
+    }
+
+    /// <summary>
+    /// Creates node of transform hierarchy
+    /// </summary>
+    /// <param name="parentId">parent node id or TransformHierarchy::kInvalidNode for root</param>
+    /// <param name="localTransform">transform relative to parent</param>
+    /// <returns>Node id</returns>
+    uint32_t createNode(uint32_t parentId, const glm::float4x4& localTransform);
+    /// <summary>
+    /// Makes instance follow world transform of node, applied when node changes
+    /// </summary>
+    /// <param name="nodeId">valid node id</param>
+    /// <param name="instId">valid instance id</param>
+    /// <returns>Nothing</returns>
+    void attachInstance(uint32_t nodeId, uint32_t instId);
+    /// <summary>
+    /// Changes local transform of node, world transforms of subtree are updated in updateTransforms()
+    /// </summary>
+    /// <param name="nodeId">valid node id</param>
+    /// <param name="localTransform">transform relative to parent</param>
+    /// <returns>Nothing</returns>
+    void setNodeLocalTransform(uint32_t nodeId, const glm::float4x4& localTransform);
+    /// <summary>
+    /// Recomputes world transforms of dirty subtrees and updates attached instances
+    /// </summary>
+    /// <returns>Nothing</returns>
+    void updateTransforms();
+
+    const TransformHierarchy& getHierarchy() const
+    {
+        return mHierarchy;
+    }
 
     /// <summary>
     /// Get set of DirtyInstances
     /// </summary>
     /// <returns>Set of instances</returns>
-    std::set<uint32_t> getDirtyInstances();
+    const std::set<uint32_t>& getDirtyInstances() const;
     /// <summary>
     /// Get Frame mode (bool)
     /// </summary>
@@ -234,8 +578,8 @@ public:
     /// </summary>
     /// <param name="instId">valid instance id</param>
     /// <param name="newTransform">new transformation matrix</param>
-    /// <returns>Nothing</returns>
-    void updateInstanceTransform(uint32_t instId, glm::float4x4 newTransform);
+    /// <returns>False for stale or invalid id</returns>
+    bool updateInstanceTransform(uint32_t instId, glm::float4x4 newTransform);
     /// <summary>
     /// Changes status of scene and cleans up mDirty* sets
     /// </summary>
@@ -246,5 +590,23 @@ public:
     /// </summary>
     /// <returns>Nothing</returns>
     void endFrame();
+
+private:
+    std::vector<VisibleInstances> mVisibility;
+
+    std::shared_ptr<const void> mMappedGeometryOwner;
+    MeshView mMappedGeometry;
+
+    // copies mapped geometry into mVertices/mIndices, called before geometry is modified
+    void materializeGeometry();
+
+    void collectInstances(const Bvh& bvh, const std::vector<uint32_t>& instances, const Frustum& frustum, std::vector<uint32_t>& result) const;
+    uint32_t allocateMesh();
+    void initMeshRange(uint32_t meshIndex, const MeshView& mesh);
+    void appendGeometry(uint32_t meshIndex, const MeshView& mesh);
+    bool isMeshEqual(uint32_t meshIndex, const MeshView& mesh) const;
+    uint64_t hashMesh(const MeshView& mesh) const;
+    uint32_t findMesh(uint64_t hash, const MeshView& mesh) const;
+    void addToMeshCache(uint64_t hash, uint32_t meshId);
 };
 } // namespace nevk
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "scene.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace nevk
+{
+
+// Read-only memory mapping of whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const uint8_t* data() const
+    {
+        return mData;
+    }
+
+    size_t size() const
+    {
+        return mSize;
+    }
+
+private:
+    const uint8_t* mData = nullptr;
+    size_t mSize = 0;
+#ifdef _WIN32
+    void* mFile = nullptr;
+    void* mMapping = nullptr;
+#endif
+};
+
+// Versioned binary image of populated scene: geometry, meshes, meshlets, materials, instances, cameras and texture references.
+// Sections are stored as arrays of in-memory structs, so snapshot is tied to build which wrote it (checked by record sizes).
+// Transform hierarchy is not stored, instances keep their world transforms.
+class SceneSnapshot
+{
+public:
+    static constexpr uint32_t kVersion = 4;
+
+    /// <summary>
+    /// Writes snapshot of scene, texture paths are stored relative to snapshot file
+    /// </summary>
+    /// <param name="scene">scene to save, removed instances are skipped</param>
+    /// <param name="path">output file path</param>
+    /// <returns>False if file could not be written</returns>
+    static bool save(const Scene& scene, const std::string& path);
+    /// <summary>
+    /// Maps snapshot file and fills empty scene. Vertex and index arrays are not copied,
+    /// scene references them in mapping until its geometry is modified
+    /// </summary>
+    /// <param name="path">snapshot file path</param>
+    /// <param name="scene">empty scene</param>
+    /// <returns>False for missing, corrupted or incompatible file</returns>
+    static bool load(const std::string& path, Scene& scene);
+};
+
+} // namespace nevk
@@ -0,0 +1,15 @@
+#pragma once
+
+// Selects widest SIMD instruction set enabled at compile time
+#if defined(__AVX__)
+#    define NEVK_AVX 1
+#    define NEVK_SSE 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define NEVK_SSE 1
+#endif
+
+#if defined(NEVK_AVX)
+#    include <immintrin.h>
+#elif defined(NEVK_SSE)
+#    include <emmintrin.h>
+#endif
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "glm-wrapper.hpp"
+#include "instancestorage.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace nevk
+{
+
+// Order preserving integer key for non-negative float (e.g. squared distance)
+inline uint32_t depthSortKey(const float distance2)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &distance2, sizeof(bits));
+    return bits;
+}
+
+// Combined key: quantized depth in high part, then material and mesh.
+// Depth keeps only exponent and top mantissa bits so nearby instances share bucket and get grouped by state,
+// material and mesh ids are truncated to 16 bits, collisions only worsen grouping.
+inline uint64_t makeDrawSortKey(const float distance2, const uint32_t materialId, const uint32_t meshId)
+{
+    constexpr uint32_t kDepthBits = 12; // 8 exponent + 3 mantissa bits of non-negative float
+    const uint64_t depth = depthSortKey(distance2) >> (32 - kDepthBits);
+    return (depth << 32) | ((uint64_t)(materialId & 0xFFFF) << 16) | (meshId & 0xFFFF);
+}
+
+/// <summary>
+/// Stable LSD radix sort of values by 32-bit keys, 8 bits per pass, passes with single digit are skipped
+/// </summary>
+/// <param name="keys">keys, sorted in place</param>
+/// <param name="values">values moved along with keys</param>
+/// <param name="tmpKeys">scratch storage</param>
+/// <param name="tmpValues">scratch storage</param>
+/// <returns>Nothing</returns>
+void radixSort(std::vector<uint32_t>& keys,
+               std::vector<uint32_t>& values,
+               std::vector<uint32_t>& tmpKeys,
+               std::vector<uint32_t>& tmpValues);
+
+// Sorts instance id lists for drawing, keeps scratch and last frame order between calls
+class InstanceSorter
+{
+public:
+    enum class Mode
+    {
+        eFrontToBack,
+        eBackToFront,
+        eState, // makeDrawSortKey order: coarse front to back, then material, then mesh
+    };
+
+    // Camera movement (world units) below which last frame order is reused as starting point
+    float coherenceThreshold = 0.5f;
+    // Insertion sort gives up after this many element moves per instance on average
+    uint32_t maxMovesPerInstance = 4;
+
+    /// <summary>
+    /// Sorts instance ids
+    /// </summary>
+    /// <param name="ids">instance ids, sorted in place</param>
+    /// <param name="instances">instance storage, used for material and mesh ids</param>
+    /// <param name="distances2">squared distance to camera indexed by instance id</param>
+    /// <param name="camPos">camera position</param>
+    /// <param name="mode">sorting order</param>
+    /// <returns>Nothing</returns>
+    void sort(std::vector<uint32_t>& ids,
+              const InstanceStorage& instances,
+              const float* distances2,
+              const glm::float3& camPos,
+              Mode mode);
+
+    // True when last sort() finished with insertion sort on previous order
+    bool usedFastPath() const
+    {
+        return mUsedFastPath;
+    }
+
+private:
+    std::vector<uint32_t> mKeys;
+    std::vector<uint32_t> mValues;
+    std::vector<uint32_t> mTmpKeys;
+    std::vector<uint32_t> mTmpValues;
+
+    // Last orders of several views, so passes sorting for camera and light do not evict each other
+    struct History
+    {
+        std::vector<uint32_t> order;
+        glm::float3 camPos{ 0.0f };
+        Mode mode = Mode::eFrontToBack;
+    };
+    static constexpr uint32_t kMaxHistory = 4;
+    History mHistory[kMaxHistory];
+    uint32_t mNextHistory = 0;
+
+    std::vector<uint32_t> mMarks; // per instance id stamp, used to match ids with last order
+    uint32_t mStamp = 0;
+    bool mUsedFastPath = false;
+
+    History* findHistory(const glm::float3& camPos, Mode mode);
+    void fillFromLastOrder(const std::vector<uint32_t>& ids, const std::vector<uint32_t>& lastOrder);
+    bool insertionSort(uint32_t maxMoves);
+};
+
+} // namespace nevk
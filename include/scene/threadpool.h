@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace nevk
+{
+
+class ThreadPool
+{
+public:
+    // 0 means one thread less than hardware concurrency, calling thread works in parallelFor too
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t getThreadCount() const
+    {
+        return (uint32_t)mWorkers.size();
+    }
+
+    /// <summary>
+    /// Puts task into queue
+    /// </summary>
+    /// <param name="task">task to run on worker thread</param>
+    /// <returns>Future to wait for task completion</returns>
+    std::future<void> enqueue(std::function<void()> task);
+    /// <summary>
+    /// Splits [0; count) into chunks of at least grainSize elements and runs them on workers and calling thread
+    /// </summary>
+    /// <param name="count">number of elements</param>
+    /// <param name="grainSize">minimal chunk size</param>
+    /// <param name="func">called with [begin; end) range of chunk</param>
+    /// <returns>Nothing, returns when all chunks are done</returns>
+    void parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& func);
+
+private:
+    std::vector<std::thread> mWorkers;
+    std::queue<std::packaged_task<void()>> mTasks;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStop = false;
+
+    void workerLoop();
+};
+
+} // namespace nevk
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "scene.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace nevk
+{
+
+// Layouts of GPU vertex buffer, scene always keeps Scene::Vertex and vertices are converted at upload.
+// Values are passed to shaders in instance constants, see VERTEX_LAYOUT_* in shaders/vertexlayout.h
+enum class VertexLayout : uint32_t
+{
+    eFull = 0, // Scene::Vertex as is, 24 bytes
+    eCompact = 1, // CompactVertex, 16 bytes
+};
+
+enum class VertexAttributeFormat : uint32_t
+{
+    eFloat3,
+    eUShort4,
+    eUInt,
+};
+
+struct VertexAttribute
+{
+    uint32_t location;
+    VertexAttributeFormat format;
+    uint32_t offset;
+};
+
+struct VertexLayoutDesc
+{
+    const char* name; // command line name
+    const char* shaderDefine; // defined for all shaders when layout is used, nullptr for full layout
+    uint32_t stride;
+    std::vector<VertexAttribute> attributes; // position is first
+    // Depth only passes bind separate stream of first positionStride bytes of every vertex, position attribute is at offset 0.
+    // Compact stream keeps tangent in 4th component, there is no mandatory 3 component 16 bit vertex format
+    uint32_t positionStride;
+};
+
+// Position is quantized to 16 bits per axis over mesh bounds, dequantization scale and bias are per instance.
+// Tangent is angle around normal in orthonormal basis built from it, matches shaders/vertexlayout.h
+struct CompactVertex
+{
+    uint16_t pos[3];
+    uint16_t tangent; // angle in low 15 bits, bitangent handedness in high bit
+    uint32_t normal;
+    uint32_t uv;
+};
+
+/// <summary>
+/// Description of vertex layout used to set up pipeline vertex input and shaders
+/// </summary>
+/// <param name="layout">layout</param>
+/// <returns>Description, lives as long as program</returns>
+const VertexLayoutDesc& getVertexLayoutDesc(VertexLayout layout);
+
+/// <summary>
+/// Finds vertex layout by its command line name
+/// </summary>
+/// <param name="name">layout name, e.g. "full" or "compact"</param>
+/// <param name="layout">found layout</param>
+/// <returns>False if there is no layout with such name</returns>
+bool findVertexLayout(const std::string& name, VertexLayout& layout);
+
+/// <summary>
+/// Quantization of positions inside bounds to 16 bits per axis: position = quantized * scale + bias.
+/// Flat axes get zero scale
+/// </summary>
+/// <param name="bounds">local space mesh bounds</param>
+/// <param name="scale">dequantization scale</param>
+/// <param name="bias">dequantization bias</param>
+/// <returns>Nothing</returns>
+void getPositionQuantization(const AABB& bounds, glm::float3& scale, glm::float3& bias);
+
+/// <summary>
+/// Copies position stream of vertices, see VertexLayoutDesc::positionStride
+/// </summary>
+/// <param name="layout">layout of vertices</param>
+/// <param name="vertices">vertices in layout</param>
+/// <param name="count">number of vertices</param>
+/// <param name="positions">output, count * positionStride bytes</param>
+/// <returns>Nothing</returns>
+void extractPositions(const VertexLayoutDesc& layout, const void* vertices, size_t count, void* positions);
+
+// Ranges of mesh in GPU index buffers, indices are local to mesh and base vertex is passed with draw.
+// Meshes with fewer than 65536 vertices use 16 bit buffer, others 32 bit one
+struct MeshDraw
+{
+    uint32_t firstIndex[kMaxMeshLods + 1]; // per level of Scene::selectLod(), in buffer of mesh index type
+    uint32_t indexCount[kMaxMeshLods + 1];
+    int32_t vertexOffset;
+    bool index16;
+};
+
+struct GpuIndices
+{
+    std::vector<uint16_t> indices16;
+    std::vector<uint32_t> indices32;
+    std::vector<MeshDraw> draws; // per mesh slot
+};
+
+/// <summary>
+/// Splits scene index buffer into 16 and 32 bit buffers of mesh local indices.
+/// Levels of each mesh are stored one after another in mesh order, so any prefix of meshes is prefix of both buffers.
+/// Meshlet ranges stay valid relative to firstIndex[0]
+/// </summary>
+/// <param name="meshes">scene meshes</param>
+/// <param name="indices">scene index buffer with absolute indices</param>
+/// <param name="indexCount">size of scene index buffer</param>
+/// <returns>Buffers and draw ranges per mesh</returns>
+GpuIndices buildGpuIndices(const std::vector<Mesh>& meshes, const uint32_t* indices, size_t indexCount);
+
+} // namespace nevk
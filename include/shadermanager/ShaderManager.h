@@ -3,6 +3,7 @@
 #include <iostream>
 #include <slang.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <slang-com-ptr.h>
@@ -23,6 +24,8 @@ public:
     ShaderManager();
     ~ShaderManager();
 
+    // Preprocessor define for all shaders compiled afterwards, including reloads
+    void addDefine(const std::string& name, const std::string& value = "1");
     uint32_t loadShader(const char* fileName, const char* entryPointName, Stage stage);
     void reloadAllShaders();
     bool getShaderCode(uint32_t id, const char*& code, uint32_t& size);
@@ -42,6 +45,7 @@ private:
 
     SlangSession* mSlangSession = nullptr;
     std::vector<ShaderDesc> mShaderDescs;
+    std::vector<std::pair<std::string, std::string>> mDefines;
 
     ShaderDesc compileShader(const char* fileName, const char* entryPointName, Stage stage);
 };
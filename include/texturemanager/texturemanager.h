@@ -3,6 +3,7 @@
 #include <vulkan/vulkan.h>
 
 #include <iostream>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -41,8 +42,21 @@ public:
     std::vector<VkSampler> delShadowSampler;
 
     int loadTexture(const std::string& texture_path, const std::string& MTL_PATH);
+    int loadTextureFile(const std::string& path);
 
     int loadTextureGltf(const void* pixels, const uint32_t width, const uint32_t height, const std::string& name);
+
+    // RGBA8 pixels decoded by caller
+    struct TextureData
+    {
+        const void* pixels;
+        uint32_t width;
+        uint32_t height;
+        std::string name;
+    };
+    // Uploads textures through shared staging buffer with one submit per batch instead of three per texture.
+    // Names already loaded are reused, new textures get consecutive ids in order of first appearance
+    std::vector<int> loadTextureBatch(const std::vector<TextureData>& batch);
     int findTexture(const std::string& name);
 
     Texture createTextureImage(const std::string& texture_path);
@@ -1,14 +1,24 @@
 #pragma once
 
-//  valid range of coordinates [-1; 1]
-float3 unpackNormal(uint32_t val)
+// Octahedral unit vector from integer coordinates in [0; 2 * scale], same operations as octDecode() in modelloader.cpp.
+// precise keeps compiler from fusing or reordering them. Result still may differ from CPU in last bits,
+// Vulkan does not require division and sqrt to be correctly rounded
+float3 octDecode(uint32_t u, uint32_t v, float scale)
 {
-   float3 normal;
-   normal.z = ((val & 0xfff00000) >> 20) / 511.99999f * 2.0f - 1.0f;
-   normal.y = ((val & 0x000ffc00) >> 10) / 511.99999f * 2.0f - 1.0f;
-   normal.x = (val & 0x000003ff) / 511.99999f * 2.0f - 1.0f;
+   precise float x = u / scale - 1.0f;
+   precise float y = v / scale - 1.0f;
+   precise float z = (1.0f - abs(x)) - abs(y);
+   precise float t = max(-z, 0.0f);
+   x += x >= 0.0f ? -t : t;
+   y += y >= 0.0f ? -t : t;
+   precise float len = sqrt((x * x + y * y) + z * z);
+   return float3(x / len, y / len, z / len);
+}
 
-   return normal;
+//  16 bits per axis, 0 marks missing normal and decodes to -z
+float3 unpackNormal(uint32_t val)
+{
+   return octDecode(val & 0xffff, val >> 16, 32767.0f);
 }
 
 //  valid range of coordinates [-10; 10]
@@ -21,13 +31,8 @@ float2 unpackUV(uint32_t val)
    return uv;
 }
 
-//  valid range of coordinates [-10; 10]
-float3 unpackTangent(uint32_t val)
+//  15 bits per axis, w is bitangent handedness stored in bit 30
+float4 unpackTangent(uint32_t val)
 {
-   float3 tangent;
-   tangent.z = ((val & 0xfff00000) >> 20) / 511.99999f * 20.0f - 10.0f;
-   tangent.y = ((val & 0x000ffc00) >> 10) / 511.99999f * 20.0f - 10.0f;
-   tangent.x = (val & 0x000003ff) / 511.99999f * 20.0f - 10.0f;
-
-   return tangent;
+   return float4(octDecode(val & 0x7fff, (val >> 15) & 0x7fff, 16383.0f), (val & 0x40000000) ? -1.0f : 1.0f);
 }
@@ -1,16 +1,13 @@
-struct VertexInput
-{
-    float3 position : POSITION;
-};
+#include "vertexlayout.h"
 
 struct InstanceConstants
 {
     float4x4 model;
     float4x4 normalMatrix;
+    float3 posScale; // dequantization of compact vertex positions
     int32_t materialId;
-    int32_t pad0;
-    int32_t pad1;
-    int32_t pad2;
+    float3 posBias;
+    uint32_t vertexLayout; // VERTEX_LAYOUT_*, used with vertex pulling
 };
 
 struct InstancePushConstants 
@@ -25,6 +22,10 @@ cbuffer ubo
 }
 
 StructuredBuffer<InstanceConstants> instanceConstants;
+#if defined(NEVK_VERTEX_PULLING)
+// position stream, see VertexLayoutDesc::positionStride
+StructuredBuffer<uint32_t> positions;
+#endif
 
 struct PS_INPUT
 {
@@ -32,10 +33,19 @@ struct PS_INPUT
 };
 
 [shader("vertex")]
-PS_INPUT vertexMain(VertexInput vi)
+#if defined(NEVK_VERTEX_PULLING)
+PS_INPUT vertexMain(uint32_t vertexId : SV_VertexID)
+#else
+PS_INPUT vertexMain(PositionInput vi)
+#endif
 {
     InstanceConstants constants = instanceConstants[NonUniformResourceIndex(pconst.instanceId)];
+#if defined(NEVK_VERTEX_PULLING)
+    float3 position = pullPosition(positions, vertexId, constants.vertexLayout, constants.posScale, constants.posBias);
+#else
+    float3 position = decodePosition(vi.position, constants.posScale, constants.posBias);
+#endif
     PS_INPUT out;
-    out.pos = mul(lightSpaceMatrix, mul(constants.model, float4(vi.position, 1.0)));
+    out.pos = mul(lightSpaceMatrix, mul(constants.model, float4(position, 1.0)));
     return out;
 }
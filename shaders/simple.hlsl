@@ -1,13 +1,6 @@
 #include "pack.h"
 #include "shadow.h"
-
-struct VertexInput
-{
-    float3 position : POSITION;
-    uint32_t tangent;
-    uint32_t normal;
-    uint32_t uv;
-};
+#include "vertexlayout.h"
 
 struct Material
 {
@@ -44,17 +37,17 @@ struct InstanceConstants
 {
     float4x4 model;
     float4x4 normalMatrix;
+    float3 posScale; // dequantization of compact vertex positions
     int32_t materialId;
-    int32_t pad0;
-    int32_t pad1;
-    int32_t pad2;
+    float3 posBias;
+    uint32_t vertexLayout; // VERTEX_LAYOUT_*, used with vertex pulling
 };
 
 struct PS_INPUT
 {
     float4 pos : SV_POSITION;
     float4 posLightSpace;
-    float3 tangent;
+    float4 tangent; // w is bitangent handedness
     float3 normal;
     float3 wPos;
     float2 uv;
@@ -83,6 +76,9 @@ StructuredBuffer<Material> materials;
 Texture2D shadowMap;
 SamplerState shadowSamp;
 StructuredBuffer<InstanceConstants> instanceConstants;
+#if defined(NEVK_VERTEX_PULLING)
+StructuredBuffer<uint32_t> vertices;
+#endif
 
 static const float4x4 biasMatrix = float4x4(
   0.5, 0.0, 0.0, 0.5,
@@ -91,18 +87,27 @@ static const float4x4 biasMatrix = float4x4(
   0.0, 0.0, 0.0, 1.0 );
 
 [shader("vertex")]
+#if defined(NEVK_VERTEX_PULLING)
+PS_INPUT vertexMain(uint32_t vertexId : SV_VertexID)
+#else
 PS_INPUT vertexMain(VertexInput vi)
+#endif
 {
     PS_INPUT out;
     InstanceConstants constants = instanceConstants[NonUniformResourceIndex(pconst.instanceId)];
-    float4 wpos = mul(constants.model, float4(vi.position, 1.0f));
+#if defined(NEVK_VERTEX_PULLING)
+    Vertex v = pullVertex(vertices, vertexId, constants.vertexLayout, constants.posScale, constants.posBias);
+#else
+    Vertex v = decodeVertex(vi, constants.posScale, constants.posBias);
+#endif
+    float4 wpos = mul(constants.model, float4(v.position, 1.0f));
     out.pos = mul(viewToProj, mul(worldToView, wpos));
     out.posLightSpace = mul(biasMatrix, mul(lightSpaceMatrix, wpos));
-    out.uv = unpackUV(vi.uv);
+    out.uv = v.uv;
     // assume that we don't use non-uniform scales
     // TODO:
-    out.normal = mul((float3x3)constants.normalMatrix, unpackNormal(vi.normal));
-    out.tangent = unpackTangent(vi.tangent);
+    out.normal = mul((float3x3)constants.normalMatrix, v.normal);
+    out.tangent = float4(mul((float3x3)constants.model, v.tangent.xyz), v.tangent.w);
     out.wPos = wpos.xyz / wpos.w; 
     return out;
 }
@@ -120,9 +125,9 @@ float3 specularPhong(float3 kS, float3 r, float3 v, float shinessFactor)
 float3 CalcBumpedNormal(PS_INPUT inp, uint32_t texId)
 {
     float3 Normal = normalize(inp.normal);
-    float3 Tangent = -normalize(inp.tangent);
+    float3 Tangent = normalize(inp.tangent.xyz);
     Tangent = normalize(Tangent - dot(Tangent, Normal) * Normal);
-    float3 Bitangent = cross(Normal, Tangent);
+    float3 Bitangent = cross(Normal, Tangent) * inp.tangent.w;
 
     float3 BumpMapNormal = textures[NonUniformResourceIndex(texId)].Sample(gSampler, inp.uv).xyz;
     BumpMapNormal = BumpMapNormal * 2.0 - 1.0;
@@ -0,0 +1,132 @@
+#pragma once
+#include "pack.h"
+
+// Vertex inputs of layouts from getVertexLayoutDesc() in scene/vertexlayout.h,
+// renderer defines NEVK_VERTEX_COMPACT for all shaders when compact layout is selected.
+// With NEVK_VERTEX_PULLING there is no vertex input, vertices are read from storage buffer
+// and decoded by layout from instance constants, so one shader serves every layout
+#if defined(NEVK_VERTEX_COMPACT)
+// xyz is position quantized to mesh bounds, w is tangent angle around normal
+typedef uint4 VertexPosition;
+#else
+typedef float3 VertexPosition;
+#endif
+
+struct VertexInput
+{
+    VertexPosition position : POSITION;
+#if !defined(NEVK_VERTEX_COMPACT)
+    uint32_t tangent;
+#endif
+    uint32_t normal;
+    uint32_t uv;
+};
+
+// depth only passes bind just position attribute
+struct PositionInput
+{
+    VertexPosition position : POSITION;
+};
+
+// decoded vertex in local space
+struct Vertex
+{
+    float3 position;
+    float4 tangent; // w is bitangent handedness
+    float3 normal;
+    float2 uv;
+};
+
+// values of nevk::VertexLayout
+static const uint32_t VERTEX_LAYOUT_FULL = 0;
+static const uint32_t VERTEX_LAYOUT_COMPACT = 1;
+
+// local space position, scale and bias are dequantization of instance mesh
+float3 decodePosition(VertexPosition position, float3 scale, float3 bias)
+{
+#if defined(NEVK_VERTEX_COMPACT)
+    return float3(position.xyz) * scale + bias;
+#else
+    return position;
+#endif
+}
+
+// Orthonormal basis around unit normal, same operations as tangentBasis() in modelloader.cpp
+void tangentBasis(float3 n, out float3 b1, out float3 b2)
+{
+    float sign = n.z >= 0.0f ? 1.0f : -1.0f;
+    float a = -1.0f / (sign + n.z);
+    float b = n.x * n.y * a;
+    b1 = float3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    b2 = float3(b, sign + n.y * n.y * a, -n.y);
+}
+
+// tangent of compact vertex, angle in low 15 bits and handedness in 16th
+float4 decodeTangentAngle(uint32_t packed, float3 normal)
+{
+    float3 b1;
+    float3 b2;
+    tangentBasis(normal, b1, b2);
+    float angle = ((packed & 0x7fff) / 32768.0f - 0.5f) * 6.28318530718f;
+    return float4(cos(angle) * b1 + sin(angle) * b2, (packed & 0x8000) ? -1.0f : 1.0f);
+}
+
+// w is bitangent handedness, normal is unpacked normal of the same vertex
+float4 decodeTangent(VertexInput vi, float3 normal)
+{
+#if defined(NEVK_VERTEX_COMPACT)
+    return decodeTangentAngle(vi.position.w, normal);
+#else
+    return unpackTangent(vi.tangent);
+#endif
+}
+
+Vertex decodeVertex(VertexInput vi, float3 scale, float3 bias)
+{
+    Vertex v;
+    v.position = decodePosition(vi.position, scale, bias);
+    v.normal = unpackNormal(vi.normal);
+    v.tangent = decodeTangent(vi, v.normal);
+    v.uv = unpackUV(vi.uv);
+    return v;
+}
+
+// Vertex pulling. Buffers are raw 32 bit words of vertex and position streams, strides are the ones of VertexLayoutDesc.
+// vertexId is SV_VertexID, in Vulkan it already includes vertexOffset of draw, i.e. base vertex of mesh
+Vertex pullVertex(StructuredBuffer<uint32_t> words, uint32_t vertexId, uint32_t layout, float3 scale, float3 bias)
+{
+    Vertex v;
+    if (layout == VERTEX_LAYOUT_COMPACT)
+    {
+        // x | y << 16, z | tangent << 16, normal, uv
+        uint32_t base = vertexId * 4;
+        uint32_t xy = words[base];
+        uint32_t zt = words[base + 1];
+        v.position = float3(xy & 0xffff, xy >> 16, zt & 0xffff) * scale + bias;
+        v.normal = unpackNormal(words[base + 2]);
+        v.tangent = decodeTangentAngle(zt >> 16, v.normal);
+        v.uv = unpackUV(words[base + 3]);
+    }
+    else
+    {
+        // Scene::Vertex: pos, tangent, normal, uv
+        uint32_t base = vertexId * 6;
+        v.position = asfloat(uint3(words[base], words[base + 1], words[base + 2]));
+        v.normal = unpackNormal(words[base + 4]);
+        v.tangent = unpackTangent(words[base + 3]);
+        v.uv = unpackUV(words[base + 5]);
+    }
+    return v;
+}
+
+float3 pullPosition(StructuredBuffer<uint32_t> words, uint32_t vertexId, uint32_t layout, float3 scale, float3 bias)
+{
+    if (layout == VERTEX_LAYOUT_COMPACT)
+    {
+        uint32_t base = vertexId * 2;
+        uint32_t xy = words[base];
+        return float3(xy & 0xffff, xy >> 16, words[base + 1] & 0xffff) * scale + bias;
+    }
+    uint32_t base = vertexId * 3;
+    return asfloat(uint3(words[base], words[base + 1], words[base + 2]));
+}
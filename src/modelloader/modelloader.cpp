@@ -1,6 +1,9 @@
 #include "modelloader.h"
 
 #include "camera.h"
+#include "scene/meshoptimizer.h"
+#include "scene/scenesnapshot.h"
+#include "scene/simd.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_IMPLEMENTATION
@@ -16,11 +19,35 @@
 #include <glm/gtx/compatibility.hpp>
 #include <glm/gtx/matrix_decompose.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <unordered_map>
+#include <utility>
 
 namespace nevk
 {
 
+// Mesh created for glTF (mesh, primitive) pair, reused by every node referencing it.
+// Geometry is decoded in parallel before node traversal and moved into scene by first node using it
+struct PrimitiveCacheEntry
+{
+    uint32_t meshId = Scene::kInvalidId;
+    glm::float3 massCenter{ 0.0f }; // local space
+    std::vector<Scene::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    bool valid = false; // false for unsupported primitive
+    VertexCacheStats cacheBefore;
+    VertexCacheStats cacheAfter;
+    std::vector<Meshlet> meshlets;
+    std::vector<Scene::LodGeometry> lods;
+};
+using PrimitiveCache = std::unordered_map<uint64_t, PrimitiveCacheEntry>;
+
 //  valid range of coordinates [-10; 10]
 uint32_t packUV(const glm::float2& uv)
 {
@@ -29,66 +56,857 @@ uint32_t packUV(const glm::float2& uv)
     return packed;
 }
 
-//  valid range of coordinates [-1; 1]
+// Octahedral encoding: unit vector is projected on octahedron |x| + |y| + |z| = 1, lower half is folded over diagonals
+// and (x, y) in [-1; 1] is stored as two integers in [0; 2 * scale]. Code 0 is reserved for zero vector, the only other
+// vector giving 0 is -z which gets opposite corner instead. Decoding matches octDecode in shaders/pack.h.
+// SIMD kernels below repeat scalar operations in the same order, results are bitwise equal only while compiler
+// does not contract multiply-adds, so this file is built with -ffp-contract=off (MSVC /fp:precise without /fp:contract)
+constexpr float kNormalScale = 32767.0f; // 16 bits per axis
+constexpr float kTangentScale = 16383.0f; // 15 bits per axis
+constexpr uint32_t kNormalShift = 16;
+constexpr uint32_t kTangentShift = 15;
+constexpr uint32_t kTangentHandednessBit = 0x40000000;
+
+static uint32_t octEncode(const float x, const float y, const float z, const float scale, const uint32_t shift)
+{
+    const float l1 = (std::fabs(x) + std::fabs(y)) + std::fabs(z);
+    if (l1 == 0.0f)
+    {
+        return 0;
+    }
+    float px = x / l1;
+    float py = y / l1;
+    if (z < 0.0f)
+    {
+        const float fx = (1.0f - std::fabs(py)) * (px >= 0.0f ? 1.0f : -1.0f);
+        const float fy = (1.0f - std::fabs(px)) * (py >= 0.0f ? 1.0f : -1.0f);
+        px = fx;
+        py = fy;
+    }
+    const float bias = scale + 0.5f; // truncation of positive value rounds to nearest
+    const uint32_t u = (uint32_t)(std::min(std::max(px, -1.0f), 1.0f) * scale + bias);
+    const uint32_t v = (uint32_t)(std::min(std::max(py, -1.0f), 1.0f) * scale + bias);
+    const uint32_t packed = u | (v << shift);
+    return packed != 0 ? packed : (uint32_t)(2 * scale) * ((1u << shift) + 1);
+}
+
+static glm::float3 octDecode(const uint32_t u, const uint32_t v, const float scale)
+{
+    float x = (float)u / scale - 1.0f;
+    float y = (float)v / scale - 1.0f;
+    const float z = (1.0f - std::fabs(x)) - std::fabs(y);
+    // written as comparison so sign of zero is the same as with max instruction
+    const float t = -z > 0.0f ? -z : 0.0f;
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    const float length = std::sqrt((x * x + y * y) + z * z);
+    return glm::float3(x / length, y / length, z / length);
+}
+
 uint32_t packNormal(const glm::float3& normal)
 {
-    uint32_t packed = (uint32_t)((normal.x + 1.0f) / 2.0f * 511.99999f);
-    packed += (uint32_t)((normal.y + 1.0f) / 2.0f * 511.99999f) << 10;
-    packed += (uint32_t)((normal.z + 1.0f) / 2.0f * 511.99999f) << 20;
-    return packed;
+    return octEncode(normal.x, normal.y, normal.z, kNormalScale, kNormalShift);
 }
 
-//  valid range of coordinates [-10; 10]
-uint32_t packTangent(const glm::float3& tangent)
+uint32_t packTangent(const glm::float3& tangent, const float handedness)
 {
-    uint32_t packed = (uint32_t)((tangent.x + 10.0f) / 20.0f * 511.99999f);
-    packed += (uint32_t)((tangent.y + 10.0f) / 20.0f * 511.99999f) << 10;
-    packed += (uint32_t)((tangent.z + 10.0f) / 20.0f * 511.99999f) << 20;
-    return packed;
+    return octEncode(tangent.x, tangent.y, tangent.z, kTangentScale, kTangentShift) | (handedness < 0.0f ? kTangentHandednessBit : 0);
 }
 
+// inverse of packUV, matches unpackUV in shaders/pack.h
 glm::float2 unpackUV(uint32_t val)
 {
     glm::float2 uv;
-    uv.y = ((val & 0xffff0000) >> 16) / 16383.99999f * 10.0f - 5.0f;
-    uv.x = (val & 0x0000ffff) / 16383.99999f * 10.0f - 5.0f;
+    uv.y = ((val & 0xffff0000) >> 16) / 16383.99999f * 20.0f - 10.0f;
+    uv.x = (val & 0x0000ffff) / 16383.99999f * 20.0f - 10.0f;
 
     return uv;
 }
 
-void ModelLoader::computeTangent(std::vector<Scene::Vertex>& vertices,
-                                 const std::vector<uint32_t>& indices) const
+glm::float3 unpackNormal(const uint32_t val)
+{
+    return octDecode(val & 0xffff, val >> kNormalShift, kNormalScale);
+}
+
+glm::float4 unpackTangent(const uint32_t val)
+{
+    return glm::float4(octDecode(val & 0x7fff, (val >> kTangentShift) & 0x7fff, kTangentScale), (val & kTangentHandednessBit) ? -1.0f : 1.0f);
+}
+
+#if defined(NEVK_SSE)
+// Gathers one component of 4 consecutive float3/float4 into register
+static __m128 gather4(const float* src, const size_t stride)
+{
+    return _mm_set_ps(src[3 * stride], src[2 * stride], src[stride], src[0]);
+}
+
+static __m128 select4(const __m128 mask, const __m128 a, const __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// octEncode() of 4 vectors
+static __m128i octEncode4(const __m128 x, const __m128 y, const __m128 z, const float scale, const uint32_t shift)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    const __m128 l1 = _mm_add_ps(_mm_add_ps(_mm_andnot_ps(signMask, x), _mm_andnot_ps(signMask, y)), _mm_andnot_ps(signMask, z));
+    const __m128 valid = _mm_cmpneq_ps(l1, zero);
+    __m128 px = _mm_div_ps(x, l1);
+    __m128 py = _mm_div_ps(y, l1);
+    const __m128 fx = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, py)), select4(_mm_cmpge_ps(px, zero), one, minusOne));
+    const __m128 fy = _mm_mul_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, px)), select4(_mm_cmpge_ps(py, zero), one, minusOne));
+    const __m128 lower = _mm_cmplt_ps(z, zero);
+    px = select4(lower, fx, px);
+    py = select4(lower, fy, py);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    const __m128 bias4 = _mm_set1_ps(scale + 0.5f);
+    const __m128i u = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(px, minusOne), one), scale4), bias4));
+    const __m128i v = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(py, minusOne), one), scale4), bias4));
+    __m128i packed = _mm_or_si128(u, _mm_sll_epi32(v, _mm_cvtsi32_si128((int)shift)));
+    const __m128i corner = _mm_set1_epi32((int)((uint32_t)(2 * scale) * ((1u << shift) + 1)));
+    const __m128i isZero = _mm_cmpeq_epi32(packed, _mm_setzero_si128());
+    packed = _mm_or_si128(_mm_and_si128(isZero, corner), _mm_andnot_si128(isZero, packed));
+    return _mm_and_si128(_mm_castps_si128(valid), packed);
+}
+
+// octDecode() of 4 codes
+static void octDecode4(const __m128i u, const __m128i v, const float scale, __m128& x, __m128& y, __m128& z)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale4 = _mm_set1_ps(scale);
+    x = _mm_sub_ps(_mm_div_ps(_mm_cvtepi32_ps(u), scale4), one);
+    y = _mm_sub_ps(_mm_div_ps(_mm_cvtepi32_ps(v), scale4), one);
+    z = _mm_sub_ps(_mm_sub_ps(one, _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+    const __m128 t = _mm_max_ps(_mm_xor_ps(z, signMask), zero);
+    const __m128 negT = _mm_xor_ps(t, signMask);
+    x = _mm_add_ps(x, select4(_mm_cmpge_ps(x, zero), negT, t));
+    y = _mm_add_ps(y, select4(_mm_cmpge_ps(y, zero), negT, t));
+    const __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+    x = _mm_div_ps(x, length);
+    y = _mm_div_ps(y, length);
+    z = _mm_div_ps(z, length);
+}
+#endif
+
+#if defined(NEVK_AVX)
+static __m256 gather8(const float* src, const size_t stride)
+{
+    return _mm256_set_ps(src[7 * stride], src[6 * stride], src[5 * stride], src[4 * stride],
+                         src[3 * stride], src[2 * stride], src[stride], src[0]);
+}
+
+static __m256 select8(const __m256 mask, const __m256 a, const __m256 b)
+{
+    return _mm256_or_ps(_mm256_and_ps(mask, a), _mm256_andnot_ps(mask, b));
+}
+
+// octEncode() of 8 vectors, float part runs on 8 lanes, integer part on two halves since AVX has no 256-bit integer ops
+static void octEncode8(const __m256 x, const __m256 y, const __m256 z, const float scale, const uint32_t shift, uint32_t* out)
+{
+    const __m256 signMask = _mm256_set1_ps(-0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 minusOne = _mm256_set1_ps(-1.0f);
+    const __m256 l1 = _mm256_add_ps(_mm256_add_ps(_mm256_andnot_ps(signMask, x), _mm256_andnot_ps(signMask, y)), _mm256_andnot_ps(signMask, z));
+    const __m256 valid = _mm256_cmp_ps(l1, zero, _CMP_NEQ_UQ);
+    __m256 px = _mm256_div_ps(x, l1);
+    __m256 py = _mm256_div_ps(y, l1);
+    const __m256 fx = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signMask, py)), select8(_mm256_cmp_ps(px, zero, _CMP_GE_OQ), one, minusOne));
+    const __m256 fy = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_andnot_ps(signMask, px)), select8(_mm256_cmp_ps(py, zero, _CMP_GE_OQ), one, minusOne));
+    const __m256 lower = _mm256_cmp_ps(z, zero, _CMP_LT_OQ);
+    px = select8(lower, fx, px);
+    py = select8(lower, fy, py);
+    const __m256 scale8 = _mm256_set1_ps(scale);
+    const __m256 bias8 = _mm256_set1_ps(scale + 0.5f);
+    alignas(32) int32_t u[8];
+    alignas(32) int32_t v[8];
+    alignas(32) int32_t mask[8];
+    _mm256_store_si256((__m256i*)u, _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(px, minusOne), one), scale8), bias8)));
+    _mm256_store_si256((__m256i*)v, _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(py, minusOne), one), scale8), bias8)));
+    _mm256_store_ps((float*)mask, valid);
+    const __m128i count = _mm_cvtsi32_si128((int)shift);
+    const __m128i corner = _mm_set1_epi32((int)((uint32_t)(2 * scale) * ((1u << shift) + 1)));
+    for (uint32_t half = 0; half < 8; half += 4)
+    {
+        __m128i packed = _mm_or_si128(_mm_load_si128((const __m128i*)(u + half)), _mm_sll_epi32(_mm_load_si128((const __m128i*)(v + half)), count));
+        const __m128i isZero = _mm_cmpeq_epi32(packed, _mm_setzero_si128());
+        packed = _mm_or_si128(_mm_and_si128(isZero, corner), _mm_andnot_si128(isZero, packed));
+        _mm_storeu_si128((__m128i*)(out + half), _mm_and_si128(_mm_load_si128((const __m128i*)(mask + half)), packed));
+    }
+}
+#endif
+
+void packNormals(const glm::float3* normals, const size_t count, Scene::Vertex* vertices)
+{
+    const float* src = &normals[0].x;
+    size_t i = 0;
+#if defined(NEVK_AVX)
+    for (; i + 8 <= count; i += 8)
+    {
+        alignas(16) uint32_t packed[8];
+        octEncode8(gather8(src + i * 3, 3), gather8(src + i * 3 + 1, 3), gather8(src + i * 3 + 2, 3), kNormalScale, kNormalShift, packed);
+        for (uint32_t lane = 0; lane < 8; ++lane)
+        {
+            vertices[i + lane].normal = packed[lane];
+        }
+    }
+#endif
+#if defined(NEVK_SSE)
+    for (; i + 4 <= count; i += 4)
+    {
+        alignas(16) uint32_t packed[4];
+        _mm_store_si128((__m128i*)packed, octEncode4(gather4(src + i * 3, 3), gather4(src + i * 3 + 1, 3), gather4(src + i * 3 + 2, 3), kNormalScale, kNormalShift));
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            vertices[i + lane].normal = packed[lane];
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        vertices[i].normal = packNormal(normals[i]);
+    }
+}
+
+void packTangents(const glm::float4* tangents, const size_t count, Scene::Vertex* vertices)
+{
+    const float* src = &tangents[0].x;
+    size_t i = 0;
+#if defined(NEVK_AVX)
+    for (; i + 8 <= count; i += 8)
+    {
+        alignas(16) uint32_t packed[8];
+        octEncode8(gather8(src + i * 4, 4), gather8(src + i * 4 + 1, 4), gather8(src + i * 4 + 2, 4), kTangentScale, kTangentShift, packed);
+        for (uint32_t lane = 0; lane < 8; ++lane)
+        {
+            vertices[i + lane].tangent = packed[lane] | (tangents[i + lane].w < 0.0f ? kTangentHandednessBit : 0);
+        }
+    }
+#endif
+#if defined(NEVK_SSE)
+    for (; i + 4 <= count; i += 4)
+    {
+        alignas(16) uint32_t packed[4];
+        _mm_store_si128((__m128i*)packed, octEncode4(gather4(src + i * 4, 4), gather4(src + i * 4 + 1, 4), gather4(src + i * 4 + 2, 4), kTangentScale, kTangentShift));
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            vertices[i + lane].tangent = packed[lane] | (tangents[i + lane].w < 0.0f ? kTangentHandednessBit : 0);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        vertices[i].tangent = packTangent(glm::float3(tangents[i]), tangents[i].w);
+    }
+}
+
+void unpackNormals(const Scene::Vertex* vertices, const size_t count, glm::float3* normals)
+{
+    size_t i = 0;
+#if defined(NEVK_SSE)
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i packed = _mm_set_epi32((int)vertices[i + 3].normal, (int)vertices[i + 2].normal, (int)vertices[i + 1].normal, (int)vertices[i].normal);
+        const __m128i mask = _mm_set1_epi32(0xffff);
+        __m128 x, y, z;
+        octDecode4(_mm_and_si128(packed, mask), _mm_srli_epi32(packed, kNormalShift), kNormalScale, x, y, z);
+        alignas(16) float lanes[3][4];
+        _mm_store_ps(lanes[0], x);
+        _mm_store_ps(lanes[1], y);
+        _mm_store_ps(lanes[2], z);
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            normals[i + lane] = glm::float3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        normals[i] = unpackNormal(vertices[i].normal);
+    }
+}
+
+void unpackTangents(const Scene::Vertex* vertices, const size_t count, glm::float4* tangents)
+{
+    size_t i = 0;
+#if defined(NEVK_SSE)
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i packed = _mm_set_epi32((int)vertices[i + 3].tangent, (int)vertices[i + 2].tangent, (int)vertices[i + 1].tangent, (int)vertices[i].tangent);
+        const __m128i mask = _mm_set1_epi32(0x7fff);
+        __m128 x, y, z;
+        octDecode4(_mm_and_si128(packed, mask), _mm_and_si128(_mm_srli_epi32(packed, kTangentShift), mask), kTangentScale, x, y, z);
+        alignas(16) float lanes[3][4];
+        _mm_store_ps(lanes[0], x);
+        _mm_store_ps(lanes[1], y);
+        _mm_store_ps(lanes[2], z);
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            const float w = (vertices[i + lane].tangent & kTangentHandednessBit) ? -1.0f : 1.0f;
+            tangents[i + lane] = glm::float4(lanes[0][lane], lanes[1][lane], lanes[2][lane], w);
+        }
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        tangents[i] = unpackTangent(vertices[i].tangent);
+    }
+}
+
+// Orthonormal basis around unit normal (Duff et al. 2017), same operations as tangentBasis() in shaders/vertexlayout.h
+static void tangentBasis(const glm::float3& n, glm::float3& b1, glm::float3& b2)
+{
+    const float sign = n.z >= 0.0f ? 1.0f : -1.0f;
+    const float a = -1.0f / (sign + n.z);
+    const float b = n.x * n.y * a;
+    b1 = glm::float3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    b2 = glm::float3(b, sign + n.y * n.y * a, -n.y);
+}
+
+constexpr float kTwoPi = 6.28318530718f;
+constexpr uint32_t kTangentAngleSteps = 1u << 15;
+constexpr uint16_t kTangentAngleHandednessBit = 0x8000;
+
+uint16_t packTangentAngle(const glm::float3& normal, const glm::float4& tangent)
+{
+    glm::float3 b1, b2;
+    tangentBasis(normal, b1, b2);
+    // component along normal is dropped, tangent parallel to normal gets angle 0
+    const float angle = std::atan2(glm::dot(glm::float3(tangent), b2), glm::dot(glm::float3(tangent), b1));
+    const uint32_t step = (uint32_t)std::lround((angle / kTwoPi + 0.5f) * kTangentAngleSteps) & (kTangentAngleSteps - 1);
+    return (uint16_t)(step | (tangent.w < 0.0f ? kTangentAngleHandednessBit : 0));
+}
+
+glm::float4 unpackTangentAngle(const glm::float3& normal, const uint16_t val)
+{
+    glm::float3 b1, b2;
+    tangentBasis(normal, b1, b2);
+    const float angle = ((val & (kTangentAngleSteps - 1)) / (float)kTangentAngleSteps - 0.5f) * kTwoPi;
+    return glm::float4(std::cos(angle) * b1 + std::sin(angle) * b2, (val & kTangentAngleHandednessBit) ? -1.0f : 1.0f);
+}
+
+std::vector<CompactVertex> packCompactVertices(const std::vector<Mesh>& meshes, const Scene::Vertex* vertices, const size_t count)
+{
+    std::vector<CompactVertex> res(count, CompactVertex{});
+    std::vector<glm::float3> normals;
+    std::vector<glm::float4> tangents;
+    for (const Mesh& mesh : meshes)
+    {
+        // removed meshes have no vertices
+        if (mesh.mVertexCount == 0 || (size_t)mesh.mVertexOffset + mesh.mVertexCount > count)
+        {
+            continue;
+        }
+        const Scene::Vertex* src = vertices + mesh.mVertexOffset;
+        CompactVertex* dst = res.data() + mesh.mVertexOffset;
+        normals.resize(mesh.mVertexCount);
+        tangents.resize(mesh.mVertexCount);
+        unpackNormals(src, mesh.mVertexCount, normals.data());
+        unpackTangents(src, mesh.mVertexCount, tangents.data());
+
+        glm::float3 scale, bias;
+        getPositionQuantization(mesh.mBounds, scale, bias);
+        const glm::float3 invScale = glm::float3(scale.x > 0.0f ? 1.0f / scale.x : 0.0f,
+                                                 scale.y > 0.0f ? 1.0f / scale.y : 0.0f,
+                                                 scale.z > 0.0f ? 1.0f / scale.z : 0.0f);
+        auto quantize = [](const float value, const float bias, const float invScale) {
+            return (uint16_t)std::min(std::max(std::lround((value - bias) * invScale), 0l), 65535l);
+        };
+        for (uint32_t i = 0; i < mesh.mVertexCount; ++i)
+        {
+            dst[i].pos[0] = quantize(src[i].pos.x, bias.x, invScale.x);
+            dst[i].pos[1] = quantize(src[i].pos.y, bias.y, invScale.y);
+            dst[i].pos[2] = quantize(src[i].pos.z, bias.z, invScale.z);
+            dst[i].tangent = packTangentAngle(normals[i], tangents[i]);
+            dst[i].normal = src[i].normal;
+            dst[i].uv = src[i].uv;
+        }
+    }
+    return res;
+}
+
+// Decodes images to RGBA8 on thread pool while caller goes on with geometry,
+// 1-3 channel images are expanded to RGBA on worker as well
+class ImageDecoder
+{
+public:
+    struct Image
+    {
+        std::string path; // file to decode when there are no encoded bytes
+        std::vector<unsigned char> encoded;
+        std::vector<uint8_t> pixels;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
+    ImageDecoder() = default;
+    ImageDecoder(const ImageDecoder&) = delete;
+    ImageDecoder& operator=(const ImageDecoder&) = delete;
+
+    ~ImageDecoder()
+    {
+        for (std::future<void>& f : mPending)
+        {
+            f.wait();
+        }
+    }
+
+    // Images can be added only before start()
+    std::vector<Image>& getImages()
+    {
+        return mImages;
+    }
+
+    // Without pool images are decoded serially in wait()
+    void start(ThreadPool* pool)
+    {
+        if (!pool)
+        {
+            return;
+        }
+        mPending.reserve(mImages.size());
+        for (Image& image : mImages)
+        {
+            mPending.push_back(pool->enqueue([&image]() { decode(image); }));
+        }
+    }
+
+    void wait()
+    {
+        if (mDone)
+        {
+            return;
+        }
+        if (mPending.empty())
+        {
+            for (Image& image : mImages)
+            {
+                decode(image);
+            }
+        }
+        for (std::future<void>& f : mPending)
+        {
+            f.get();
+        }
+        mPending.clear();
+        mDone = true;
+    }
+
+    // Moves decoded pixels out after wait(). Image which failed to decode is replaced by white texel, so texture ids do not shift
+    ImportedImage takeImage(const size_t index, const std::string& name)
+    {
+        Image& image = mImages[index];
+        if (image.pixels.empty())
+        {
+            std::cerr << "Unable to decode texture: " << name << std::endl;
+            return { name, std::vector<uint8_t>(4, 0xFF), 1, 1 };
+        }
+        return { name, std::move(image.pixels), image.width, image.height };
+    }
+
+private:
+    static void decode(Image& image)
+    {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        stbi_uc* pixels = nullptr;
+        if (image.encoded.empty())
+        {
+            pixels = stbi_load(image.path.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        }
+        else
+        {
+            pixels = stbi_load_from_memory(image.encoded.data(), (int)image.encoded.size(), &width, &height, &channels, STBI_rgb_alpha);
+        }
+        if (pixels)
+        {
+            image.pixels.assign(pixels, pixels + (size_t)width * height * 4);
+            image.width = width;
+            image.height = height;
+            stbi_image_free(pixels);
+        }
+        std::vector<unsigned char>().swap(image.encoded);
+    }
+
+    std::vector<Image> mImages;
+    std::vector<std::future<void>> mPending;
+    bool mDone = false;
+};
+
+// Texture of OBJ material, image path is kept in scene so scene can be saved as snapshot.
+// Ids follow first appearance of path, new images are queued for decoding
+int loadObjTexture(nevk::Scene& scene, const std::string& texName, const std::string& mtlPath, ImageDecoder* decoder)
+{
+    if (texName.empty())
+    {
+        return -1;
+    }
+    std::string path = mtlPath + "/" + texName;
+    std::replace(path.begin(), path.end(), '\\', '/');
+
+    const int texId = (int)(std::find(scene.mTexturePaths.begin(), scene.mTexturePaths.end(), path) - scene.mTexturePaths.begin());
+    if (texId == (int)scene.mTexturePaths.size())
+    {
+        scene.mTexturePaths.push_back(path);
+        if (decoder)
+        {
+            decoder->getImages().emplace_back();
+            decoder->getImages().back().path = path;
+        }
+    }
+    return texId;
+}
+
+static uint32_t hashVertex(const Scene::Vertex& vertex)
+{
+    uint32_t words[sizeof(Scene::Vertex) / sizeof(uint32_t)];
+    memcpy(words, &vertex, sizeof(words));
+    uint32_t hash = 2166136261u;
+    for (const uint32_t word : words)
+    {
+        hash = (hash ^ word) * 16777619u;
+        hash ^= hash >> 15;
+    }
+    return hash;
+}
+
+size_t ModelLoader::weldVertices(std::vector<Scene::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    static_assert(sizeof(Scene::Vertex) % sizeof(uint32_t) == 0, "vertex is hashed by 32-bit words");
+    constexpr uint32_t kEmpty = (uint32_t)-1;
+
+    // open addressing with linear probing, load factor <= 0.5
+    size_t capacity = 16;
+    while (capacity < vertices.size() * 2)
+    {
+        capacity <<= 1;
+    }
+    const size_t mask = capacity - 1;
+    std::vector<uint32_t> table(capacity, kEmpty); // index of unique vertex
+    std::vector<uint32_t> remap(vertices.size());
+
+    uint32_t uniqueCount = 0;
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const Scene::Vertex vertex = vertices[i];
+        size_t slot = hashVertex(vertex) & mask;
+        while (table[slot] != kEmpty && memcmp(&vertices[table[slot]], &vertex, sizeof(vertex)) != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        if (table[slot] == kEmpty)
+        {
+            // unique vertices are compacted in place, write position never passes read position
+            table[slot] = uniqueCount;
+            vertices[uniqueCount++] = vertex;
+        }
+        remap[i] = table[slot];
+    }
+    vertices.resize(uniqueCount);
+    for (uint32_t& index : indices)
+    {
+        index = remap[index];
+    }
+    return uniqueCount;
+}
+
+// acos with absolute error below 1e-4, good enough for weights (Abramowitz and Stegun 4.4.45)
+static float acosApprox(const float x)
+{
+    const float a = std::min(std::fabs(x), 1.0f);
+    const float r = std::sqrt(1.0f - a) * (1.5707288f + a * (-0.2121144f + a * (0.0742610f - 0.0187293f * a)));
+    return x < 0.0f ? 3.14159265f - r : r;
+}
+
+#if defined(NEVK_SSE)
+static __m128 acosApprox4(const __m128 x)
+{
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 a = _mm_min_ps(_mm_andnot_ps(signMask, x), _mm_set1_ps(1.0f));
+    __m128 poly = _mm_add_ps(_mm_set1_ps(0.0742610f), _mm_mul_ps(a, _mm_set1_ps(-0.0187293f)));
+    poly = _mm_add_ps(_mm_set1_ps(-0.2121144f), _mm_mul_ps(a, poly));
+    poly = _mm_add_ps(_mm_set1_ps(1.5707288f), _mm_mul_ps(a, poly));
+    const __m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a)), poly);
+    const __m128 negative = _mm_cmplt_ps(x, _mm_setzero_ps());
+    return _mm_or_ps(_mm_and_ps(negative, _mm_sub_ps(_mm_set1_ps(3.14159265f), r)), _mm_andnot_ps(negative, r));
+}
+#endif
+
+// Unit face tangent and bitangent of triangle and its corner angles, weights are 0 for degenerate triangle.
+// UV origin is top left (OBJ v is flipped on import), bitangent points to decreasing v like glTF TANGENT.w expects
+struct FaceTangents
+{
+    glm::float3 tangent;
+    glm::float3 bitangent;
+    float angles[3];
+};
+
+static FaceTangents computeFaceTangents(const glm::float3 p[3], const glm::float2 uv[3])
+{
+    FaceTangents face{};
+    const glm::float3 e1 = p[1] - p[0];
+    const glm::float3 e2 = p[2] - p[0];
+    const glm::float3 e3 = p[2] - p[1];
+    const glm::float2 duv1 = uv[1] - uv[0];
+    const glm::float2 duv2 = uv[2] - uv[0];
+    const float det = duv1.x * duv2.y - duv1.y * duv2.x;
+    const glm::float3 tangent = (e1 * duv2.y - e2 * duv1.y) * det;
+    const glm::float3 bitangent = (e1 * duv2.x - e2 * duv1.x) * det;
+    const float tangentLength = glm::length(tangent);
+    const float bitangentLength = glm::length(bitangent);
+    const glm::float3 normal = glm::cross(e1, e2);
+    if (tangentLength == 0.0f || bitangentLength == 0.0f || glm::dot(normal, normal) == 0.0f)
+    {
+        return face;
+    }
+    face.tangent = tangent / tangentLength;
+    face.bitangent = bitangent / bitangentLength;
+    const float l1 = glm::length(e1);
+    const float l2 = glm::length(e2);
+    const float l3 = glm::length(e3);
+    face.angles[0] = acosApprox(glm::dot(e1, e2) / (l1 * l2));
+    face.angles[1] = acosApprox(-glm::dot(e1, e3) / (l1 * l3));
+    face.angles[2] = acosApprox(glm::dot(e2, e3) / (l2 * l3));
+    return face;
+}
+
+void ModelLoader::computeTangents(std::vector<Scene::Vertex>& vertices, const std::vector<uint32_t>& indices)
 {
-    const size_t lastIndex = indices.size();
-    Scene::Vertex& v0 = vertices[indices[lastIndex - 3]];
-    Scene::Vertex& v1 = vertices[indices[lastIndex - 2]];
-    Scene::Vertex& v2 = vertices[indices[lastIndex - 1]];
+    const size_t vertexCount = vertices.size();
+    const size_t triangleCount = indices.size() / 3;
+    std::vector<glm::float2> uvs(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        uvs[v] = unpackUV(vertices[v].uv);
+    }
 
-    glm::float2 uv0 = unpackUV(v0.uv);
-    glm::float2 uv1 = unpackUV(v1.uv);
-    glm::float2 uv2 = unpackUV(v2.uv);
+    // angle weighted sums of unit face directions, so neither triangle size nor UV scale bias result
+    std::vector<glm::float3> tangents(vertexCount, glm::float3(0.0f));
+    std::vector<glm::float3> bitangents(vertexCount, glm::float3(0.0f));
+    auto accumulate = [&](const uint32_t* triangle, const FaceTangents& face) {
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            tangents[triangle[k]] += face.tangent * face.angles[k];
+            bitangents[triangle[k]] += face.bitangent * face.angles[k];
+        }
+    };
+    size_t t = 0;
+#if defined(NEVK_SSE)
+    for (; t + 4 <= triangleCount; t += 4)
+    {
+        // transpose 4 triangles into registers
+        __m128 px[3], py[3], pz[3], u[3], v[3];
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const Scene::Vertex* c[4];
+            const glm::float2* cuv[4];
+            for (uint32_t lane = 0; lane < 4; ++lane)
+            {
+                const uint32_t index = indices[(t + lane) * 3 + k];
+                c[lane] = &vertices[index];
+                cuv[lane] = &uvs[index];
+            }
+            px[k] = _mm_set_ps(c[3]->pos.x, c[2]->pos.x, c[1]->pos.x, c[0]->pos.x);
+            py[k] = _mm_set_ps(c[3]->pos.y, c[2]->pos.y, c[1]->pos.y, c[0]->pos.y);
+            pz[k] = _mm_set_ps(c[3]->pos.z, c[2]->pos.z, c[1]->pos.z, c[0]->pos.z);
+            u[k] = _mm_set_ps(cuv[3]->x, cuv[2]->x, cuv[1]->x, cuv[0]->x);
+            v[k] = _mm_set_ps(cuv[3]->y, cuv[2]->y, cuv[1]->y, cuv[0]->y);
+        }
+        auto dot3 = [](__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz) {
+            return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+        };
+        const __m128 e1x = _mm_sub_ps(px[1], px[0]), e1y = _mm_sub_ps(py[1], py[0]), e1z = _mm_sub_ps(pz[1], pz[0]);
+        const __m128 e2x = _mm_sub_ps(px[2], px[0]), e2y = _mm_sub_ps(py[2], py[0]), e2z = _mm_sub_ps(pz[2], pz[0]);
+        const __m128 e3x = _mm_sub_ps(px[2], px[1]), e3y = _mm_sub_ps(py[2], py[1]), e3z = _mm_sub_ps(pz[2], pz[1]);
+        const __m128 du1 = _mm_sub_ps(u[1], u[0]), dv1 = _mm_sub_ps(v[1], v[0]);
+        const __m128 du2 = _mm_sub_ps(u[2], u[0]), dv2 = _mm_sub_ps(v[2], v[0]);
+        const __m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(dv1, du2));
+        __m128 tx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1x, dv2), _mm_mul_ps(e2x, dv1)), det);
+        __m128 ty = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1y, dv2), _mm_mul_ps(e2y, dv1)), det);
+        __m128 tz = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1z, dv2), _mm_mul_ps(e2z, dv1)), det);
+        __m128 bx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1x, du2), _mm_mul_ps(e2x, du1)), det);
+        __m128 by = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1y, du2), _mm_mul_ps(e2y, du1)), det);
+        __m128 bz = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(e1z, du2), _mm_mul_ps(e2z, du1)), det);
+        const __m128 nx = _mm_sub_ps(_mm_mul_ps(e1y, e2z), _mm_mul_ps(e1z, e2y));
+        const __m128 ny = _mm_sub_ps(_mm_mul_ps(e1z, e2x), _mm_mul_ps(e1x, e2z));
+        const __m128 nz = _mm_sub_ps(_mm_mul_ps(e1x, e2y), _mm_mul_ps(e1y, e2x));
+        const __m128 tangentLength = _mm_sqrt_ps(dot3(tx, ty, tz, tx, ty, tz));
+        const __m128 bitangentLength = _mm_sqrt_ps(dot3(bx, by, bz, bx, by, bz));
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 valid = _mm_and_ps(_mm_and_ps(_mm_cmpneq_ps(tangentLength, zero), _mm_cmpneq_ps(bitangentLength, zero)),
+                                        _mm_cmpneq_ps(dot3(nx, ny, nz, nx, ny, nz), zero));
+        // invalid lanes divide by one and are zeroed by mask
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 invTangent = _mm_and_ps(valid, _mm_div_ps(one, _mm_or_ps(_mm_and_ps(valid, tangentLength), _mm_andnot_ps(valid, one))));
+        const __m128 invBitangent = _mm_and_ps(valid, _mm_div_ps(one, _mm_or_ps(_mm_and_ps(valid, bitangentLength), _mm_andnot_ps(valid, one))));
+        tx = _mm_mul_ps(tx, invTangent);
+        ty = _mm_mul_ps(ty, invTangent);
+        tz = _mm_mul_ps(tz, invTangent);
+        bx = _mm_mul_ps(bx, invBitangent);
+        by = _mm_mul_ps(by, invBitangent);
+        bz = _mm_mul_ps(bz, invBitangent);
+        const __m128 l1 = _mm_sqrt_ps(dot3(e1x, e1y, e1z, e1x, e1y, e1z));
+        const __m128 l2 = _mm_sqrt_ps(dot3(e2x, e2y, e2z, e2x, e2y, e2z));
+        const __m128 l3 = _mm_sqrt_ps(dot3(e3x, e3y, e3z, e3x, e3y, e3z));
+        const __m128 l12 = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(l1, l2)), _mm_andnot_ps(valid, one));
+        const __m128 l13 = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(l1, l3)), _mm_andnot_ps(valid, one));
+        const __m128 l23 = _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(l2, l3)), _mm_andnot_ps(valid, one));
+        const __m128 a0 = acosApprox4(_mm_div_ps(dot3(e1x, e1y, e1z, e2x, e2y, e2z), l12));
+        const __m128 a1 = acosApprox4(_mm_div_ps(_mm_sub_ps(zero, dot3(e1x, e1y, e1z, e3x, e3y, e3z)), l13));
+        const __m128 a2 = acosApprox4(_mm_div_ps(dot3(e2x, e2y, e2z, e3x, e3y, e3z), l23));
+
+        alignas(16) float lanes[9][4];
+        const __m128 results[9] = { tx, ty, tz, bx, by, bz, _mm_and_ps(valid, a0), _mm_and_ps(valid, a1), _mm_and_ps(valid, a2) };
+        for (uint32_t r = 0; r < 9; ++r)
+        {
+            _mm_store_ps(lanes[r], results[r]);
+        }
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            FaceTangents face;
+            face.tangent = glm::float3(lanes[0][lane], lanes[1][lane], lanes[2][lane]);
+            face.bitangent = glm::float3(lanes[3][lane], lanes[4][lane], lanes[5][lane]);
+            face.angles[0] = lanes[6][lane];
+            face.angles[1] = lanes[7][lane];
+            face.angles[2] = lanes[8][lane];
+            accumulate(&indices[(t + lane) * 3], face);
+        }
+    }
+#endif
+    for (; t < triangleCount; ++t)
+    {
+        const uint32_t* triangle = &indices[t * 3];
+        const glm::float3 p[3] = { vertices[triangle[0]].pos, vertices[triangle[1]].pos, vertices[triangle[2]].pos };
+        const glm::float2 uv[3] = { uvs[triangle[0]], uvs[triangle[1]], uvs[triangle[2]] };
+        accumulate(triangle, computeFaceTangents(p, uv));
+    }
+
+    // orthogonalize to vertex normal, handedness tells whether bitangent is cross(normal, tangent) or opposite
+    std::vector<glm::float3> normals(vertexCount);
+    unpackNormals(vertices.data(), vertexCount, normals.data());
+    std::vector<glm::float4> result(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        const glm::float3 normal = normals[v];
+        const bool hasNormal = vertices[v].normal != 0;
+        glm::float3 tangent = tangents[v];
+        if (hasNormal)
+        {
+            tangent -= normal * glm::dot(normal, tangent);
+        }
+        const float length = glm::length(tangent);
+        if (length > 1e-6f)
+        {
+            tangent /= length;
+        }
+        else if (hasNormal)
+        {
+            // no UV gradient, any direction in tangent plane keeps TBN orthonormal
+            const glm::float3 axis = std::fabs(normal.x) < 0.9f ? glm::float3(1.0f, 0.0f, 0.0f) : glm::float3(0.0f, 1.0f, 0.0f);
+            tangent = glm::normalize(glm::cross(axis, normal));
+        }
+        else
+        {
+            tangent = glm::float3(1.0f, 0.0f, 0.0f);
+        }
+        const float handedness = hasNormal && glm::dot(glm::cross(normal, tangent), bitangents[v]) < 0.0f ? -1.0f : 1.0f;
+        result[v] = glm::float4(tangent, handedness);
+    }
+    packTangents(result.data(), vertexCount, vertices.data());
+}
 
-    glm::float3 deltaPos1 = v1.pos - v0.pos;
-    glm::float3 deltaPos2 = v2.pos - v0.pos;
-    glm::vec2 deltaUV1 = uv1 - uv0;
-    glm::vec2 deltaUV2 = uv2 - uv0;
+// Geometry of one OBJ shape, built on worker thread
+struct ObjShape
+{
+    std::vector<Scene::Vertex> vertices;
+    std::vector<uint32_t> indices;
+    glm::float3 massCenter;
+    size_t cornerCount = 0; // vertices before welding
+    VertexCacheStats cacheBefore;
+    VertexCacheStats cacheAfter;
+    std::vector<Meshlet> meshlets;
+    std::vector<Scene::LodGeometry> lods;
+};
+
+// Triangle order for vertex cache and optionally overdraw seeds meshlets, which reorder triangles into
+// contiguous ranges, so cache order is restored inside every meshlet. Then vertex order for fetch.
+// Stats are taken from final order, the one which is uploaded
+static void optimizeMesh(std::vector<Scene::Vertex>& vertices, std::vector<uint32_t>& indices, const bool overdraw, VertexCacheStats& before, VertexCacheStats& after, std::vector<Meshlet>& meshlets)
+{
+    before = analyzeVertexCache(indices, vertices.size());
+    optimizeVertexCache(indices, vertices.size());
+    if (overdraw)
+    {
+        optimizeOverdraw(vertices, indices);
+    }
+    buildMeshlets(vertices, indices, meshlets);
+    optimizeMeshletVertexCache(indices, vertices.size(), meshlets);
+    optimizeVertexFetch(vertices, indices);
+    after = analyzeVertexCache(indices, vertices.size());
+}
 
-    glm::vec3 tangent{ 0.0f, 0.0f, 1.0f };
-    const float d = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
-    if (abs(d) > 1e-6)
+// Simplified levels share mesh vertices, their triangles are ordered for vertex cache too
+static void buildLods(const std::vector<Scene::Vertex>& vertices, const std::vector<uint32_t>& indices, const bool optimizeCache, std::vector<Scene::LodGeometry>& lods)
+{
+    lods = buildLodChain(vertices, indices);
+    if (optimizeCache)
     {
-        float r = 1.0f / d;
-        tangent = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * r;
+        for (Scene::LodGeometry& lod : lods)
+        {
+            optimizeVertexCache(lod.indices, vertices.size());
+        }
     }
+}
 
-    glm::uint32_t packedTangent = packTangent(tangent);
+// Duplicate geometry resolves to existing mesh, which keeps its meshlets and levels
+static void attachMeshData(nevk::Scene& scene, const uint32_t meshId, const std::vector<Meshlet>& meshlets, const std::vector<Scene::LodGeometry>& lods)
+{
+    const Mesh& mesh = scene.getMeshes()[Scene::handleIndex(meshId)];
+    if (mesh.mMeshletCount == 0 && mesh.mLodCount == 0)
+    {
+        bool attached = scene.setMeshlets(meshId, meshlets);
+        attached &= scene.setMeshLods(meshId, lods);
+        assert(attached);
+        (void)attached;
+    }
+}
 
-    v0.tangent = packedTangent;
-    v1.tangent = packedTangent;
-    v2.tangent = packedTangent;
+static void printVertexCacheStats(const VertexCacheStats& before, const VertexCacheStats& after)
+{
+    if (before.triangles > 0)
+    {
+        std::cout << "Vertex cache: ACMR " << before.acmr() << " -> " << after.acmr()
+                  << ", ATVR " << before.atvr() << " -> " << after.atvr() << std::endl;
+    }
 }
 
-bool ModelLoader::loadModel(const std::string& modelFile, const std::string& mtlPath, nevk::Scene& scene)
+// Runs func(i) for i in [0; count), on pool if scene has one
+static void forEachParallel(nevk::Scene& scene, const uint32_t count, const std::function<void(uint32_t)>& func)
+{
+    auto range = [&func](const uint32_t begin, const uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            func(i);
+        }
+    };
+    ThreadPool* pool = scene.getThreadPool();
+    if (pool)
+    {
+        pool->parallelFor(count, 1, range);
+    }
+    else
+    {
+        range(0, count);
+    }
+}
+
+bool ModelLoader::loadModel(const std::string& modelFile, const std::string& mtlPath, nevk::Scene& scene, std::vector<ImportedImage>* images)
 {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
@@ -103,10 +921,13 @@ bool ModelLoader::loadModel(const std::string& modelFile, const std::string& mtl
 
     const bool hasMaterial = !mtlPath.empty() && !materials.empty();
 
+    // materials first, serially and in shape order: ids are the same as with interleaved creation
     std::unordered_map<std::string, uint32_t> uniqueMaterial{};
-    for (tinyobj::shape_t& shape : shapes)
+    ImageDecoder decoder;
+    std::vector<uint32_t> shapeMaterialIds(shapes.size(), 0); // TODO: make default material
+    for (size_t s = 0; s < shapes.size(); ++s)
     {
-        uint32_t shapeMaterialId = 0; // TODO: make default material
+        const tinyobj::shape_t& shape = shapes[s];
         if (hasMaterial)
         {
             Scene::Material material{};
@@ -143,10 +964,10 @@ bool ModelLoader::loadModel(const std::string& modelFile, const std::string& mtl
 
                 material.illum = currMaterial.illum;
 
-                material.texAmbientId = mTexManager->loadTexture(currMaterial.ambient_texname, mtlPath);
-                material.texDiffuseId = mTexManager->loadTexture(currMaterial.diffuse_texname, mtlPath);
-                material.texSpecularId = mTexManager->loadTexture(currMaterial.specular_texname, mtlPath);
-                material.texNormalId = mTexManager->loadTexture(currMaterial.bump_texname, mtlPath);
+                material.texAmbientId = loadObjTexture(scene, currMaterial.ambient_texname, mtlPath, images ? &decoder : nullptr);
+                material.texDiffuseId = loadObjTexture(scene, currMaterial.diffuse_texname, mtlPath, images ? &decoder : nullptr);
+                material.texSpecularId = loadObjTexture(scene, currMaterial.specular_texname, mtlPath, images ? &decoder : nullptr);
+                material.texNormalId = loadObjTexture(scene, currMaterial.bump_texname, mtlPath, images ? &decoder : nullptr);
                 material.d = currMaterial.dissolve;
 
                 uint32_t matId = scene.createMaterial(material.ambient, material.diffuse,
@@ -158,17 +979,26 @@ bool ModelLoader::loadModel(const std::string& modelFile, const std::string& mtl
                                                       material.d);
 
                 uniqueMaterial[matName] = matId;
-                shapeMaterialId = matId;
+                shapeMaterialIds[s] = matId;
             }
             else
             {
                 // reuse existing material
-                shapeMaterialId = uniqueMaterial[matName];
+                shapeMaterialIds[s] = uniqueMaterial[matName];
             }
         }
+    }
 
-        std::vector<Scene::Vertex> _vertices;
-        std::vector<uint32_t> _indices;
+    // textures are decoded in background while geometry is processed
+    decoder.start(scene.getThreadPool());
+
+    // geometry of shapes is independent, it is unpacked, packed and welded in parallel
+    std::vector<ObjShape> results(shapes.size());
+    forEachParallel(scene, (uint32_t)shapes.size(), [&](const uint32_t s) {
+        tinyobj::shape_t& shape = shapes[s];
+        std::vector<Scene::Vertex>& _vertices = results[s].vertices;
+        std::vector<uint32_t>& _indices = results[s].indices;
+        std::vector<glm::float3> normals; // packed in one batch, so vertices without normals keep 0
         size_t index_offset = 0;
         for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); f++)
         {
@@ -206,56 +1036,170 @@ bool ModelLoader::loadModel(const std::string& modelFile, const std::string& mtl
                     }
                 }
 
-                if (attrib.normals.empty())
-                {
-                    vertex.normal = packNormal(glm::float3(0.0f, 0.0f, 0.0f));
-                }
-                else
+                if (!attrib.normals.empty())
                 {
-                    vertex.normal = packNormal(glm::float3(attrib.normals[3 * idx.normal_index + 0],
-                                                           attrib.normals[3 * idx.normal_index + 1],
-                                                           attrib.normals[3 * idx.normal_index + 2]));
+                    normals.push_back(glm::float3(attrib.normals[3 * idx.normal_index + 0],
+                                                  attrib.normals[3 * idx.normal_index + 1],
+                                                  attrib.normals[3 * idx.normal_index + 2]));
                 }
 
                 _indices.push_back(static_cast<uint32_t>(_vertices.size()));
                 _vertices.push_back(vertex);
             }
             index_offset += verticesPerFace;
-
-            computeTangent(_vertices, _indices);
         }
+        packNormals(normals.data(), normals.size(), _vertices.data());
 
         glm::float3 sum = glm::float3(0.0f, 0.0f, 0.0f);
         for (const Scene::Vertex& vertPos : _vertices)
         {
             sum += vertPos.pos;
         }
-        glm::float3 massCenter = glm::float3(sum.x / _vertices.size(),
-                                             sum.y / _vertices.size(),
-                                             sum.z / _vertices.size());
-
+        results[s].massCenter = glm::float3(sum.x / _vertices.size(),
+                                            sum.y / _vertices.size(),
+                                            sum.z / _vertices.size());
+
+        // every face corner was emitted as own vertex, merge identical ones
+        results[s].cornerCount = _vertices.size();
+        weldVertices(_vertices, _indices);
+        // after welding, so shared vertices get one smooth tangent
+        computeTangents(_vertices, _indices);
+        if (mOptimizeVertexCache)
+        {
+            optimizeMesh(_vertices, _indices, mOptimizeOverdraw, results[s].cacheBefore, results[s].cacheAfter, results[s].meshlets);
+        }
+        else
+        {
+            buildMeshlets(_vertices, _indices, results[s].meshlets);
+        }
+        buildLods(_vertices, _indices, mOptimizeVertexCache, results[s].lods);
+    });
+
+    // merge in shape order, so mesh and instance ids do not depend on thread timing
+    size_t cornerCount = 0;
+    size_t weldedCount = 0;
+    VertexCacheStats cacheBefore;
+    VertexCacheStats cacheAfter;
+    for (size_t s = 0; s < shapes.size(); ++s)
+    {
+        ObjShape& shape = results[s];
+        cornerCount += shape.cornerCount;
+        weldedCount += shape.vertices.size();
+        cacheBefore += shape.cacheBefore;
+        cacheAfter += shape.cacheAfter;
 
-        uint32_t meshId = scene.createMesh(_vertices, _indices);
+        uint32_t meshId = scene.getOrCreateMesh(std::move(shape.vertices), std::move(shape.indices));
         assert(meshId != -1);
+        attachMeshData(scene, meshId, shape.meshlets, shape.lods);
         glm::float4x4 transform{ 1.0f };
         glm::translate(transform, glm::float3(0.0f, 0.0f, 0.0f));
-        uint32_t instId = scene.createInstance(meshId, shapeMaterialId, transform, massCenter);
+        uint32_t instId = scene.createInstance(meshId, shapeMaterialIds[s], transform, shape.massCenter);
         assert(instId != -1);
     }
 
-    mTexManager->createTextureSampler();
+    if (cornerCount > 0)
+    {
+        std::cout << "Vertex welding: " << cornerCount << " -> " << weldedCount << " vertices ("
+                  << (float)cornerCount / weldedCount << "x reduction)" << std::endl;
+    }
+    printVertexCacheStats(cacheBefore, cacheAfter);
+
+    if (images)
+    {
+        decoder.wait();
+        for (size_t i = 0; i < decoder.getImages().size(); ++i)
+        {
+            images->push_back(decoder.takeImage(i, decoder.getImages()[i].path));
+        }
+    }
 
     return ret;
 }
 
-void processPrimitive(const tinygltf::Model& model, nevk::Scene& scene, const tinygltf::Primitive& primitive, const glm::float4x4& transform, const float globalScale)
+// Binary chunk of .glb container
+struct GlbBinChunk
+{
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+};
+
+// Validates .glb header (magic, version, JSON chunk) and finds optional BIN chunk
+static bool parseGlb(const uint8_t* bytes, const size_t size, GlbBinChunk& bin)
+{
+    struct ChunkHeader
+    {
+        uint32_t length;
+        uint32_t type;
+    };
+    const uint32_t kMagic = 0x46546C67; // "glTF"
+    const uint32_t kJsonChunk = 0x4E4F534A; // "JSON"
+    const uint32_t kBinChunk = 0x004E4942; // "BIN\0"
+    const size_t kHeaderSize = 3 * sizeof(uint32_t);
+
+    if (size < kHeaderSize + sizeof(ChunkHeader))
+    {
+        return false;
+    }
+    uint32_t header[3];
+    memcpy(header, bytes, sizeof(header));
+    if (header[0] != kMagic || header[1] != 2 || header[2] > size)
+    {
+        return false;
+    }
+    const size_t length = header[2];
+
+    ChunkHeader json;
+    memcpy(&json, bytes + kHeaderSize, sizeof(json));
+    const size_t binOffset = kHeaderSize + sizeof(ChunkHeader) + json.length;
+    if (json.type != kJsonChunk || binOffset > length)
+    {
+        return false;
+    }
+
+    ChunkHeader chunk;
+    if (binOffset + sizeof(chunk) <= length)
+    {
+        memcpy(&chunk, bytes + binOffset, sizeof(chunk));
+        if (chunk.type == kBinChunk && binOffset + sizeof(chunk) + chunk.length <= length)
+        {
+            bin.data = bytes + binOffset + sizeof(chunk);
+            bin.size = chunk.length;
+        }
+    }
+    return true;
+}
+
+// Start of every glTF buffer. Accessors of buffer stored in .glb are read from file mapping.
+// This is not zero-copy: LoadBinaryFromMemory still copies BIN chunk into buffer.data
+// (tinygltf has no way to skip it), so that copy is only released here after parsing
+static std::vector<const uint8_t*> resolveBuffers(tinygltf::Model& model, const GlbBinChunk& bin)
+{
+    std::vector<const uint8_t*> buffers(model.buffers.size(), nullptr);
+    for (size_t i = 0; i < model.buffers.size(); ++i)
+    {
+        tinygltf::Buffer& buffer = model.buffers[i];
+        // only first buffer may refer to BIN chunk, it has no uri
+        if (i == 0 && bin.data && buffer.uri.empty())
+        {
+            buffers[i] = bin.data;
+            std::vector<unsigned char>().swap(buffer.data);
+        }
+        else
+        {
+            buffers[i] = buffer.data.data();
+        }
+    }
+    return buffers;
+}
+
+// Unpacks and packs geometry of primitive, touches only its own entry so it can run on worker thread
+void decodePrimitive(const tinygltf::Model& model, const std::vector<const uint8_t*>& buffers, const tinygltf::Primitive& primitive, const float globalScale, PrimitiveCacheEntry& entry)
 {
-    using namespace std;
     assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
 
     const tinygltf::Accessor& positionAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
     const tinygltf::BufferView& positionView = model.bufferViews[positionAccessor.bufferView];
-    const float* positionData = reinterpret_cast<const float*>(&model.buffers[positionView.buffer].data[positionAccessor.byteOffset + positionView.byteOffset]);
+    const float* positionData = reinterpret_cast<const float*>(buffers[positionView.buffer] + positionAccessor.byteOffset + positionView.byteOffset);
     assert(positionData != nullptr);
     const uint32_t vertexCount = static_cast<uint32_t>(positionAccessor.count);
     assert(vertexCount != 0);
@@ -270,7 +1214,7 @@ void processPrimitive(const tinygltf::Model& model, nevk::Scene& scene, const ti
     {
         const tinygltf::Accessor& normalAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
         const tinygltf::BufferView& normView = model.bufferViews[normalAccessor.bufferView];
-        normalsData = reinterpret_cast<const float*>(&(model.buffers[normView.buffer].data[normalAccessor.byteOffset + normView.byteOffset]));
+        normalsData = reinterpret_cast<const float*>(buffers[normView.buffer] + normalAccessor.byteOffset + normView.byteOffset);
         assert(normalsData != nullptr);
         normalStride = normalAccessor.ByteStride(normView) / sizeof(float);
         assert(normalStride > 0);
@@ -283,43 +1227,77 @@ void processPrimitive(const tinygltf::Model& model, nevk::Scene& scene, const ti
     {
         const tinygltf::Accessor& uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
         const tinygltf::BufferView& uvView = model.bufferViews[uvAccessor.bufferView];
-        texCoord0Data = reinterpret_cast<const float*>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
+        texCoord0Data = reinterpret_cast<const float*>(buffers[uvView.buffer] + uvAccessor.byteOffset + uvView.byteOffset);
         texCoord0Stride = uvAccessor.ByteStride(uvView) / sizeof(float);
     }
 
-    int matId = primitive.material;
-    if (matId == -1)
+    // Tangents, xyz and bitangent sign in w
+    const float* tangentsData = nullptr;
+    int tangentStride = 0;
+    if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
     {
-        matId = 0; // TODO: should be index of default material
+        const tinygltf::Accessor& tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
+        const tinygltf::BufferView& tangentView = model.bufferViews[tangentAccessor.bufferView];
+        tangentsData = reinterpret_cast<const float*>(buffers[tangentView.buffer] + tangentAccessor.byteOffset + tangentView.byteOffset);
+        tangentStride = tangentAccessor.ByteStride(tangentView) / sizeof(float);
     }
 
     glm::float3 sum = glm::float3(0.0f, 0.0f, 0.0f);
-    std::vector<nevk::Scene::Vertex> vertices;
-    vertices.reserve(vertexCount);
+    std::vector<nevk::Scene::Vertex>& vertices = entry.vertices;
+    vertices.resize(vertexCount); // without NORMAL normals stay 0, which is packed zero vector
     for (uint32_t v = 0; v < vertexCount; ++v)
     {
-        nevk::Scene::Vertex vertex{};
+        nevk::Scene::Vertex& vertex = vertices[v];
         vertex.pos = glm::make_vec3(&positionData[v * posStride]) * globalScale;
-        vertex.normal = packNormal(glm::normalize(glm::vec3(normalsData ? glm::make_vec3(&normalsData[v * normalStride]) : glm::vec3(0.0f))));
         vertex.uv = packUV(texCoord0Data ? glm::make_vec2(&texCoord0Data[v * texCoord0Stride]) : glm::vec3(0.0f));
-        vertices.push_back(vertex);
         sum += vertex.pos;
     }
-    const glm::float3 massCenter = sum / (float)vertexCount;
+    entry.massCenter = sum / (float)vertexCount;
+
+    // normals and tangents are packed in batches, straight from buffer if attribute is not interleaved
+    if (normalsData)
+    {
+        std::vector<glm::float3> normals;
+        const glm::float3* src = reinterpret_cast<const glm::float3*>(normalsData);
+        if (normalStride != 3)
+        {
+            normals.resize(vertexCount);
+            for (uint32_t v = 0; v < vertexCount; ++v)
+            {
+                normals[v] = glm::make_vec3(&normalsData[v * normalStride]);
+            }
+            src = normals.data();
+        }
+        packNormals(src, vertexCount, vertices.data());
+    }
+    if (tangentsData)
+    {
+        std::vector<glm::float4> tangents;
+        const glm::float4* src = reinterpret_cast<const glm::float4*>(tangentsData);
+        if (tangentStride != 4)
+        {
+            tangents.resize(vertexCount);
+            for (uint32_t v = 0; v < vertexCount; ++v)
+            {
+                tangents[v] = glm::make_vec4(&tangentsData[v * tangentStride]);
+            }
+            src = tangents.data();
+        }
+        packTangents(src, vertexCount, vertices.data());
+    }
 
     uint32_t indexCount = 0;
-    std::vector<uint32_t> indices;
+    std::vector<uint32_t>& indices = entry.indices;
     const bool hasIndices = (primitive.indices != -1);
     assert(hasIndices); // currently support only this mode
     if (hasIndices)
     {
         const tinygltf::Accessor& accessor = model.accessors[primitive.indices > -1 ? primitive.indices : 0];
         const tinygltf::BufferView& bufferView = model.bufferViews[accessor.bufferView];
-        const tinygltf::Buffer& buffer = model.buffers[bufferView.buffer];
 
         indexCount = static_cast<uint32_t>(accessor.count);
         assert(indexCount != 0 && (indexCount % 3 == 0));
-        const void* dataPtr = &(buffer.data[accessor.byteOffset + bufferView.byteOffset]);
+        const void* dataPtr = buffers[bufferView.buffer] + accessor.byteOffset + bufferView.byteOffset;
 
         indices.reserve(indexCount);
 
@@ -351,24 +1329,61 @@ void processPrimitive(const tinygltf::Model& model, nevk::Scene& scene, const ti
         }
         default:
             std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
+            vertices.clear();
+            indices.clear();
             return;
         }
     }
+    if (!tangentsData)
+    {
+        ModelLoader::computeTangents(vertices, indices);
+    }
+    entry.valid = true;
+}
 
-    uint32_t meshId = scene.createMesh(vertices, indices);
-    assert(meshId != -1);
-    uint32_t instId = scene.createInstance(meshId, matId, transform, massCenter);
+void processPrimitive(nevk::Scene& scene, const tinygltf::Primitive& primitive, const uint64_t primitiveKey, PrimitiveCache& cache, const uint32_t nodeId, const glm::float4x4& transform)
+{
+    int matId = primitive.material;
+    if (matId == -1)
+    {
+        matId = 0; // TODO: should be index of default material
+    }
+
+    const auto cached = cache.find(primitiveKey);
+    if (cached == cache.end() || !cached->second.valid)
+    {
+        return;
+    }
+    PrimitiveCacheEntry& entry = cached->second;
+    if (entry.meshId == Scene::kInvalidId)
+    {
+        // first use, different glTF meshes may still hold identical geometry
+        entry.meshId = scene.getOrCreateMesh(std::move(entry.vertices), std::move(entry.indices));
+        assert(entry.meshId != -1);
+        attachMeshData(scene, entry.meshId, entry.meshlets, entry.lods);
+        std::vector<Meshlet>().swap(entry.meshlets);
+        std::vector<Scene::LodGeometry>().swap(entry.lods);
+        // geometry is left in place when duplicate mesh was found
+        std::vector<nevk::Scene::Vertex>().swap(entry.vertices);
+        std::vector<uint32_t>().swap(entry.indices);
+    }
+
+    const glm::float3 massCenter = glm::float3(transform * glm::float4(entry.massCenter, 1.0f));
+    uint32_t instId = scene.createInstance(entry.meshId, matId, transform, massCenter);
     assert(instId != -1);
+    scene.attachInstance(nodeId, instId);
 }
 
-void processMesh(const tinygltf::Model& model, nevk::Scene& scene, const tinygltf::Mesh& mesh, const glm::float4x4& transform, const float globalScale)
+void processMesh(const tinygltf::Model& model, nevk::Scene& scene, const int meshIndex, PrimitiveCache& cache, const uint32_t nodeId, const glm::float4x4& transform)
 {
     using namespace std;
+    const tinygltf::Mesh& mesh = model.meshes[meshIndex];
     cout << "Mesh name: " << mesh.name << endl;
     cout << "Primitive count: " << mesh.primitives.size() << endl;
     for (size_t i = 0; i < mesh.primitives.size(); ++i)
     {
-        processPrimitive(model, scene, mesh.primitives[i], transform, globalScale);
+        const uint64_t primitiveKey = ((uint64_t)meshIndex << 32) | i;
+        processPrimitive(scene, mesh.primitives[i], primitiveKey, cache, nodeId, transform);
     }
 }
 
@@ -418,18 +1433,18 @@ glm::float4x4 getTransform(const tinygltf::Node& node, const float globalScale)
     }
 }
 
-void processNode(const tinygltf::Model& model, nevk::Scene& scene, const tinygltf::Node& node, const glm::float4x4& baseTransform, const float globalScale)
+void processNode(const tinygltf::Model& model, nevk::Scene& scene, const tinygltf::Node& node, PrimitiveCache& cache, const uint32_t parentNodeId, const float globalScale)
 {
     using namespace std;
     cout << "Node name: " << node.name << endl;
 
     const glm::float4x4 localTransform = getTransform(node, globalScale);
-    const glm::float4x4 globalTransform = baseTransform * localTransform;
+    const uint32_t nodeId = scene.createNode(parentNodeId, localTransform);
+    const glm::float4x4 globalTransform = scene.getHierarchy().getWorldTransform(nodeId);
 
     if (node.mesh != -1) // mesh exist
     {
-        const tinygltf::Mesh& mesh = model.meshes[node.mesh];
-        processMesh(model, scene, mesh, globalTransform, globalScale);
+        processMesh(model, scene, node.mesh, cache, nodeId, globalTransform);
     }
     else if (node.camera != -1) // camera node
     {
@@ -446,43 +1461,57 @@ void processNode(const tinygltf::Model& model, nevk::Scene& scene, const tinyglt
 
     for (int i = 0; i < node.children.size(); ++i)
     {
-        processNode(model, scene, model.nodes[node.children[i]], globalTransform, globalScale);
+        processNode(model, scene, model.nodes[node.children[i]], cache, nodeId, globalScale);
     }
 }
 
-void loadTextures(const tinygltf::Model& model, nevk::Scene& scene, nevk::TextureManager& textureManager)
+// tinygltf image loader which only keeps encoded bytes, they are decoded later on worker threads
+static bool deferImageDecode(tinygltf::Image*, const int imageIndex, std::string*, std::string*, int, int, const unsigned char* bytes, int size, void* userData)
 {
-    for (const tinygltf::Texture& tex : model.textures)
+    if (!userData)
     {
-        const tinygltf::Image& image = model.images[tex.source];
-        // TODO: create sampler for tex
+        // images are not needed, only their paths
+        return true;
+    }
+    std::vector<ImageDecoder::Image>& images = static_cast<ImageDecoder*>(userData)->getImages();
+    if (images.size() <= (size_t)imageIndex)
+    {
+        images.resize(imageIndex + 1);
+    }
+    images[imageIndex].encoded.assign(bytes, bytes + size);
+    return true;
+}
 
-        if (image.component == 3)
-        {
-            // unsupported
-            return;
-        }
-        else if (image.component == 4)
-        {
-            // supported
-        }
-        else
+// Texture ids are glTF image indices, so textures sharing image share id.
+// Paths of file images are kept in scene for snapshots, decoded images are collected when requested
+void loadImages(const tinygltf::Model& model, nevk::Scene& scene, const std::string& modelPath, ImageDecoder& decoder, std::vector<ImportedImage>* images)
+{
+    if (images)
+    {
+        decoder.wait();
+    }
+    for (size_t i = 0; i < model.images.size(); ++i)
+    {
+        const tinygltf::Image& image = model.images[i];
+        // images inside buffers or data URIs have no file to reference
+        const bool isFile = !image.uri.empty() && image.uri.rfind("data:", 0) != 0;
+        const std::string path = isFile ? (std::filesystem::path(modelPath).parent_path() / image.uri).generic_string() : std::string();
+        scene.mTexturePaths.push_back(path);
+        if (images)
         {
-            // error
+            images->push_back(decoder.takeImage(i, isFile ? path : modelPath + "#" + std::to_string(i)));
         }
-
-        const void* data = image.image.data();
-        uint32_t width = image.width;
-        uint32_t height = image.height;
-
-        const std::string name = image.uri;
-
-        int texId = textureManager.loadTextureGltf(data, width, height, name);
-        assert(texId != -1);
     }
 }
 
-void loadMaterials(const tinygltf::Model& model, nevk::Scene& scene, nevk::TextureManager& textureManager)
+// Image of glTF texture, -1 for missing texture or texture without supported image
+static int textureImage(const tinygltf::Model& model, const int textureIndex)
+{
+    // TODO: create sampler for tex
+    return textureIndex < 0 ? -1 : model.textures[textureIndex].source;
+}
+
+void loadMaterials(const tinygltf::Model& model, nevk::Scene& scene)
 {
     for (const tinygltf::Material& material : model.materials)
     {
@@ -492,21 +1521,21 @@ void loadMaterials(const tinygltf::Model& model, nevk::Scene& scene, nevk::Textu
                                            material.pbrMetallicRoughness.baseColorFactor[1],
                                            material.pbrMetallicRoughness.baseColorFactor[2],
                                            material.pbrMetallicRoughness.baseColorFactor[3]);
-        currMaterial.texNormalId = material.normalTexture.index;
+        currMaterial.texNormalId = textureImage(model, material.normalTexture.index);
 
         currMaterial.baseColorFactor = glm::float4(material.pbrMetallicRoughness.baseColorFactor[0],
                                                    material.pbrMetallicRoughness.baseColorFactor[1],
                                                    material.pbrMetallicRoughness.baseColorFactor[2],
                                                    material.pbrMetallicRoughness.baseColorFactor[3]);
-        currMaterial.texBaseColor = material.pbrMetallicRoughness.baseColorTexture.index;
+        currMaterial.texBaseColor = textureImage(model, material.pbrMetallicRoughness.baseColorTexture.index);
         currMaterial.roughnessFactor = (float)material.pbrMetallicRoughness.roughnessFactor;
         currMaterial.metallicFactor = (float)material.pbrMetallicRoughness.metallicFactor;
 
         currMaterial.emissiveFactor = glm::float3(material.emissiveFactor[0],
                                                   material.emissiveFactor[1],
                                                   material.emissiveFactor[2]);
-        currMaterial.texEmissive = material.emissiveTexture.index;
-        currMaterial.texOcclusion = material.occlusionTexture.index;
+        currMaterial.texEmissive = textureImage(model, material.emissiveTexture.index);
+        currMaterial.texOcclusion = textureImage(model, material.occlusionTexture.index);
         currMaterial.d = (float)material.pbrMetallicRoughness.baseColorFactor[3];
 
         currMaterial.illum = material.alphaMode == "OPAQUE" ? 2 : 1;
@@ -542,7 +1571,7 @@ void loadCameras(const tinygltf::Model& model, nevk::Scene& scene)
     }
 }
 
-bool ModelLoader::loadModelGltf(const std::string& modelPath, nevk::Scene& scene)
+bool ModelLoader::loadModelGltf(const std::string& modelPath, nevk::Scene& scene, std::vector<ImportedImage>* images)
 {
     if (modelPath.empty())
     {
@@ -552,14 +1581,30 @@ bool ModelLoader::loadModelGltf(const std::string& modelPath, nevk::Scene& scene
     using namespace std;
     tinygltf::Model model;
     tinygltf::TinyGLTF gltf_ctx;
+    ImageDecoder decoder;
+    gltf_ctx.SetImageLoader(deferImageDecode, images ? &decoder : nullptr);
     std::string err;
     std::string warn;
-    bool res = gltf_ctx.LoadASCIIFromFile(&model, &err, &warn, modelPath.c_str());
+    bool res = false;
+    MappedFile file;
+    GlbBinChunk bin;
+    if (std::filesystem::path(modelPath).extension() == ".glb")
+    {
+        // file is mapped instead of read into temporary buffer, tinygltf still copies BIN chunk once
+        res = file.open(modelPath) && parseGlb(file.data(), file.size(), bin) &&
+              gltf_ctx.LoadBinaryFromMemory(&model, &err, &warn, file.data(), (unsigned int)file.size(),
+                                            std::filesystem::path(modelPath).parent_path().string());
+    }
+    else
+    {
+        res = gltf_ctx.LoadASCIIFromFile(&model, &err, &warn, modelPath.c_str());
+    }
     if (!res)
     {
         cerr << "Unable to load file: " << modelPath << endl;
         return res;
     }
+    const std::vector<const uint8_t*> buffers = resolveBuffers(model, bin);
     for (int i = 0; i < model.scenes.size(); ++i)
     {
         cout << "Scene: " << model.scenes[i].name << endl;
@@ -567,18 +1612,98 @@ bool ModelLoader::loadModelGltf(const std::string& modelPath, nevk::Scene& scene
 
     int sceneId = model.defaultScene;
 
-    loadTextures(model, scene, *mTexManager);
-    loadMaterials(model, scene, *mTexManager);
+    // textures are decoded in background while geometry is processed
+    if (images)
+    {
+        decoder.getImages().resize(model.images.size());
+        decoder.start(scene.getThreadPool());
+    }
+    loadMaterials(model, scene);
 
     loadCameras(model, scene);
 
     const float globalScale = 1.0f;
 
+    // upper bound of geometry size, so scene storage grows once
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    for (const tinygltf::Mesh& mesh : model.meshes)
+    {
+        for (const tinygltf::Primitive& primitive : mesh.primitives)
+        {
+            const auto position = primitive.attributes.find("POSITION");
+            if (position != primitive.attributes.end())
+            {
+                vertexCount += model.accessors[position->second].count;
+            }
+            if (primitive.indices != -1)
+            {
+                indexCount += model.accessors[primitive.indices].count;
+            }
+        }
+    }
+    scene.reserveGeometry(vertexCount, indexCount);
+
+    // decode every primitive of meshes used by nodes in parallel, in (mesh, primitive) order
+    std::vector<uint8_t> meshUsed(model.meshes.size(), 0);
+    for (const tinygltf::Node& node : model.nodes)
+    {
+        if (node.mesh != -1)
+        {
+            meshUsed[node.mesh] = 1;
+        }
+    }
+    std::vector<uint64_t> primitiveKeys;
+    for (size_t m = 0; m < model.meshes.size(); ++m)
+    {
+        for (size_t p = 0; meshUsed[m] && p < model.meshes[m].primitives.size(); ++p)
+        {
+            primitiveKeys.push_back(((uint64_t)m << 32) | p);
+        }
+    }
+    std::vector<PrimitiveCacheEntry> decoded(primitiveKeys.size());
+    forEachParallel(scene, (uint32_t)primitiveKeys.size(), [&](const uint32_t i) {
+        const tinygltf::Mesh& mesh = model.meshes[primitiveKeys[i] >> 32];
+        decodePrimitive(model, buffers, mesh.primitives[primitiveKeys[i] & 0xFFFFFFFF], globalScale, decoded[i]);
+        if (mOptimizeVertexCache && decoded[i].valid)
+        {
+            optimizeMesh(decoded[i].vertices, decoded[i].indices, mOptimizeOverdraw, decoded[i].cacheBefore, decoded[i].cacheAfter, decoded[i].meshlets);
+        }
+        else if (decoded[i].valid)
+        {
+            buildMeshlets(decoded[i].vertices, decoded[i].indices, decoded[i].meshlets);
+        }
+        if (decoded[i].valid)
+        {
+            buildLods(decoded[i].vertices, decoded[i].indices, mOptimizeVertexCache, decoded[i].lods);
+        }
+    });
+    if (mOptimizeVertexCache)
+    {
+        VertexCacheStats cacheBefore;
+        VertexCacheStats cacheAfter;
+        for (const PrimitiveCacheEntry& entry : decoded)
+        {
+            cacheBefore += entry.cacheBefore;
+            cacheAfter += entry.cacheAfter;
+        }
+        printVertexCacheStats(cacheBefore, cacheAfter);
+    }
+
+    // serial traversal creates nodes, meshes and instances in the same order as single-threaded import
+    PrimitiveCache cache;
+    cache.reserve(primitiveKeys.size());
+    for (size_t i = 0; i < primitiveKeys.size(); ++i)
+    {
+        cache.emplace(primitiveKeys[i], std::move(decoded[i]));
+    }
     for (int i = 0; i < model.scenes[sceneId].nodes.size(); ++i)
     {
         const int rootNodeIdx = model.scenes[sceneId].nodes[i];
-        processNode(model, scene, model.nodes[rootNodeIdx], glm::float4x4(1.0f), globalScale);
+        processNode(model, scene, model.nodes[rootNodeIdx], cache, nevk::TransformHierarchy::kInvalidNode, globalScale);
     }
+
+    loadImages(model, scene, modelPath, decoder, images);
     return res;
 }
 } // namespace nevk
@@ -1,5 +1,7 @@
 #include "depthpass.h"
 
+#include "renderpass.h"
+
 #include <array>
 #include <stdexcept>
 #define GLM_FORCE_SILENT_WARNINGS
@@ -87,22 +89,20 @@ void DepthPass::createGraphicsPipeline(VkShaderModule& shadowShaderModule, uint3
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    VkVertexInputBindingDescription bindingDescription{};
-    VkVertexInputAttributeDescription attributeDescription{};
-
-    bindingDescription.binding = 0;
-    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-    bindingDescription.stride = sizeof(Scene::Vertex);
+    // separate tightly packed position stream, shader reads it itself with vertex pulling
+    const VertexLayoutDesc& layout = getVertexLayoutDesc(mVertexLayout);
+    VkVertexInputBindingDescription bindingDescription = RenderPass::getBindingDescription(layout);
+    bindingDescription.stride = layout.positionStride;
+    std::vector<VkVertexInputAttributeDescription> attributeDescriptions = RenderPass::getAttributeDescriptions(layout, 1);
+    attributeDescriptions[0].offset = 0;
 
-    attributeDescription.binding = 0;
-    attributeDescription.location = 0;
-    attributeDescription.format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescription.offset = offsetof(Scene::Vertex, pos);
-
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = 1;
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = &attributeDescription;
+    if (!mVertexPulling)
+    {
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    }
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -263,7 +263,18 @@ void DepthPass::createDescriptorSetLayout()
     instanceLayoutBinding.pImmutableSamplers = nullptr;
     instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, instanceLayoutBinding };
+    VkDescriptorSetLayoutBinding positionLayoutBinding{};
+    positionLayoutBinding.binding = 2;
+    positionLayoutBinding.descriptorCount = 1;
+    positionLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    positionLayoutBinding.pImmutableSamplers = nullptr;
+    positionLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings = { uboLayoutBinding, instanceLayoutBinding };
+    if (mVertexPulling)
+    {
+        bindings.push_back(positionLayoutBinding);
+    }
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -308,6 +319,11 @@ void DepthPass::updateDescriptorSets(uint32_t descSetIndex)
     instanceInfo.offset = 0;
     instanceInfo.range = VK_WHOLE_SIZE;
 
+    VkDescriptorBufferInfo positionInfo{};
+    positionInfo.buffer = mPositionBuffer;
+    positionInfo.offset = 0;
+    positionInfo.range = VK_WHOLE_SIZE;
+
     std::vector<VkWriteDescriptorSet> descriptorWrites{};
     {
         VkWriteDescriptorSet descriptorWrite{};
@@ -334,6 +350,19 @@ void DepthPass::updateDescriptorSets(uint32_t descSetIndex)
         descriptorWrites.push_back(descriptorWrite);
     }
 
+    if (mVertexPulling && mPositionBuffer != VK_NULL_HANDLE)
+    {
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = mDescriptorSets[descSetIndex];
+        descriptorWrite.dstBinding = 2;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &positionInfo;
+        descriptorWrites.push_back(descriptorWrite);
+    }
+
     vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
@@ -375,6 +404,13 @@ void DepthPass::setInstanceBuffer(VkBuffer instanceBuffer)
     imageviewcounter = 0;
 }
 
+void DepthPass::setPositionBuffer(VkBuffer positionBuffer)
+{
+    mPositionBuffer = positionBuffer;
+    needDesciptorSetUpdate = true;
+    imageviewcounter = 0;
+}
+
 void DepthPass::onDestroy()
 {
     for (size_t i = 0; i < uniformBuffers.size(); ++i)
@@ -389,7 +425,7 @@ void DepthPass::onDestroy()
     vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
 }
 
-void DepthPass::record(VkCommandBuffer& cmd, VkBuffer vertexBuffer, VkBuffer indexBuffer, nevk::Scene& scene, uint32_t width, uint32_t height, uint32_t imageIndex, uint32_t cameraIndex)
+void DepthPass::record(VkCommandBuffer& cmd, VkBuffer positionBuffer, VkBuffer indexBuffer, VkBuffer indexBuffer16, const std::vector<MeshDraw>& meshDraws, nevk::Scene& scene, uint32_t width, uint32_t height, uint32_t imageIndex, const Scene::VisibleInstances& visible, Camera& camera, uint32_t cameraHeight)
 {
     beginLabel(cmd, "Depth Pass", { 0.0f, 0.0f, 1.0f, 1.0f });
 
@@ -404,13 +440,9 @@ void DepthPass::record(VkCommandBuffer& cmd, VkBuffer vertexBuffer, VkBuffer ind
         needDesciptorSetUpdate = false;
     }
 
-    const std::vector<uint32_t>& opaqueIds = scene.getOpaqueInstancesToRender(scene.getCamera(cameraIndex).getPosition());
-    const std::vector<uint32_t>& transparentIds = scene.getTransparentInstancesToRender(scene.getCamera(cameraIndex).getPosition());
-
-    if (opaqueIds.empty() && transparentIds.empty())
-    {
-        return;
-    }
+    // shadow casters are culled against light frustum, not camera one
+    const std::vector<uint32_t>& opaqueIds = visible.opaque;
+    const std::vector<uint32_t>& transparentIds = visible.transparent;
 
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -441,29 +473,47 @@ void DepthPass::record(VkCommandBuffer& cmd, VkBuffer vertexBuffer, VkBuffer ind
     // Required to avoid shadow mapping artifacts
     vkCmdSetDepthBias(cmd, depthBiasConstant, 0.0f, depthBiasSlope);
 
-    VkBuffer vertexBuffers[] = { vertexBuffer };
+    VkBuffer vertexBuffers[] = { positionBuffer };
     VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(cmd, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(cmd, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    if (!mVertexPulling)
+    {
+        vkCmdBindVertexBuffers(cmd, 0, 1, vertexBuffers, offsets);
+    }
 
     vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &mDescriptorSets[imageIndex % MAX_FRAMES_IN_FLIGHT], 0, nullptr);
 
-    const std::vector<Instance>& instances = scene.getInstances();
-    const std::vector<Mesh>& meshes = scene.getMeshes();
+    const InstanceStorage& instances = scene.getInstances();
     const VkPipelineLayout layout = mPipelineLayout;
 
-    auto renderInstances = [&cmd, &instances, &meshes, layout](const std::vector<uint32_t>& ids) {
+    // shadows are seen from camera, so LOD follows camera distance with looser limit
+    const glm::float3 eye = camera.getPosition();
+    const float pixelScale = camera.getPixelScale((float)cameraHeight);
+
+    // meshes of both index types are mixed in draw order, buffer is rebound when type changes
+    VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+    auto renderInstances = [&cmd, &instances, &meshDraws, &scene, &eye, pixelScale, layout, indexBuffer, indexBuffer16, &boundIndexType](const std::vector<uint32_t>& ids) {
         for (const uint32_t currentInstanceId : ids)
         {
-            const uint32_t currentMeshId = instances[currentInstanceId].mMeshId;
-            const uint32_t indexOffset = meshes[currentMeshId].mIndex;
-            const uint32_t indexCount = meshes[currentMeshId].mCount;
+            const uint32_t currentMeshId = instances.getMeshId(currentInstanceId);
+            // meshes created after upload are not in index buffers
+            if (currentMeshId >= meshDraws.size())
+            {
+                continue;
+            }
+            const MeshDraw& draw = meshDraws[currentMeshId];
+            const uint32_t lod = scene.selectLod(currentInstanceId, eye, pixelScale, scene.shadowLodPixelError);
+            const VkIndexType indexType = draw.index16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+            if (indexType != boundIndexType)
+            {
+                vkCmdBindIndexBuffer(cmd, draw.index16 ? indexBuffer16 : indexBuffer, 0, indexType);
+                boundIndexType = indexType;
+            }
             InstancePushConstants constants = {};
             constants.instanceId = currentInstanceId;
 
             vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(InstancePushConstants), &constants);
 
-            vkCmdDrawIndexed(cmd, indexCount, 1, indexOffset, 0, 0);
+            vkCmdDrawIndexed(cmd, draw.indexCount[lod], 1, draw.firstIndex[lod], draw.vertexOffset, 0);
         }
     };
 
@@ -2,8 +2,12 @@
 
 #include "debugUtils.h"
 
+#include <scene/scenesnapshot.h>
+
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <iterator>
 
 namespace fs = std::filesystem;
 
@@ -44,7 +48,16 @@ void Render::initVulkan()
     createLogicalDevice();
     createSwapChain();
 
-    // load shaders
+    // load shaders, vertex layout is compiled in unless shaders pull and decode vertices themselves
+    const nevk::VertexLayoutDesc& vertexLayout = nevk::getVertexLayoutDesc(VERTEX_LAYOUT);
+    if (VERTEX_PULLING)
+    {
+        mShaderManager.addDefine("NEVK_VERTEX_PULLING");
+    }
+    else if (vertexLayout.shaderDefine)
+    {
+        mShaderManager.addDefine(vertexLayout.shaderDefine);
+    }
     const char* csShaderCode = nullptr;
     uint32_t csShaderCodeSize = 0;
     const char* shShaderCode = nullptr;
@@ -79,7 +92,7 @@ void Render::initVulkan()
     createDescriptorPool();
     createCommandPool();
 
-    mResManager = new nevk::ResourceManager(mDevice, mPhysicalDevice, mInstance, getCurrentFrameData().cmdPool, mGraphicsQueue);
+    mResManager = new nevk::ResourceManager(mDevice, mPhysicalDevice, mInstance, mUploadCommandPool, mGraphicsQueue);
     mTexManager = new nevk::TextureManager(mDevice, mPhysicalDevice, mResManager);
 
     createImageViews();
@@ -99,13 +112,7 @@ void Render::initVulkan()
     mTexManager->createShadowSampler();
     mTexManager->createTextureSampler();
 
-    modelLoader = new nevk::ModelLoader(mTexManager);
     createDefaultScene();
-    if (!MODEL_PATH.empty())
-    {
-        mTexManager->saveTexturesInDelQueue();
-        loadScene(MODEL_PATH);
-    }
 
     //init passes
     mPbrPass.setFrameBufferFormat(swapChainImageFormat);
@@ -114,6 +121,13 @@ void Render::initVulkan()
     mPass.setFrameBufferFormat(swapChainImageFormat);
     mPass.setDepthBufferFormat(findDepthFormat());
 
+    mPbrPass.setVertexLayout(VERTEX_LAYOUT);
+    mPass.setVertexLayout(VERTEX_LAYOUT);
+    mDepthPass.setVertexLayout(VERTEX_LAYOUT);
+    mPbrPass.setVertexPulling(VERTEX_PULLING);
+    mPass.setVertexPulling(VERTEX_PULLING);
+    mDepthPass.setVertexPulling(VERTEX_PULLING);
+
     mDepthPass.init(mDevice, enableValidationLayers, shShaderCode, shShaderCodeSize, mDescriptorPool, mResManager, SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT);
     mDepthPass.createFrameBuffers(shadowImageView, SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT);
 
@@ -137,6 +151,14 @@ void Render::initVulkan()
 
     mUi.init(init_info, swapChainImageFormat, mWindow, mFramesData[0].cmdPool, mFramesData[0].cmdBuffer, swapChainExtent.width, swapChainExtent.height);
     mUi.createFrameBuffers(mDevice, swapChainImageViews, swapChainExtent.width, swapChainExtent.height);
+
+    // after UI init, its font upload does not lock graphics queue
+    if (!MODEL_PATH.empty())
+    {
+        const std::string modelPath = MODEL_PATH;
+        MODEL_PATH.clear(); // set when scene is swapped in
+        loadScene(modelPath);
+    }
 }
 
 void Render::framebufferResizeCallback(GLFWwindow* window, int width, int height)
@@ -296,6 +318,7 @@ void Render::mainLoop()
         msPerFrame = fpsCounter(frameTime);
     }
 
+    std::lock_guard<std::mutex> lock(mResManager->getQueueMutex());
     vkDeviceWaitIdle(mDevice);
 }
 
@@ -328,6 +351,13 @@ void Render::cleanup()
 
     vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
 
+    waitSceneLoading();
+    for (RetiredScene& retired : mRetiredScenes)
+    {
+        releaseScene(retired);
+    }
+    mRetiredScenes.clear();
+
     mTexManager->textureDestroy();
     mTexManager->delTexturesFromQueue();
 
@@ -350,6 +380,7 @@ void Render::cleanup()
     }
 
     delete mResManager;
+    vkDestroyCommandPool(mDevice, mUploadCommandPool, nullptr);
 
     vkDestroyDevice(mDevice, nullptr);
 
@@ -390,7 +421,11 @@ void Render::recreateSwapChain()
         glfwWaitEvents();
     }
 
-    vkDeviceWaitIdle(mDevice);
+    {
+        // loader thread may be uploading
+        std::lock_guard<std::mutex> lock(mResManager->getQueueMutex());
+        vkDeviceWaitIdle(mDevice);
+    }
 
     cleanupSwapChain();
 
@@ -676,6 +711,13 @@ void Render::createCommandPool()
             throw std::runtime_error("failed to create graphics command pool!");
         }
     }
+
+    // single time commands of resource manager, used by loader thread too
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    if (vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mUploadCommandPool) != VK_SUCCESS)
+    {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
 }
 
 void Render::createDepthResources()
@@ -725,92 +767,346 @@ void Render::setCamera()
     camera.setRotation(glm::quat({ 1.0f, 0.0f, 0.0f, 0.0f }));
 }
 
-void Render::createVertexBuffer(nevk::Scene& scene)
+void Render::uploadBuffer(nevk::Buffer* dst, VkDeviceSize dstOffset, const void* src, VkDeviceSize size)
 {
-    std::vector<nevk::Scene::Vertex>& sceneVertices = scene.getVertices();
-    VkDeviceSize bufferSize = sizeof(nevk::Scene::Vertex) * sceneVertices.size();
-    if (bufferSize == 0)
-    {
-        return;
-    }
-    Buffer* stagingBuffer = mResManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    Buffer* stagingBuffer = mResManager->createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     void* stagingBufferMemory = mResManager->getMappedMemory(stagingBuffer);
-    memcpy(stagingBufferMemory, sceneVertices.data(), (size_t)bufferSize);
-    mCurrentSceneRenderData->mVertexBuffer = mResManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "VB");
-    mResManager->copyBuffer(mResManager->getVkBuffer(stagingBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mVertexBuffer), bufferSize);
+    memcpy(stagingBufferMemory, src, (size_t)size);
+    mResManager->copyBuffer(mResManager->getVkBuffer(stagingBuffer), mResManager->getVkBuffer(dst), size, dstOffset);
     mResManager->destroyBuffer(stagingBuffer);
 }
 
-void Render::createMaterialBuffer(nevk::Scene& scene)
+const void* Render::getLayoutVertices(const std::vector<nevk::Mesh>& meshes, const nevk::Scene::Vertex* vertices, size_t count, std::vector<nevk::CompactVertex>& storage)
 {
-    std::vector<nevk::Scene::Material>& sceneMaterials = scene.getMaterials();
+    if (VERTEX_LAYOUT == nevk::VertexLayout::eCompact)
+    {
+        storage = nevk::packCompactVertices(meshes, vertices, count);
+        return storage.data();
+    }
+    return vertices;
+}
 
-    VkDeviceSize bufferSize = sizeof(nevk::Scene::Material) * sceneMaterials.size();
-    if (bufferSize == 0)
+void Render::createVertexBuffers(size_t vertexCount, SceneRenderData& data)
+{
+    if (vertexCount == 0)
     {
         return;
     }
-    Buffer* stagingBuffer = mResManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    void* stagingBufferMemory = mResManager->getMappedMemory(stagingBuffer);
-    memcpy(stagingBufferMemory, sceneMaterials.data(), (size_t)bufferSize);
-    mCurrentSceneRenderData->mMaterialBuffer = mResManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Materials");
-    mResManager->copyBuffer(mResManager->getVkBuffer(stagingBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mMaterialBuffer), bufferSize);
-    mResManager->destroyBuffer(stagingBuffer);
+    const nevk::VertexLayoutDesc& layout = nevk::getVertexLayoutDesc(VERTEX_LAYOUT);
+    const VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | (VERTEX_PULLING ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+    data.mVertexBuffer = mResManager->createBuffer((VkDeviceSize)layout.stride * vertexCount, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "VB");
+    data.mPositionBuffer = mResManager->createBuffer((VkDeviceSize)layout.positionStride * vertexCount, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Positions");
+}
+
+void Render::createVertexBuffer(nevk::Scene& scene, SceneRenderData& data)
+{
+    createVertexBuffers(scene.getVertexCount(), data);
+    if (!data.mVertexBuffer)
+    {
+        return;
+    }
+    // for snapshot scene full layout vertices are read straight from file mapping
+    const nevk::VertexLayoutDesc& layout = nevk::getVertexLayoutDesc(VERTEX_LAYOUT);
+    std::vector<nevk::CompactVertex> compactVertices;
+    const void* vertices = getLayoutVertices(scene.getMeshes(), scene.getVertexData(), scene.getVertexCount(), compactVertices);
+    uploadBuffer(data.mVertexBuffer, 0, vertices, (VkDeviceSize)layout.stride * scene.getVertexCount());
+    std::vector<uint8_t> positions((size_t)layout.positionStride * scene.getVertexCount());
+    nevk::extractPositions(layout, vertices, scene.getVertexCount(), positions.data());
+    uploadBuffer(data.mPositionBuffer, 0, positions.data(), positions.size());
 }
 
-void Render::createIndexBuffer(nevk::Scene& scene)
+void Render::createMaterialBuffer(nevk::Scene& scene, SceneRenderData& data)
 {
-    std::vector<uint32_t>& sceneIndices = scene.getIndices();
-    mCurrentSceneRenderData->mIndicesCount = (uint32_t)sceneIndices.size();
-    VkDeviceSize bufferSize = sizeof(uint32_t) * sceneIndices.size();
+    std::vector<nevk::Scene::Material> materials = scene.getMaterials();
+
+    VkDeviceSize bufferSize = sizeof(nevk::Scene::Material) * materials.size();
     if (bufferSize == 0)
     {
         return;
     }
+    // scene keeps its own texture ids (they index Scene::mTexturePaths), shaders need ids of texture manager
+    if (!data.mTextureIds.empty())
+    {
+        auto remap = [&data](int32_t& texId) {
+            if (texId >= 0)
+            {
+                texId = texId < (int32_t)data.mTextureIds.size() ? data.mTextureIds[texId] : -1;
+            }
+        };
+        for (nevk::Scene::Material& material : materials)
+        {
+            remap(material.texDiffuseId);
+            remap(material.texAmbientId);
+            remap(material.texSpecularId);
+            remap(material.texNormalId);
+            remap(material.metallicRoughnessTexture);
+            remap(material.texBaseColor);
+            remap(material.texEmissive);
+            remap(material.texOcclusion);
+        }
+    }
+    data.mMaterialBuffer = mResManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Materials");
+    uploadBuffer(data.mMaterialBuffer, 0, materials.data(), bufferSize);
+}
 
-    Buffer* stagingBuffer = mResManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    void* stagingBufferMemory = mResManager->getMappedMemory(stagingBuffer);
-    memcpy(stagingBufferMemory, sceneIndices.data(), (size_t)bufferSize);
-    mCurrentSceneRenderData->mIndexBuffer = mResManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "IB");
-    mResManager->copyBuffer(mResManager->getVkBuffer(stagingBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mIndexBuffer), bufferSize);
-    mResManager->destroyBuffer(stagingBuffer);
+void Render::createIndexBuffers(const nevk::GpuIndices& indices, SceneRenderData& data)
+{
+    data.mIndicesCount = (uint32_t)(indices.indices16.size() + indices.indices32.size());
+    data.mMeshDraws = indices.draws;
+    if (!indices.indices32.empty())
+    {
+        data.mIndexBuffer = mResManager->createBuffer(sizeof(uint32_t) * indices.indices32.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "IB");
+    }
+    if (!indices.indices16.empty())
+    {
+        data.mIndexBuffer16 = mResManager->createBuffer(sizeof(uint16_t) * indices.indices16.size(), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "IB16");
+    }
 }
 
-void Render::createInstanceBuffer(nevk::Scene& scene)
+void Render::createIndexBuffer(nevk::Scene& scene, SceneRenderData& data)
 {
-    // This struct should match shader's version
-    struct InstanceConstants
+    const nevk::GpuIndices indices = nevk::buildGpuIndices(scene.getMeshes(), scene.getIndexData(), scene.getIndexCount());
+    createIndexBuffers(indices, data);
+    if (data.mIndexBuffer)
     {
-        glm::float4x4 model;
-        glm::float4x4 normalMatrix;
-        int32_t materialId;
-        int32_t pad0;
-        int32_t pad1;
-        int32_t pad2;
-    };
+        uploadBuffer(data.mIndexBuffer, 0, indices.indices32.data(), sizeof(uint32_t) * indices.indices32.size());
+    }
+    if (data.mIndexBuffer16)
+    {
+        uploadBuffer(data.mIndexBuffer16, 0, indices.indices16.data(), sizeof(uint16_t) * indices.indices16.size());
+    }
+}
 
-    const std::vector<nevk::Instance>& sceneInstances = scene.getInstances();
-    mCurrentSceneRenderData->mInstanceCount = (uint32_t)sceneInstances.size();
-    VkDeviceSize bufferSize = sizeof(InstanceConstants) * sceneInstances.size();
+void Render::createMeshletBuffer(nevk::Scene& scene, SceneRenderData& data)
+{
+    const std::vector<nevk::Meshlet>& sceneMeshlets = scene.getMeshlets();
+    VkDeviceSize bufferSize = sizeof(nevk::Meshlet) * sceneMeshlets.size();
     if (bufferSize == 0)
     {
         return;
     }
+    data.mMeshletBuffer = mResManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Meshlets");
+    uploadBuffer(data.mMeshletBuffer, 0, sceneMeshlets.data(), bufferSize);
+}
+
+void Render::createInstanceBuffer(nevk::Scene& scene, SceneRenderData& data, const uint32_t capacity)
+{
+    const nevk::InstanceStorage& sceneInstances = scene.getInstances();
+    data.mInstanceCount = std::max((uint32_t)sceneInstances.size(), capacity);
+    VkDeviceSize bufferSize = sizeof(InstanceConstants) * sceneInstances.size();
+    if (data.mInstanceCount == 0)
+    {
+        return;
+    }
     std::vector<InstanceConstants> instanceConsts;
     instanceConsts.resize(sceneInstances.size());
-    for (int i = 0; i < sceneInstances.size(); ++i)
+    for (uint32_t i = 0; i < (uint32_t)sceneInstances.size(); ++i)
     {
-        instanceConsts[i].materialId = sceneInstances[i].mMaterialId;
-        instanceConsts[i].model = sceneInstances[i].transform;
-        instanceConsts[i].normalMatrix = glm::inverse(glm::transpose(sceneInstances[i].transform));
+        fillInstanceConstants(scene, i, instanceConsts[i]);
     }
 
-    Buffer* stagingBuffer = mResManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    void* stagingBufferMemory = mResManager->getMappedMemory(stagingBuffer);
-    memcpy(stagingBufferMemory, instanceConsts.data(), (size_t)bufferSize);
-    mCurrentSceneRenderData->mInstanceBuffer = mResManager->createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Instance consts");
-    mResManager->copyBuffer(mResManager->getVkBuffer(stagingBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mInstanceBuffer), bufferSize);
-    mResManager->destroyBuffer(stagingBuffer);
+    data.mInstanceBuffer = mResManager->createBuffer(sizeof(InstanceConstants) * data.mInstanceCount, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "Instance consts");
+    if (bufferSize > 0)
+    {
+        uploadBuffer(data.mInstanceBuffer, 0, instanceConsts.data(), bufferSize);
+    }
+}
+
+void Render::fillInstanceConstants(const nevk::Scene& scene, const uint32_t instanceId, InstanceConstants& constants)
+{
+    const nevk::InstanceStorage& sceneInstances = scene.getInstances();
+    const glm::float4x4& transform = sceneInstances.getTransform(instanceId);
+    constants.materialId = sceneInstances.getMaterialId(instanceId);
+    constants.model = transform;
+    constants.normalMatrix = glm::inverse(glm::transpose(transform));
+    // full layout shaders ignore quantization
+    const uint32_t meshId = sceneInstances.getMeshId(instanceId);
+    const std::vector<nevk::Mesh>& meshes = scene.getMeshes();
+    const nevk::AABB bounds = meshId < meshes.size() ? meshes[meshId].mBounds : nevk::AABB{};
+    nevk::getPositionQuantization(bounds, constants.posScale, constants.posBias);
+    constants.vertexLayout = (uint32_t)VERTEX_LAYOUT;
+}
+
+void Render::streamGeometry(const std::vector<nevk::Mesh>& meshes, const void* vertices, const nevk::GpuIndices& indices, SceneRenderData& data, const std::atomic<bool>& cancel)
+{
+    const nevk::VertexLayoutDesc& layout = nevk::getVertexLayoutDesc(VERTEX_LAYOUT);
+    const VkDeviceSize vertexStride = layout.stride + layout.positionStride; // both streams
+    size_t uploadedVertices = 0;
+    size_t uploadedIndices16 = 0;
+    size_t uploadedIndices32 = 0;
+    uint32_t meshIndex = 0;
+    while (meshIndex < meshes.size() && !cancel)
+    {
+        // batch is prefix of vertices up to furthest range end of its meshes, so meshes sharing
+        // ranges are complete once their batch is. Index buffers hold levels of meshes in mesh order
+        size_t vertexEnd = uploadedVertices;
+        size_t index16End = uploadedIndices16;
+        size_t index32End = uploadedIndices32;
+        uint32_t batchEnd = meshIndex;
+        while (batchEnd < meshes.size())
+        {
+            const nevk::Mesh& mesh = meshes[batchEnd];
+            const nevk::MeshDraw& draw = indices.draws[batchEnd];
+            const size_t meshVertexEnd = std::max(vertexEnd, (size_t)mesh.mVertexOffset + mesh.mVertexCount);
+            size_t meshIndexEnd = draw.index16 ? index16End : index32End;
+            for (uint32_t lod = 0; lod <= nevk::kMaxMeshLods; ++lod)
+            {
+                meshIndexEnd = std::max(meshIndexEnd, (size_t)draw.firstIndex[lod] + draw.indexCount[lod]);
+            }
+            const size_t meshIndex16End = draw.index16 ? meshIndexEnd : index16End;
+            const size_t meshIndex32End = draw.index16 ? index32End : meshIndexEnd;
+            const uint64_t batchSize = (meshVertexEnd - uploadedVertices) * vertexStride + (meshIndex16End - uploadedIndices16) * sizeof(uint16_t) +
+                                       (meshIndex32End - uploadedIndices32) * sizeof(uint32_t);
+            if (batchEnd > meshIndex && batchSize > GEOMETRY_UPLOAD_BATCH_SIZE)
+            {
+                break;
+            }
+            vertexEnd = meshVertexEnd;
+            index16End = meshIndex16End;
+            index32End = meshIndex32End;
+            ++batchEnd;
+        }
+
+        const VkDeviceSize vertexBytes = (vertexEnd - uploadedVertices) * layout.stride;
+        const VkDeviceSize positionBytes = (vertexEnd - uploadedVertices) * layout.positionStride;
+        const VkDeviceSize index16Bytes = (index16End - uploadedIndices16) * sizeof(uint16_t);
+        const VkDeviceSize index32Bytes = (index32End - uploadedIndices32) * sizeof(uint32_t);
+        if (vertexBytes + positionBytes + index16Bytes + index32Bytes > 0)
+        {
+            // one submit per batch, render thread keeps drawing meanwhile
+            Buffer* stagingBuffer = mResManager->createBuffer(vertexBytes + positionBytes + index16Bytes + index32Bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            uint8_t* stagingBufferMemory = static_cast<uint8_t*>(mResManager->getMappedMemory(stagingBuffer));
+            VkCommandBuffer commandBuffer = mResManager->beginSingleTimeCommands();
+            VkDeviceSize stagingOffset = 0;
+            // without src staging memory is already written
+            auto copyToBuffer = [&](const void* src, VkDeviceSize size, nevk::Buffer* dst, VkDeviceSize dstOffset) {
+                if (size == 0)
+                {
+                    return;
+                }
+                if (src)
+                {
+                    memcpy(stagingBufferMemory + stagingOffset, src, (size_t)size);
+                }
+                VkBufferCopy copyRegion{};
+                copyRegion.srcOffset = stagingOffset;
+                copyRegion.dstOffset = dstOffset;
+                copyRegion.size = size;
+                vkCmdCopyBuffer(commandBuffer, mResManager->getVkBuffer(stagingBuffer), mResManager->getVkBuffer(dst), 1, &copyRegion);
+                stagingOffset += size;
+            };
+            const uint8_t* batchVertices = static_cast<const uint8_t*>(vertices) + uploadedVertices * layout.stride;
+            copyToBuffer(batchVertices, vertexBytes, data.mVertexBuffer, uploadedVertices * layout.stride);
+            nevk::extractPositions(layout, batchVertices, vertexEnd - uploadedVertices, stagingBufferMemory + stagingOffset);
+            copyToBuffer(nullptr, positionBytes, data.mPositionBuffer, uploadedVertices * layout.positionStride);
+            copyToBuffer(indices.indices16.data() + uploadedIndices16, index16Bytes, data.mIndexBuffer16, uploadedIndices16 * sizeof(uint16_t));
+            copyToBuffer(indices.indices32.data() + uploadedIndices32, index32Bytes, data.mIndexBuffer, uploadedIndices32 * sizeof(uint32_t));
+            mResManager->endSingleTimeCommands(commandBuffer);
+            mResManager->destroyBuffer(stagingBuffer);
+        }
+
+        uploadedVertices = vertexEnd;
+        uploadedIndices16 = index16End;
+        uploadedIndices32 = index32End;
+        meshIndex = batchEnd;
+        data.mResidentMeshCount.store(meshIndex, std::memory_order_release);
+    }
+}
+
+const std::vector<nevk::Scene::VisibleInstances>& Render::filterResident(const std::vector<nevk::Scene::VisibleInstances>& visibility)
+{
+    const uint32_t residentMeshCount = mCurrentSceneRenderData->mResidentMeshCount.load(std::memory_order_acquire);
+    if (residentMeshCount >= mScene->getMeshes().size())
+    {
+        return visibility;
+    }
+    const nevk::InstanceStorage& instances = mScene->getInstances();
+    auto isResident = [&](const uint32_t id) { return instances.getMeshId(id) < residentMeshCount; };
+    mResidentVisibility.resize(visibility.size());
+    for (size_t view = 0; view < visibility.size(); ++view)
+    {
+        // filtering keeps sort order
+        nevk::Scene::VisibleInstances& resident = mResidentVisibility[view];
+        resident.opaque.clear();
+        resident.transparent.clear();
+        std::copy_if(visibility[view].opaque.begin(), visibility[view].opaque.end(), std::back_inserter(resident.opaque), isResident);
+        std::copy_if(visibility[view].transparent.begin(), visibility[view].transparent.end(), std::back_inserter(resident.transparent), isResident);
+    }
+    return mResidentVisibility;
+}
+
+void Render::updateInstanceBuffer(VkCommandBuffer& cmd, nevk::Scene& scene, const uint32_t frameIndex)
+{
+    const std::set<uint32_t>& dirtyInstances = scene.getDirtyInstances();
+    if (dirtyInstances.empty() || !mCurrentSceneRenderData->mInstanceBuffer)
+    {
+        return;
+    }
+
+    // slot is reused together with command buffer of the same frame, so previous copies from it are finished
+    const uint32_t slot = frameIndex % MAX_FRAMES_IN_FLIGHT;
+    nevk::Buffer*& staging = mCurrentSceneRenderData->mInstanceStaging[slot];
+    uint32_t& capacity = mCurrentSceneRenderData->mInstanceStagingCapacity[slot];
+    if (capacity < dirtyInstances.size())
+    {
+        if (staging)
+        {
+            mResManager->destroyBuffer(staging);
+        }
+        capacity = std::max((uint32_t)dirtyInstances.size(), capacity * 2);
+        staging = mResManager->createBuffer(sizeof(InstanceConstants) * capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "Instance staging");
+    }
+
+    InstanceConstants* mapped = static_cast<InstanceConstants*>(mResManager->getMappedMemory(staging));
+    std::vector<VkBufferCopy> regions;
+    uint32_t count = 0;
+    uint32_t prevId = 0;
+    // buffer is grown in drawFrame() before recording, so all dirty ids fit
+    for (const uint32_t id : dirtyInstances)
+    {
+        fillInstanceConstants(scene, id, mapped[count]);
+
+        // set is ordered, neighbour ids are merged into one region
+        if (!regions.empty() && id == prevId + 1)
+        {
+            regions.back().size += sizeof(InstanceConstants);
+        }
+        else
+        {
+            VkBufferCopy region{};
+            region.srcOffset = sizeof(InstanceConstants) * count;
+            region.dstOffset = sizeof(InstanceConstants) * id;
+            region.size = sizeof(InstanceConstants);
+            regions.push_back(region);
+        }
+        prevId = id;
+        ++count;
+    }
+
+    if (!regions.empty())
+    {
+        // previous frames may still read instance buffer
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = mResManager->getVkBuffer(mCurrentSceneRenderData->mInstanceBuffer);
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        vkCmdPipelineBarrier(cmd, shaderStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+        vkCmdCopyBuffer(cmd, mResManager->getVkBuffer(staging), barrier.buffer, (uint32_t)regions.size(), regions.data());
+
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, shaderStages, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    // start collecting changes for next frame
+    scene.beginFrame();
 }
 
 void Render::createDescriptorPool()
@@ -858,16 +1154,19 @@ uint32_t Render::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags prope
     throw std::runtime_error("failed to find suitable memory type!");
 }
 
-void Render::recordCommandBuffer(VkCommandBuffer& cmd, uint32_t imageIndex)
+void Render::recordCommandBuffer(VkCommandBuffer& cmd, uint32_t imageIndex, const std::vector<nevk::Scene::VisibleInstances>& visibility)
 {
-    mDepthPass.record(cmd, mResManager->getVkBuffer(mCurrentSceneRenderData->mVertexBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mIndexBuffer), *mScene, SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT, imageIndex, getActiveCameraIndex());
+    updateInstanceBuffer(cmd, *mScene, imageIndex);
+
+    Camera& activeCamera = mScene->getCamera(getActiveCameraIndex());
+    mDepthPass.record(cmd, mResManager->getVkBuffer(mCurrentSceneRenderData->mPositionBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mIndexBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mIndexBuffer16), mCurrentSceneRenderData->mMeshDraws, *mScene, SHADOW_MAP_WIDTH, SHADOW_MAP_HEIGHT, imageIndex, visibility[eLightView], activeCamera, swapChainExtent.height);
     if (isPBR)
     {
-        mPbrPass.record(cmd, mResManager->getVkBuffer(mCurrentSceneRenderData->mVertexBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mIndexBuffer), *mScene, swapChainExtent.width, swapChainExtent.height, imageIndex, getActiveCameraIndex());
+        mPbrPass.record(cmd, mResManager->getVkBuffer(mCurrentSceneRenderData->mVertexBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mIndexBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mIndexBuffer16), mCurrentSceneRenderData->mMeshDraws, *mScene, swapChainExtent.width, swapChainExtent.height, imageIndex, visibility[eCameraView], activeCamera);
     }
     else
     {
-        mPass.record(cmd, mResManager->getVkBuffer(mCurrentSceneRenderData->mVertexBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mIndexBuffer), *mScene, swapChainExtent.width, swapChainExtent.height, imageIndex, getActiveCameraIndex());
+        mPass.record(cmd, mResManager->getVkBuffer(mCurrentSceneRenderData->mVertexBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mIndexBuffer), mResManager->getVkBuffer(mCurrentSceneRenderData->mIndexBuffer16), mCurrentSceneRenderData->mMeshDraws, *mScene, swapChainExtent.width, swapChainExtent.height, imageIndex, visibility[eCameraView], activeCamera);
     }
 
     //mComputePass.record(cmd, swapChainExtent.width, swapChainExtent.height, imageIndex);
@@ -914,37 +1213,217 @@ void Render::createSyncObjects()
 // load into normal scene
 void Render::loadScene(const std::string& modelPath)
 {
-    if (mScene != nullptr && mScene != mDefaultScene)
-        delete mScene;
-    mScene = new nevk::Scene;
+    if (mSceneLoad)
+    {
+        // one load at a time, latest request starts when current one is finished
+        mNextModelPath = modelPath;
+        return;
+    }
+    mSceneLoad = std::make_unique<SceneLoad>();
+    SceneLoad& load = *mSceneLoad;
+    load.modelPath = modelPath;
+    load.scene = new nevk::Scene;
+    load.scene->setThreadPool(&mLoadThreadPool);
+    load.renderData = new SceneRenderData(mResManager);
+    load.texManager = new nevk::TextureManager(mDevice, mPhysicalDevice, mResManager);
+    load.ready = load.readyPromise.get_future();
+    load.done = std::async(std::launch::async, [this, &load]() { buildScene(load); });
+}
+
+void Render::buildScene(SceneLoad& load)
+{
+    nevk::Scene& scene = *load.scene;
+    SceneRenderData& data = *load.renderData;
+    bool ready = false;
+    try
+    {
+        bool res = false;
+        if (fs::path(load.modelPath).extension() == ".nevk")
+        {
+            res = nevk::SceneSnapshot::load(load.modelPath, scene);
+            if (res)
+            {
+                data.mTextureIds = loadSnapshotTextures(scene, *load.texManager);
+            }
+        }
+        else
+        {
+            // import is CPU only, decoded images are uploaded afterwards in one batch
+            std::vector<nevk::ImportedImage> images;
+            nevk::ModelLoader modelLoader;
+            modelLoader.setMeshOptimization(OPTIMIZE_MESHES, OPTIMIZE_OVERDRAW);
+            res = modelLoader.loadModelGltf(load.modelPath, scene, &images);
+            if (res && !load.cancel)
+            {
+                data.mTextureIds = uploadTextures(images, *load.texManager);
+            }
+        }
+        if (!res || load.cancel)
+        {
+            load.readyPromise.set_value(false);
+            return;
+        }
+        if (scene.getCameraCount() == 0)
+        {
+            Camera camera;
+            camera.updateViewMatrix();
+            scene.addCamera(camera);
+        }
 
-    mCurrentSceneRenderData = new SceneRenderData(mResManager);
-    MODEL_PATH = modelPath;
+        createMaterialBuffer(scene, data);
+        createInstanceBuffer(scene, data);
+        createMeshletBuffer(scene, data);
 
-    isPBR = true;
-    bool res = modelLoader->loadModelGltf(MODEL_PATH, *mScene);
-    // bool res = testmodel.loadModel(MODEL_PATH, MTL_PATH, *mScene);
-    if (!res)
+        load.texManager->createShadowSampler();
+        load.texManager->createTextureSampler();
+
+        // buffers get final size before swap, so draws recorded while geometry streams in bind them
+        createVertexBuffers(scene.getVertexCount(), data);
+        const nevk::GpuIndices indices = nevk::buildGpuIndices(scene.getMeshes(), scene.getIndexData(), scene.getIndexCount());
+        createIndexBuffers(indices, data);
+        // after swap render thread may edit meshes, vertex and index storage does not move until compaction
+        const std::vector<nevk::Mesh> meshes = scene.getMeshes();
+        ready = true;
+        load.readyPromise.set_value(true);
+
+        // compact vertices are encoded here on loader thread, before streaming
+        std::vector<nevk::CompactVertex> compactVertices;
+        const void* vertices = getLayoutVertices(meshes, scene.getVertexData(), scene.getVertexCount(), compactVertices);
+        streamGeometry(meshes, vertices, indices, data, load.cancel);
+    }
+    catch (const std::exception& e)
     {
-        return;
+        std::cerr << "Unable to load scene " << load.modelPath << ": " << e.what() << std::endl;
+        if (!ready)
+        {
+            load.readyPromise.set_value(false);
+        }
     }
+}
 
-    createMaterialBuffer(*mScene);
-    createInstanceBuffer(*mScene);
+void Render::updateSceneLoading()
+{
+    // frames which could use retired scene are finished after MAX_FRAMES_IN_FLIGHT fence waits
+    for (size_t i = 0; i < mRetiredScenes.size();)
+    {
+        if (mRetiredScenes[i].framesLeft == 0)
+        {
+            releaseScene(mRetiredScenes[i]);
+            mRetiredScenes.erase(mRetiredScenes.begin() + i);
+        }
+        else
+        {
+            --mRetiredScenes[i].framesLeft;
+            ++i;
+        }
+    }
 
-    mTexManager->createShadowSampler();
-    mTexManager->createTextureSampler();
+    if (mSceneLoad && !mSceneLoad->swapped && mSceneLoad->ready.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        SceneLoad& load = *mSceneLoad;
+        if (load.ready.get())
+        {
+            // default scene is kept, only its textures go away
+            const bool isDefault = mScene == mDefaultScene;
+            mRetiredScenes.push_back({ isDefault ? nullptr : mScene, isDefault ? nullptr : mCurrentSceneRenderData, mTexManager, MAX_FRAMES_IN_FLIGHT });
+
+            mScene = load.scene;
+            mScene->setThreadPool(&mThreadPool);
+            mCurrentSceneRenderData = load.renderData;
+            mTexManager = load.texManager;
+            MODEL_PATH = load.modelPath;
+            isPBR = true;
+            setDescriptors();
+            load.swapped = true;
+        }
+        else
+        {
+            std::cerr << "Unable to load scene: " << load.modelPath << std::endl;
+            load.done.wait();
+            RetiredScene failed{ load.scene, load.renderData, load.texManager, 0 };
+            releaseScene(failed);
+            mSceneLoad.reset();
+        }
+    }
 
-    setDescriptors();
+    if (mSceneLoad && mSceneLoad->swapped && mSceneLoad->done.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        mSceneLoad.reset();
+    }
 
-    createIndexBuffer(*mScene);
-    createVertexBuffer(*mScene);
+    if (!mSceneLoad && !mNextModelPath.empty())
+    {
+        std::string modelPath;
+        modelPath.swap(mNextModelPath);
+        loadScene(modelPath);
+    }
+}
+
+void Render::waitSceneLoading()
+{
+    mNextModelPath.clear();
+    if (!mSceneLoad)
+    {
+        return;
+    }
+    mSceneLoad->cancel = true;
+    mSceneLoad->done.wait();
+    if (!mSceneLoad->swapped)
+    {
+        RetiredScene pending{ mSceneLoad->scene, mSceneLoad->renderData, mSceneLoad->texManager, 0 };
+        releaseScene(pending);
+    }
+    mSceneLoad.reset();
+}
+
+void Render::releaseScene(RetiredScene& retired)
+{
+    delete retired.renderData;
+    delete retired.scene;
+    if (retired.texManager)
+    {
+        retired.texManager->textureDestroy();
+        delete retired.texManager;
+    }
+}
+
+std::vector<int> Render::uploadTextures(const std::vector<nevk::ImportedImage>& images, nevk::TextureManager& texManager)
+{
+    std::vector<nevk::TextureManager::TextureData> batch;
+    batch.reserve(images.size());
+    for (const nevk::ImportedImage& image : images)
+    {
+        batch.push_back({ image.pixels.data(), image.width, image.height, image.name });
+    }
+    // batch dedupes by name, e.g. two glTF images with same uri, so materials are remapped through returned ids
+    return texManager.loadTextureBatch(batch);
+}
+
+std::vector<int> Render::loadSnapshotTextures(nevk::Scene& scene, nevk::TextureManager& texManager)
+{
+    std::vector<int> ids(scene.mTexturePaths.size(), -1);
+    for (size_t i = 0; i < scene.mTexturePaths.size(); ++i)
+    {
+        const std::string& path = scene.mTexturePaths[i];
+        if (!path.empty() && fs::exists(path))
+        {
+            ids[i] = texManager.loadTextureFile(path);
+        }
+        else
+        {
+            // embedded image or missing file
+            const uint32_t white = 0xFFFFFFFF;
+            ids[i] = texManager.loadTextureGltf(&white, 1, 1, "snapshot placeholder " + std::to_string(i));
+        }
+    }
+    return ids;
 }
 
 void Render::setDescriptors()
 {
     {
         mDepthPass.setInstanceBuffer(mResManager->getVkBuffer(mCurrentSceneRenderData->mInstanceBuffer));
+        mDepthPass.setPositionBuffer(mResManager->getVkBuffer(mCurrentSceneRenderData->mPositionBuffer));
     }
     {
         mPbrPass.setTextureImageView(mTexManager->textureImageView);
@@ -953,6 +1432,7 @@ void Render::setDescriptors()
         mPbrPass.setShadowSampler(mTexManager->shadowSampler);
         mPbrPass.setMaterialBuffer(mResManager->getVkBuffer(mCurrentSceneRenderData->mMaterialBuffer));
         mPbrPass.setInstanceBuffer(mResManager->getVkBuffer(mCurrentSceneRenderData->mInstanceBuffer));
+        mPbrPass.setVertexBuffer(mResManager->getVkBuffer(mCurrentSceneRenderData->mVertexBuffer));
     }
     {
         mPass.setTextureImageView(mTexManager->textureImageView);
@@ -961,6 +1441,7 @@ void Render::setDescriptors()
         mPass.setShadowSampler(mTexManager->shadowSampler);
         mPass.setMaterialBuffer(mResManager->getVkBuffer(mCurrentSceneRenderData->mMaterialBuffer));
         mPass.setInstanceBuffer(mResManager->getVkBuffer(mCurrentSceneRenderData->mInstanceBuffer));
+        mPass.setVertexBuffer(mResManager->getVkBuffer(mCurrentSceneRenderData->mVertexBuffer));
     }
 }
 
@@ -968,6 +1449,7 @@ void Render::setDescriptors()
 void Render::createDefaultScene()
 {
     mDefaultScene = new nevk::Scene;
+    mDefaultScene->setThreadPool(&mThreadPool);
     mScene = mDefaultScene;
     mDefaultSceneRenderData = new SceneRenderData(mResManager);
     mCurrentSceneRenderData = mDefaultSceneRenderData;
@@ -978,13 +1460,14 @@ void Render::createDefaultScene()
 
     mScene->addCamera(camera);
 
-    createMaterialBuffer(*mScene);
-    createInstanceBuffer(*mScene);
+    createMaterialBuffer(*mScene, *mCurrentSceneRenderData);
+    createInstanceBuffer(*mScene, *mCurrentSceneRenderData);
+    createIndexBuffer(*mScene, *mCurrentSceneRenderData);
+    createMeshletBuffer(*mScene, *mCurrentSceneRenderData);
+    createVertexBuffer(*mScene, *mCurrentSceneRenderData);
 
     setDescriptors();
-
-    createIndexBuffer(*mScene);
-    createVertexBuffer(*mScene);
+    mCurrentSceneRenderData->mResidentMeshCount = (uint32_t)mScene->getMeshes().size();
 }
 
 void Render::drawFrame()
@@ -1020,10 +1503,13 @@ void Render::drawFrame()
 
     const uint32_t frameIndex = imageIndex;
 
+    updateSceneLoading();
+
     nevk::Scene* scene = getScene();
     scene->updateCamerasParams(swapChainExtent.width, swapChainExtent.height);
     Camera& cam = scene->getCamera(getActiveCameraIndex());
     cam.update((float)deltaTime);
+    scene->updateTransforms();
 
     const glm::float4x4 lightSpaceMatrix = mDepthPass.computeLightSpaceMatrix((glm::float3&)scene->mLightPosition);
 
@@ -1031,38 +1517,93 @@ void Render::drawFrame()
     mPass.updateUniformBuffer(frameIndex, lightSpaceMatrix, *scene, getActiveCameraIndex());
     mPbrPass.updateUniformBuffer(frameIndex, lightSpaceMatrix, *scene, getActiveCameraIndex());
 
-    static int releaseAfterFrames = 0;
-    static bool needReload = false;
-    static SceneRenderData* toRemoveSceneData = nullptr;
     std::string newModelPath;
 
     mUi.updateUI(*scene, mDepthPass, msPerFrame, newModelPath, mCurrentSceneRenderData->cameraIndex);
 
-    if (!newModelPath.empty() && fs::exists(newModelPath) && newModelPath != MODEL_PATH)
+    // current scene is rendered until new one is loaded
+    if (!newModelPath.empty() && fs::exists(newModelPath) && newModelPath != MODEL_PATH && (!mSceneLoad || newModelPath != mSceneLoad->modelPath))
     {
-        if (mScene != mDefaultScene) // if we reload non-default scene
-        {
-            // save scene data to remove
-            toRemoveSceneData = mCurrentSceneRenderData;
-            needReload = true;
-            releaseAfterFrames = MAX_FRAMES_IN_FLIGHT;
-        }
-        mTexManager->saveTexturesInDelQueue();
         loadScene(newModelPath);
     }
 
-    if (needReload && releaseAfterFrames == 0)
+    // loader thread reads geometry of current scene while it streams in
+    const bool isStreaming = mSceneLoad && mSceneLoad->swapped;
+    if (mScene->needsCompaction() && !isStreaming)
     {
-        mTexManager->delTexturesFromQueue();
-        delete toRemoveSceneData;
-        needReload = false;
+        // mesh ranges move, old buffers must not be in use
+        {
+            std::lock_guard<std::mutex> lock(mResManager->getQueueMutex());
+            vkDeviceWaitIdle(mDevice);
+        }
+        mScene->compactGeometry();
+        if (mCurrentSceneRenderData->mIndexBuffer)
+        {
+            mResManager->destroyBuffer(mCurrentSceneRenderData->mIndexBuffer);
+            mCurrentSceneRenderData->mIndexBuffer = nullptr;
+        }
+        if (mCurrentSceneRenderData->mIndexBuffer16)
+        {
+            mResManager->destroyBuffer(mCurrentSceneRenderData->mIndexBuffer16);
+            mCurrentSceneRenderData->mIndexBuffer16 = nullptr;
+        }
+        if (mCurrentSceneRenderData->mVertexBuffer)
+        {
+            mResManager->destroyBuffer(mCurrentSceneRenderData->mVertexBuffer);
+            mCurrentSceneRenderData->mVertexBuffer = nullptr;
+        }
+        if (mCurrentSceneRenderData->mPositionBuffer)
+        {
+            mResManager->destroyBuffer(mCurrentSceneRenderData->mPositionBuffer);
+            mCurrentSceneRenderData->mPositionBuffer = nullptr;
+        }
+        if (mCurrentSceneRenderData->mMeshletBuffer)
+        {
+            mResManager->destroyBuffer(mCurrentSceneRenderData->mMeshletBuffer);
+            mCurrentSceneRenderData->mMeshletBuffer = nullptr;
+        }
+        createIndexBuffer(*mScene, *mCurrentSceneRenderData);
+        createMeshletBuffer(*mScene, *mCurrentSceneRenderData);
+        createVertexBuffer(*mScene, *mCurrentSceneRenderData);
+        mCurrentSceneRenderData->mResidentMeshCount = (uint32_t)mScene->getMeshes().size();
+        // vertex pulling reads new vertex buffers through descriptors
+        setDescriptors();
     }
-    if (needReload)
+
+    // instances added after load do not fit instance buffer, it is recreated with headroom
+    const uint32_t instanceCount = (uint32_t)mScene->getInstances().size();
+    if (instanceCount > mCurrentSceneRenderData->mInstanceCount)
     {
-        --releaseAfterFrames;
+        {
+            std::lock_guard<std::mutex> lock(mResManager->getQueueMutex());
+            vkDeviceWaitIdle(mDevice);
+        }
+        if (mCurrentSceneRenderData->mInstanceBuffer)
+        {
+            mResManager->destroyBuffer(mCurrentSceneRenderData->mInstanceBuffer);
+            mCurrentSceneRenderData->mInstanceBuffer = nullptr;
+        }
+        createInstanceBuffer(*mScene, *mCurrentSceneRenderData, std::max(instanceCount, mCurrentSceneRenderData->mInstanceCount * 2));
+        setDescriptors();
     }
 
-    glfwSetWindowTitle(mWindow, (std::string("NeVK") + " [" + std::to_string(msPerFrame) + " ms]").c_str());
+    // all views are culled and sorted once per frame, in parallel, after scene changes of this frame
+    Camera& activeCamera = mScene->getCamera(getActiveCameraIndex());
+    mViews.resize(eViewCount);
+    mViews[eCameraView] = { activeCamera.getPosition(), activeCamera.getPerspective() * activeCamera.getView() };
+    mViews[eLightView] = { glm::float3(mScene->mLightPosition), lightSpaceMatrix };
+    const std::vector<nevk::Scene::VisibleInstances>& visibility = filterResident(mScene->computeVisibility(mViews));
+
+    std::string title = std::string("NeVK") + " [" + std::to_string(msPerFrame) + " ms]";
+    if (mSceneLoad)
+    {
+        title += " loading " + mSceneLoad->modelPath;
+        if (isStreaming)
+        {
+            title += " (" + std::to_string(mCurrentSceneRenderData->mResidentMeshCount.load()) + "/" + std::to_string(mScene->getMeshes().size()) + " meshes)";
+        }
+    }
+    glfwSetWindowTitle(mWindow, title.c_str());
 
     VkCommandBuffer& cmdBuff = getFrameData(imageIndex).cmdBuffer;
     vkResetCommandBuffer(cmdBuff, 0);
@@ -1075,7 +1616,7 @@ void Render::drawFrame()
 
     vkBeginCommandBuffer(cmdBuff, &cmdBeginInfo);
 
-    recordCommandBuffer(cmdBuff, frameIndex);
+    recordCommandBuffer(cmdBuff, frameIndex, visibility);
 
     if (vkEndCommandBuffer(cmdBuff) != VK_SUCCESS)
     {
@@ -1100,9 +1641,12 @@ void Render::drawFrame()
 
     vkResetFences(mDevice, 1, &currFrame.inFlightFence);
 
-    if (vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, currFrame.inFlightFence) != VK_SUCCESS)
     {
-        throw std::runtime_error("failed to submit draw command buffer!");
+        std::lock_guard<std::mutex> lock(mResManager->getQueueMutex());
+        if (vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, currFrame.inFlightFence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("failed to submit draw command buffer!");
+        }
     }
 
     VkPresentInfoKHR presentInfo{};
@@ -1117,7 +1661,10 @@ void Render::drawFrame()
 
     presentInfo.pImageIndices = &imageIndex;
 
-    result = vkQueuePresentKHR(mPresentQueue, &presentInfo);
+    {
+        std::lock_guard<std::mutex> lock(mResManager->getQueueMutex());
+        result = vkQueuePresentKHR(mPresentQueue, &presentInfo);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized)
     {
         framebufferResized = false;
@@ -67,13 +67,18 @@ VkPipeline RenderPass::createGraphicsPipeline(VkShaderModule& vertShaderModule,
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    auto bindingDescription = getBindingDescription();
-    auto attributeDescriptions = getAttributeDescriptions();
+    const VertexLayoutDesc& layout = getVertexLayoutDesc(mVertexLayout);
+    auto bindingDescription = getBindingDescription(layout);
+    auto attributeDescriptions = getAttributeDescriptions(layout);
 
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    // no vertex input with vertex pulling, shader decodes vertices of any layout itself
+    if (!mVertexPulling)
+    {
+        vertexInputInfo.vertexBindingDescriptionCount = 1;
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+        vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
+        vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+    }
 
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -336,8 +341,19 @@ void RenderPass::createDescriptorSetLayout()
     instanceLayoutBinding.pImmutableSamplers = nullptr;
     instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    std::array<VkDescriptorSetLayoutBinding, 7> bindings = { uboLayoutBinding, texLayoutBinding, samplerLayoutBinding, 
+    VkDescriptorSetLayoutBinding vertexLayoutBinding{};
+    vertexLayoutBinding.binding = 7;
+    vertexLayoutBinding.descriptorCount = 1;
+    vertexLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    vertexLayoutBinding.pImmutableSamplers = nullptr;
+    vertexLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    std::vector<VkDescriptorSetLayoutBinding> bindings = { uboLayoutBinding, texLayoutBinding, samplerLayoutBinding, 
         materialLayoutBinding, shadowImageLayoutBinding, shadowSamplerLayoutBinding, instanceLayoutBinding };
+    if (mVertexPulling)
+    {
+        bindings.push_back(vertexLayoutBinding);
+    }
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -370,7 +386,7 @@ void RenderPass::createDescriptorSets(VkDescriptorPool& descriptorPool)
     }
 }
 
-void RenderPass::record(VkCommandBuffer& cmd, VkBuffer vertexBuffer, VkBuffer indexBuffer, nevk::Scene& scene, uint32_t width, uint32_t height, uint32_t imageIndex, uint32_t cameraIndex)
+void RenderPass::record(VkCommandBuffer& cmd, VkBuffer vertexBuffer, VkBuffer indexBuffer, VkBuffer indexBuffer16, const std::vector<MeshDraw>& meshDraws, nevk::Scene& scene, uint32_t width, uint32_t height, uint32_t imageIndex, const Scene::VisibleInstances& visible, Camera& camera)
 {
     beginLabel(cmd, "Geometry Pass", { 1.0f, 0.0f, 0.0f, 1.0f });
 
@@ -385,8 +401,8 @@ void RenderPass::record(VkCommandBuffer& cmd, VkBuffer vertexBuffer, VkBuffer in
         needDesciptorSetUpdate = false;
     }
 
-    const std::vector<uint32_t>& opaqueIds = scene.getOpaqueInstancesToRender(scene.getCamera(cameraIndex).getPosition());
-    const std::vector<uint32_t>& transparentIds = scene.getTransparentInstancesToRender(scene.getCamera(cameraIndex).getPosition());
+    const std::vector<uint32_t>& opaqueIds = visible.opaque;
+    const std::vector<uint32_t>& transparentIds = visible.transparent;
 
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -415,28 +431,42 @@ void RenderPass::record(VkCommandBuffer& cmd, VkBuffer vertexBuffer, VkBuffer in
 
     VkBuffer vertexBuffers[] = { vertexBuffer };
     VkDeviceSize offsets[] = { 0 };
-    if (vertexBuffer)
+    if (vertexBuffer && !mVertexPulling)
     {
         vkCmdBindVertexBuffers(cmd, 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(cmd, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
     }
 
-    const std::vector<Instance>& instances = scene.getInstances();
-    const std::vector<Mesh>& meshes = scene.getMeshes();
+    const InstanceStorage& instances = scene.getInstances();
+
+    const glm::float3 eye = camera.getPosition();
+    const float pixelScale = camera.getPixelScale((float)height);
 
-    auto renderInstances = [&cmd, &instances, &meshes](VkPipelineLayout layout, const std::vector<uint32_t>& ids) {
+    // meshes of both index types are mixed in draw order, buffer is rebound when type changes
+    VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+    auto renderInstances = [&cmd, &instances, &meshDraws, &scene, &eye, pixelScale, indexBuffer, indexBuffer16, &boundIndexType](VkPipelineLayout layout, const std::vector<uint32_t>& ids) {
         for (const uint32_t currentInstanceId : ids)
         {
-            const uint32_t currentMeshId = instances[currentInstanceId].mMeshId;
-            const uint32_t indexOffset = meshes[currentMeshId].mIndex;
-            const uint32_t indexCount = meshes[currentMeshId].mCount;
+            const uint32_t currentMeshId = instances.getMeshId(currentInstanceId);
+            // meshes created after upload are not in index buffers
+            if (currentMeshId >= meshDraws.size())
+            {
+                continue;
+            }
+            const MeshDraw& draw = meshDraws[currentMeshId];
+            const uint32_t lod = scene.selectLod(currentInstanceId, eye, pixelScale, scene.lodPixelError);
+            const VkIndexType indexType = draw.index16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+            if (indexType != boundIndexType)
+            {
+                vkCmdBindIndexBuffer(cmd, draw.index16 ? indexBuffer16 : indexBuffer, 0, indexType);
+                boundIndexType = indexType;
+            }
 
             InstancePushConstants constants = {};
             constants.instanceId = currentInstanceId;
 
             vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(InstancePushConstants), &constants);
 
-            vkCmdDrawIndexed(cmd, indexCount, 1, indexOffset, 0, 0);
+            vkCmdDrawIndexed(cmd, draw.indexCount[lod], 1, draw.firstIndex[lod], draw.vertexOffset, 0);
         }
     };
 
@@ -580,6 +610,13 @@ void RenderPass::setInstanceBuffer(VkBuffer instanceBuffer)
     needDesciptorSetUpdate = true;
 }
 
+void RenderPass::setVertexBuffer(VkBuffer vertexBuffer)
+{
+    mVertexBuffer = vertexBuffer;
+    imageViewCounter = 0;
+    needDesciptorSetUpdate = true;
+}
+
 void RenderPass::updateDescriptorSets(uint32_t descSetIndex)
 {
     VkDescriptorBufferInfo bufferInfo{};
@@ -610,6 +647,11 @@ void RenderPass::updateDescriptorSets(uint32_t descSetIndex)
     instanceInfo.offset = 0;
     instanceInfo.range = VK_WHOLE_SIZE;
 
+    VkDescriptorBufferInfo vertexInfo{};
+    vertexInfo.buffer = mVertexBuffer;
+    vertexInfo.offset = 0;
+    vertexInfo.range = VK_WHOLE_SIZE;
+
     VkDescriptorImageInfo shadowImageInfo{};
     shadowImageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
     shadowImageInfo.imageView = mShadowImageView;
@@ -703,6 +745,19 @@ void RenderPass::updateDescriptorSets(uint32_t descSetIndex)
         descriptorWrites.push_back(descriptorWrite);
     }
 
+    if (mVertexPulling && mVertexBuffer != VK_NULL_HANDLE)
+    {
+        VkWriteDescriptorSet descriptorWrite{};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = mDescriptorSets[descSetIndex];
+        descriptorWrite.dstBinding = 7;
+        descriptorWrite.dstArrayElement = 0;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pBufferInfo = &vertexInfo;
+        descriptorWrites.push_back(descriptorWrite);
+    }
+
     vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 } // namespace nevk
@@ -227,6 +227,8 @@ VkImage ResourceManager::getVkImage(const Image* image)
 
 VkCommandBuffer ResourceManager::beginSingleTimeCommands()
 {
+    mCommandPoolMutex.lock();
+
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -255,18 +257,30 @@ void ResourceManager::endSingleTimeCommands(VkCommandBuffer commandBuffer)
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
-    vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(mGraphicsQueue);
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence = VK_NULL_HANDLE;
+    vkCreateFence(mDevice, &fenceInfo, nullptr, &fence);
+    {
+        std::lock_guard<std::mutex> lock(mQueueMutex);
+        vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, fence);
+    }
+    // unlike vkQueueWaitIdle does not wait for frames submitted meanwhile
+    vkWaitForFences(mDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+    vkDestroyFence(mDevice, fence, nullptr);
 
     vkFreeCommandBuffers(mDevice, mCommandPool, 1, &commandBuffer);
+
+    mCommandPoolMutex.unlock();
 }
 
-void ResourceManager::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void ResourceManager::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize dstOffset)
 {
     VkCommandBuffer commandBuffer = beginSingleTimeCommands();
 
     VkBufferCopy copyRegion{};
     copyRegion.size = size;
+    copyRegion.dstOffset = dstOffset;
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
 
     endSingleTimeCommands(commandBuffer);
@@ -0,0 +1,321 @@
+#include "bvh.h"
+
+#include "simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+
+namespace nevk
+{
+
+AABB AABB::empty()
+{
+    AABB res;
+    res.minimum = glm::float3(std::numeric_limits<float>::max());
+    res.maximum = glm::float3(-std::numeric_limits<float>::max());
+    return res;
+}
+
+void AABB::expand(const AABB& other)
+{
+    minimum = glm::min(minimum, other.minimum);
+    maximum = glm::max(maximum, other.maximum);
+}
+
+void AABB::expand(const glm::float3& point)
+{
+    minimum = glm::min(minimum, point);
+    maximum = glm::max(maximum, point);
+}
+
+float AABB::surfaceArea() const
+{
+    const glm::float3 d = glm::max(maximum - minimum, glm::float3(0.0f));
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+AABB AABB::transform(const glm::float4x4& m) const
+{
+    const glm::float3 c = center();
+    const glm::float3 e = extent();
+    const glm::float3 newCenter = glm::float3(m * glm::float4(c, 1.0f));
+    glm::float3 newExtent{ 0.0f };
+    for (int i = 0; i < 3; ++i)
+    {
+        newExtent[i] = std::abs(m[0][i]) * e.x + std::abs(m[1][i]) * e.y + std::abs(m[2][i]) * e.z;
+    }
+    AABB res;
+    res.minimum = newCenter - newExtent;
+    res.maximum = newCenter + newExtent;
+    return res;
+}
+
+Frustum::Frustum(const glm::float4x4& m)
+{
+    // glm is column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    const glm::float4 row0 = glm::float4(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::float4 row1 = glm::float4(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::float4 row2 = glm::float4(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::float4 row3 = glm::float4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    mPlanes[0] = row3 + row0; // left
+    mPlanes[1] = row3 - row0; // right
+    mPlanes[2] = row3 + row1; // bottom
+    mPlanes[3] = row3 - row1; // top
+    mPlanes[4] = row2; // near, depth in [0; 1]
+    mPlanes[5] = row3 - row2; // far
+}
+
+Frustum::Result Frustum::test(const AABB& box) const
+{
+    Result res = Result::eInside;
+    for (const glm::float4& plane : mPlanes)
+    {
+        // farthest corner along plane normal
+        const glm::float3 positive = glm::float3(plane.x >= 0.0f ? box.maximum.x : box.minimum.x,
+                                                 plane.y >= 0.0f ? box.maximum.y : box.minimum.y,
+                                                 plane.z >= 0.0f ? box.maximum.z : box.minimum.z);
+        if (plane.x * positive.x + plane.y * positive.y + plane.z * positive.z + plane.w < 0.0f)
+        {
+            return Result::eOutside;
+        }
+        const glm::float3 negative = glm::float3(plane.x >= 0.0f ? box.minimum.x : box.maximum.x,
+                                                 plane.y >= 0.0f ? box.minimum.y : box.maximum.y,
+                                                 plane.z >= 0.0f ? box.minimum.z : box.maximum.z);
+        if (plane.x * negative.x + plane.y * negative.y + plane.z * negative.z + plane.w < 0.0f)
+        {
+            res = Result::eIntersect;
+        }
+    }
+    return res;
+}
+
+uint32_t Frustum::testVisible4(const AABB* const boxes[4], const uint32_t count) const
+{
+#if defined(NEVK_SSE)
+    // transpose boxes into registers, missing lanes repeat first box
+    const AABB& b0 = *boxes[0];
+    const AABB& b1 = count > 1 ? *boxes[1] : b0;
+    const AABB& b2 = count > 2 ? *boxes[2] : b0;
+    const AABB& b3 = count > 3 ? *boxes[3] : b0;
+    const __m128 minX = _mm_set_ps(b3.minimum.x, b2.minimum.x, b1.minimum.x, b0.minimum.x);
+    const __m128 minY = _mm_set_ps(b3.minimum.y, b2.minimum.y, b1.minimum.y, b0.minimum.y);
+    const __m128 minZ = _mm_set_ps(b3.minimum.z, b2.minimum.z, b1.minimum.z, b0.minimum.z);
+    const __m128 maxX = _mm_set_ps(b3.maximum.x, b2.maximum.x, b1.maximum.x, b0.maximum.x);
+    const __m128 maxY = _mm_set_ps(b3.maximum.y, b2.maximum.y, b1.maximum.y, b0.maximum.y);
+    const __m128 maxZ = _mm_set_ps(b3.maximum.z, b2.maximum.z, b1.maximum.z, b0.maximum.z);
+
+    __m128 outside = _mm_setzero_ps();
+    for (const glm::float4& plane : mPlanes)
+    {
+        // distance of farthest corner along plane normal
+        const __m128 px = _mm_set1_ps(plane.x);
+        const __m128 py = _mm_set1_ps(plane.y);
+        const __m128 pz = _mm_set1_ps(plane.z);
+        __m128 d = _mm_max_ps(_mm_mul_ps(px, minX), _mm_mul_ps(px, maxX));
+        d = _mm_add_ps(d, _mm_max_ps(_mm_mul_ps(py, minY), _mm_mul_ps(py, maxY)));
+        d = _mm_add_ps(d, _mm_max_ps(_mm_mul_ps(pz, minZ), _mm_mul_ps(pz, maxZ)));
+        d = _mm_add_ps(d, _mm_set1_ps(plane.w));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(d, _mm_setzero_ps()));
+    }
+    return ~(uint32_t)_mm_movemask_ps(outside) & ((1u << count) - 1);
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (test(*boxes[i]) != Result::eOutside)
+        {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+void Bvh::build(const std::vector<uint32_t>& ids, const std::vector<AABB>& bounds)
+{
+    mNodes.clear();
+    mPrimIds = ids;
+    mLeafOfPrim.assign(bounds.size(), kInvalidNode);
+    mBuildArea = 0.0f;
+    if (mPrimIds.empty())
+    {
+        return;
+    }
+
+    mNodes.reserve(2 * (mPrimIds.size() / kMaxLeafSize + 1));
+    Node root{};
+    root.first = 0;
+    root.count = (uint32_t)mPrimIds.size();
+    root.left = 0;
+    root.parent = kInvalidNode;
+    mNodes.push_back(root);
+    subdivide(0, bounds);
+
+    mRefitMarks.assign(mNodes.size(), 0);
+    mBuildArea = mNodes[0].bounds.surfaceArea();
+}
+
+void Bvh::subdivide(uint32_t nodeIndex, const std::vector<AABB>& bounds)
+{
+    const uint32_t first = mNodes[nodeIndex].first;
+    const uint32_t count = mNodes[nodeIndex].count;
+
+    AABB nodeBounds = AABB::empty();
+    AABB centroidBounds = AABB::empty();
+    for (uint32_t i = first; i < first + count; ++i)
+    {
+        const AABB& primBounds = bounds[mPrimIds[i]];
+        nodeBounds.expand(primBounds);
+        centroidBounds.expand(primBounds.center());
+    }
+    mNodes[nodeIndex].bounds = nodeBounds;
+
+    const glm::float3 centroidExtent = centroidBounds.maximum - centroidBounds.minimum;
+    if (count <= kMaxLeafSize || std::max(centroidExtent.x, std::max(centroidExtent.y, centroidExtent.z)) <= 0.0f)
+    {
+        for (uint32_t i = first; i < first + count; ++i)
+        {
+            mLeafOfPrim[mPrimIds[i]] = nodeIndex;
+        }
+        return;
+    }
+
+    // median split along the widest centroid axis
+    int axis = 0;
+    if (centroidExtent.y > centroidExtent[axis])
+    {
+        axis = 1;
+    }
+    if (centroidExtent.z > centroidExtent[axis])
+    {
+        axis = 2;
+    }
+    const uint32_t mid = first + count / 2;
+    std::nth_element(mPrimIds.begin() + first, mPrimIds.begin() + mid, mPrimIds.begin() + first + count,
+                     [&bounds, axis](const uint32_t a, const uint32_t b) {
+                         return bounds[a].center()[axis] < bounds[b].center()[axis];
+                     });
+
+    const uint32_t leftIndex = (uint32_t)mNodes.size();
+    Node left{};
+    left.first = first;
+    left.count = mid - first;
+    left.parent = nodeIndex;
+    Node right{};
+    right.first = mid;
+    right.count = first + count - mid;
+    right.parent = nodeIndex;
+    mNodes.push_back(left);
+    mNodes.push_back(right);
+    mNodes[nodeIndex].left = leftIndex;
+
+    subdivide(leftIndex, bounds);
+    subdivide(leftIndex + 1, bounds);
+}
+
+void Bvh::refit(const std::vector<uint32_t>& dirtyIds, const std::vector<AABB>& bounds)
+{
+    if (mNodes.empty())
+    {
+        return;
+    }
+
+    // collect dirty leaves and their ancestors, stop at already marked node
+    mRefitNodes.clear();
+    for (const uint32_t id : dirtyIds)
+    {
+        if (id >= mLeafOfPrim.size() || mLeafOfPrim[id] == kInvalidNode)
+        {
+            continue;
+        }
+        uint32_t nodeIndex = mLeafOfPrim[id];
+        while (nodeIndex != kInvalidNode && !mRefitMarks[nodeIndex])
+        {
+            mRefitMarks[nodeIndex] = 1;
+            mRefitNodes.push_back(nodeIndex);
+            nodeIndex = mNodes[nodeIndex].parent;
+        }
+    }
+
+    // children are always stored after parents, so reverse order updates children first
+    std::sort(mRefitNodes.begin(), mRefitNodes.end(), std::greater<uint32_t>());
+    for (const uint32_t nodeIndex : mRefitNodes)
+    {
+        Node& node = mNodes[nodeIndex];
+        if (node.left == 0)
+        {
+            node.bounds = AABB::empty();
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+                node.bounds.expand(bounds[mPrimIds[i]]);
+            }
+        }
+        else
+        {
+            node.bounds = mNodes[node.left].bounds;
+            node.bounds.expand(mNodes[node.left + 1].bounds);
+        }
+        mRefitMarks[nodeIndex] = 0;
+    }
+}
+
+void Bvh::cull(const Frustum& frustum, const std::vector<AABB>& bounds, std::vector<uint32_t>& result) const
+{
+    if (mNodes.empty())
+    {
+        return;
+    }
+
+    uint32_t stack[64];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const Node& node = mNodes[stack[--stackSize]];
+        const Frustum::Result res = frustum.test(node.bounds);
+        if (res == Frustum::Result::eOutside)
+        {
+            continue;
+        }
+        if (res == Frustum::Result::eInside)
+        {
+            // whole subtree is visible, its primitives are stored contiguously
+            result.insert(result.end(), mPrimIds.begin() + node.first, mPrimIds.begin() + node.first + node.count);
+            continue;
+        }
+        if (node.left == 0)
+        {
+            // test leaf primitives in groups of 4, leaves with coincident centroids may hold more
+            for (uint32_t first = node.first; first < node.first + node.count; first += 4)
+            {
+                const uint32_t count = std::min(4u, node.first + node.count - first);
+                const AABB* boxes[4];
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    boxes[i] = &bounds[mPrimIds[first + i]];
+                }
+                const uint32_t mask = frustum.testVisible4(boxes, count);
+                for (uint32_t i = 0; i < count; ++i)
+                {
+                    if (mask & (1u << i))
+                    {
+                        result.push_back(mPrimIds[first + i]);
+                    }
+                }
+            }
+            continue;
+        }
+        stack[stackSize++] = node.left;
+        stack[stackSize++] = node.left + 1;
+    }
+}
+
+bool Bvh::needsRebuild() const
+{
+    return !mNodes.empty() && mNodes[0].bounds.surfaceArea() > 2.0f * mBuildArea;
+}
+
+} // namespace nevk
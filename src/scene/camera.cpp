@@ -65,6 +65,11 @@ void Camera::setPerspective(float _fov, float _aspect, float _znear, float _zfar
     matrices.perspective = glm::perspective(glm::radians(fov), _aspect, znear, zfar);
 }
 
+float Camera::getPixelScale(float viewportHeight)
+{
+    return viewportHeight / (2.0f * tanf(glm::radians(fov) * 0.5f));
+}
+
 glm::float4x4& Camera::getPerspective()
 {
     return matrices.perspective;
@@ -0,0 +1,116 @@
+#include "hierarchy.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace nevk
+{
+
+uint32_t TransformHierarchy::createNode(const uint32_t parent, const glm::float4x4& localTransform)
+{
+    const uint32_t node = (uint32_t)mLocal.size();
+    mLocal.push_back(localTransform);
+    mWorld.push_back(parent == kInvalidNode ? localTransform : mWorld[parent] * localTransform);
+    mParent.push_back(parent);
+    mLevel.push_back(parent == kInvalidNode ? 0 : mLevel[parent] + 1);
+    mChildren.emplace_back();
+    mDirty.push_back(0);
+    mStamps.push_back(0);
+    if (parent != kInvalidNode)
+    {
+        mChildren[parent].push_back(node);
+    }
+    return node;
+}
+
+void TransformHierarchy::setLocalTransform(const uint32_t node, const glm::float4x4& localTransform)
+{
+    mLocal[node] = localTransform;
+    if (!mDirty[node])
+    {
+        mDirty[node] = 1;
+        mDirtyNodes.push_back(node);
+    }
+}
+
+const std::vector<uint32_t>& TransformHierarchy::update(ThreadPool* pool)
+{
+    mUpdated.clear();
+    if (mDirtyNodes.empty())
+    {
+        return mUpdated;
+    }
+
+    if (mStamp == std::numeric_limits<uint32_t>::max())
+    {
+        std::fill(mStamps.begin(), mStamps.end(), 0);
+        mStamp = 0;
+    }
+    ++mStamp;
+
+    // dirty nodes grouped by level, they join traversal when it reaches their level
+    for (std::vector<uint32_t>& bucket : mDirtyByLevel)
+    {
+        bucket.clear();
+    }
+    for (const uint32_t node : mDirtyNodes)
+    {
+        mDirty[node] = 0;
+        if (mDirtyByLevel.size() <= mLevel[node])
+        {
+            mDirtyByLevel.resize(mLevel[node] + 1);
+        }
+        mDirtyByLevel[mLevel[node]].push_back(node);
+    }
+    mDirtyNodes.clear();
+
+    mCurrentLevel.clear();
+    for (uint32_t level = 0; level < mDirtyByLevel.size() || !mCurrentLevel.empty(); ++level)
+    {
+        if (level < mDirtyByLevel.size())
+        {
+            for (const uint32_t node : mDirtyByLevel[level])
+            {
+                // skip nodes already reached from dirty ancestor
+                if (mStamps[node] != mStamp)
+                {
+                    mStamps[node] = mStamp;
+                    mCurrentLevel.push_back(node);
+                }
+            }
+        }
+
+        auto updateRange = [this](const uint32_t begin, const uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                const uint32_t node = mCurrentLevel[i];
+                const uint32_t parent = mParent[node];
+                mWorld[node] = parent == kInvalidNode ? mLocal[node] : mWorld[parent] * mLocal[node];
+            }
+        };
+        const uint32_t count = (uint32_t)mCurrentLevel.size();
+        if (pool && count > kParallelGrain)
+        {
+            pool->parallelFor(count, kParallelGrain, updateRange);
+        }
+        else
+        {
+            updateRange(0, count);
+        }
+        mUpdated.insert(mUpdated.end(), mCurrentLevel.begin(), mCurrentLevel.end());
+
+        mNextLevel.clear();
+        for (const uint32_t node : mCurrentLevel)
+        {
+            for (const uint32_t child : mChildren[node])
+            {
+                mStamps[child] = mStamp;
+                mNextLevel.push_back(child);
+            }
+        }
+        mCurrentLevel.swap(mNextLevel);
+    }
+    return mUpdated;
+}
+
+} // namespace nevk
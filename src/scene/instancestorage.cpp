@@ -0,0 +1,82 @@
+#include "instancestorage.h"
+
+#include "simd.h"
+
+namespace nevk
+{
+
+void InstanceStorage::resize(const size_t count)
+{
+    mTransforms.resize(count, glm::float4x4(1.0f));
+    mCenterX.resize(count, 0.0f);
+    mCenterY.resize(count, 0.0f);
+    mCenterZ.resize(count, 0.0f);
+    mMeshIds.resize(count, 0);
+    mMaterialIds.resize(count, 0);
+    mFlags.resize(count, eNone);
+}
+
+void InstanceStorage::set(const uint32_t id, const Instance& inst, const uint8_t flags)
+{
+    mTransforms[id] = inst.transform;
+    mCenterX[id] = inst.massCenter.x;
+    mCenterY[id] = inst.massCenter.y;
+    mCenterZ[id] = inst.massCenter.z;
+    mMeshIds[id] = inst.mMeshId;
+    mMaterialIds[id] = inst.mMaterialId;
+    mFlags[id] = flags;
+}
+
+Instance InstanceStorage::operator[](const size_t id) const
+{
+    Instance inst;
+    inst.transform = mTransforms[id];
+    inst.mMeshId = mMeshIds[id];
+    inst.mMaterialId = mMaterialIds[id];
+    inst.massCenter = glm::float3(mCenterX[id], mCenterY[id], mCenterZ[id]);
+    return inst;
+}
+
+void InstanceStorage::computeDistances2(const glm::float3& point, float* out) const
+{
+    const size_t count = size();
+    const float* cx = mCenterX.data();
+    const float* cy = mCenterY.data();
+    const float* cz = mCenterZ.data();
+    size_t i = 0;
+#if defined(NEVK_AVX)
+    const __m256 px8 = _mm256_set1_ps(point.x);
+    const __m256 py8 = _mm256_set1_ps(point.y);
+    const __m256 pz8 = _mm256_set1_ps(point.z);
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 dx = _mm256_sub_ps(_mm256_load_ps(cx + i), px8);
+        const __m256 dy = _mm256_sub_ps(_mm256_load_ps(cy + i), py8);
+        const __m256 dz = _mm256_sub_ps(_mm256_load_ps(cz + i), pz8);
+        const __m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+        _mm256_storeu_ps(out + i, d2);
+    }
+#endif
+#if defined(NEVK_SSE)
+    const __m128 px4 = _mm_set1_ps(point.x);
+    const __m128 py4 = _mm_set1_ps(point.y);
+    const __m128 pz4 = _mm_set1_ps(point.z);
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 dx = _mm_sub_ps(_mm_load_ps(cx + i), px4);
+        const __m128 dy = _mm_sub_ps(_mm_load_ps(cy + i), py4);
+        const __m128 dz = _mm_sub_ps(_mm_load_ps(cz + i), pz4);
+        const __m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        _mm_storeu_ps(out + i, d2);
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        const float dx = cx[i] - point.x;
+        const float dy = cy[i] - point.y;
+        const float dz = cz[i] - point.z;
+        out[i] = dx * dx + dy * dy + dz * dz;
+    }
+}
+
+} // namespace nevk
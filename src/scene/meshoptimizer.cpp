@@ -0,0 +1,852 @@
+#include "meshoptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace nevk
+{
+
+static constexpr uint32_t kNoVertex = std::numeric_limits<uint32_t>::max();
+
+// FIFO cache simulated with timestamps: vertex is cached while less than cacheSize vertices were added after it
+static uint32_t updateCache(const uint32_t* triangle, std::vector<uint32_t>& timestamps, uint32_t& timestamp, const uint32_t cacheSize)
+{
+    uint32_t misses = 0;
+    for (uint32_t k = 0; k < 3; ++k)
+    {
+        const uint32_t v = triangle[k];
+        if (timestamp - timestamps[v] > cacheSize)
+        {
+            timestamps[v] = timestamp++;
+            ++misses;
+        }
+    }
+    return misses;
+}
+
+// Triangles around each vertex: adjacency[offsets[v]] .. adjacency[offsets[v + 1]]
+static void buildAdjacency(const std::vector<uint32_t>& indices, const size_t vertexCount, std::vector<uint32_t>& offsets, std::vector<uint32_t>& adjacency)
+{
+    const size_t cornerCount = indices.size() / 3 * 3;
+    offsets.assign(vertexCount + 1, 0);
+    for (size_t i = 0; i < cornerCount; ++i)
+    {
+        ++offsets[indices[i] + 1];
+    }
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        offsets[v + 1] += offsets[v];
+    }
+    adjacency.resize(cornerCount);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < cornerCount; ++i)
+    {
+        adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+    }
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, const size_t vertexCount, const uint32_t cacheSize)
+{
+    VertexCacheStats stats{};
+    stats.triangles = indices.size() / 3;
+
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t timestamp = cacheSize + 1;
+    for (size_t t = 0; t < stats.triangles; ++t)
+    {
+        stats.transformedVertices += updateCache(&indices[t * 3], timestamps, timestamp, cacheSize);
+    }
+    for (const uint32_t time : timestamps)
+    {
+        stats.vertices += time != 0;
+    }
+    return stats;
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, const size_t vertexCount, const uint32_t cacheSize)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    std::vector<uint32_t> adjacencyOffset;
+    std::vector<uint32_t> adjacency;
+    buildAdjacency(indices, vertexCount, adjacencyOffset, adjacency);
+    std::vector<uint32_t> liveCount(vertexCount, 0); // triangles not emitted yet
+    for (size_t v = 0; v < vertexCount; ++v)
+    {
+        liveCount[v] = adjacencyOffset[v + 1] - adjacencyOffset[v];
+    }
+
+    std::vector<uint32_t> timestamps(vertexCount, 0);
+    uint32_t timestamp = cacheSize + 1;
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd; // recently used vertices, to continue from when fan has no candidates
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    deadEnd.reserve(triangleCount * 3);
+    result.reserve(triangleCount * 3);
+
+    uint32_t cursor = 0; // vertices before cursor have no live triangles
+    uint32_t fanning = indices[0];
+    while (fanning != kNoVertex)
+    {
+        // emit all remaining triangles around fanning vertex
+        candidates.clear();
+        for (uint32_t a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; ++a)
+        {
+            const uint32_t t = adjacency[a];
+            if (emitted[t])
+            {
+                continue;
+            }
+            emitted[t] = 1;
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const uint32_t v = indices[t * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --liveCount[v];
+                if (timestamp - timestamps[v] > cacheSize)
+                {
+                    timestamps[v] = timestamp++;
+                }
+            }
+        }
+
+        // next fan: oldest candidate which still stays in cache while its own triangles are emitted
+        uint32_t next = kNoVertex;
+        int64_t bestPriority = -1;
+        for (const uint32_t v : candidates)
+        {
+            if (liveCount[v] == 0)
+            {
+                continue;
+            }
+            const uint32_t age = timestamp - timestamps[v];
+            const int64_t priority = age + 2 * liveCount[v] <= cacheSize ? age : 0;
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+        // dead end: most recently used vertex with live triangles, then first unprocessed vertex
+        while (next == kNoVertex && !deadEnd.empty())
+        {
+            const uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveCount[v] > 0)
+            {
+                next = v;
+            }
+        }
+        for (; next == kNoVertex && cursor < vertexCount; ++cursor)
+        {
+            if (liveCount[cursor] > 0)
+            {
+                next = cursor;
+            }
+        }
+        fanning = next;
+    }
+    indices.swap(result);
+}
+
+void optimizeOverdraw(const std::vector<Scene::Vertex>& vertices, std::vector<uint32_t>& indices, const float threshold, const uint32_t cacheSize)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+    {
+        return;
+    }
+    std::vector<uint32_t> timestamps(vertices.size(), 0);
+    uint32_t timestamp = cacheSize + 1;
+
+    // hard boundaries: triangle missing all three vertices starts patch unrelated to previous triangles
+    std::vector<uint32_t> hardBoundaries;
+    for (uint32_t t = 0; t < triangleCount; ++t)
+    {
+        if (updateCache(&indices[t * 3], timestamps, timestamp, cacheSize) == 3 || t == 0)
+        {
+            hardBoundaries.push_back(t);
+        }
+    }
+    hardBoundaries.push_back((uint32_t)triangleCount);
+
+    // soft boundaries: cluster is cut once its miss ratio, with cache flushed at its start, is within threshold of whole patch
+    std::vector<uint32_t> clusters;
+    for (size_t h = 0; h + 1 < hardBoundaries.size(); ++h)
+    {
+        const uint32_t begin = hardBoundaries[h];
+        const uint32_t end = hardBoundaries[h + 1];
+
+        timestamp += cacheSize + 1;
+        size_t patchMisses = 0;
+        for (uint32_t t = begin; t < end; ++t)
+        {
+            patchMisses += updateCache(&indices[t * 3], timestamps, timestamp, cacheSize);
+        }
+        const float clusterThreshold = threshold * patchMisses / (end - begin);
+
+        clusters.push_back(begin);
+        timestamp += cacheSize + 1;
+        size_t misses = 0;
+        size_t count = 0;
+        for (uint32_t t = begin; t + 1 < end; ++t)
+        {
+            misses += updateCache(&indices[t * 3], timestamps, timestamp, cacheSize);
+            ++count;
+            if ((float)misses / count <= clusterThreshold)
+            {
+                clusters.push_back(t + 1);
+                timestamp += cacheSize + 1;
+                misses = 0;
+                count = 0;
+            }
+        }
+    }
+    clusters.push_back((uint32_t)triangleCount);
+
+    // area weighted centers and normals of clusters and center of whole mesh
+    const size_t clusterCount = clusters.size() - 1;
+    std::vector<glm::float3> clusterCenters(clusterCount, glm::float3(0.0f));
+    std::vector<glm::float3> clusterNormals(clusterCount, glm::float3(0.0f));
+    glm::float3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        float clusterArea = 0.0f;
+        for (uint32_t t = clusters[c]; t < clusters[c + 1]; ++t)
+        {
+            const glm::float3& p0 = vertices[indices[t * 3 + 0]].pos;
+            const glm::float3& p1 = vertices[indices[t * 3 + 1]].pos;
+            const glm::float3& p2 = vertices[indices[t * 3 + 2]].pos;
+            const glm::float3 normal = glm::cross(p1 - p0, p2 - p0); // length is twice triangle area
+            const float area = glm::length(normal);
+            clusterCenters[c] += (p0 + p1 + p2) * (area / 3.0f);
+            clusterNormals[c] += normal;
+            clusterArea += area;
+        }
+        meshCenter += clusterCenters[c];
+        meshArea += clusterArea;
+        clusterCenters[c] = clusterArea > 0.0f ? clusterCenters[c] / clusterArea : glm::float3(0.0f);
+    }
+    if (meshArea == 0.0f)
+    {
+        return;
+    }
+    meshCenter /= meshArea;
+
+    // clusters facing away from center occlude others from most view directions, they go first
+    std::vector<float> sortKeys(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        const float normalLength = glm::length(clusterNormals[c]);
+        if (normalLength > 0.0f)
+        {
+            sortKeys[c] = glm::dot(clusterCenters[c] - meshCenter, clusterNormals[c] / normalLength);
+        }
+    }
+    std::vector<uint32_t> order(clusterCount);
+    for (uint32_t c = 0; c < clusterCount; ++c)
+    {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&sortKeys](const uint32_t a, const uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const uint32_t c : order)
+    {
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + clusters[c + 1] * 3);
+    }
+    indices.swap(result);
+}
+
+// Bounding sphere around meshlet vertices and cone of its triangle normals
+static void computeMeshletBounds(const std::vector<Scene::Vertex>& vertices, const uint32_t* indices, const std::vector<uint32_t>& meshletVertices, Meshlet& meshlet)
+{
+    AABB box = AABB::empty();
+    for (const uint32_t v : meshletVertices)
+    {
+        box.expand(vertices[v].pos);
+    }
+    const glm::float3 center = box.center();
+    float radius = 0.0f;
+    for (const uint32_t v : meshletVertices)
+    {
+        radius = std::max(radius, glm::length(vertices[v].pos - center));
+    }
+    meshlet.mBoundingSphere = glm::float4(center, radius);
+
+    std::vector<glm::float3> normals;
+    normals.reserve(meshlet.mCount / 3);
+    glm::float3 axis(0.0f);
+    for (uint32_t i = 0; i < meshlet.mCount; i += 3)
+    {
+        const glm::float3& p0 = vertices[indices[i + 0]].pos;
+        const glm::float3& p1 = vertices[indices[i + 1]].pos;
+        const glm::float3& p2 = vertices[indices[i + 2]].pos;
+        const glm::float3 normal = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(normal);
+        if (length > 0.0f)
+        {
+            normals.push_back(normal / length);
+            axis += normals.back();
+        }
+    }
+    meshlet.mCone = glm::float4(0.0f, 0.0f, 0.0f, 1.0f);
+    const float axisLength = glm::length(axis);
+    if (normals.empty() || axisLength == 0.0f)
+    {
+        return;
+    }
+    axis /= axisLength;
+    float minDot = 1.0f;
+    for (const glm::float3& normal : normals)
+    {
+        minDot = std::min(minDot, glm::dot(axis, normal));
+    }
+    // cone half angle is acos(minDot), meshlet is backfacing inside cone of half angle 90 - acos(minDot) around axis.
+    // Nearly flat cones give almost no culling, they are disabled
+    const float kMinDot = 0.1f;
+    meshlet.mCone = glm::float4(axis, minDot <= kMinDot ? 1.0f : std::sqrt(1.0f - minDot * minDot));
+}
+
+void buildMeshlets(const std::vector<Scene::Vertex>& vertices,
+                   std::vector<uint32_t>& indices,
+                   std::vector<Meshlet>& meshlets,
+                   const uint32_t maxVertices,
+                   const uint32_t maxTriangles)
+{
+    meshlets.clear();
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+    {
+        return;
+    }
+    std::vector<uint32_t> adjacencyOffset;
+    std::vector<uint32_t> adjacency;
+    buildAdjacency(indices, vertices.size(), adjacencyOffset, adjacency);
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint32_t> vertexMeshlet(vertices.size(), kNoVertex); // last meshlet which vertex was added to
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> candidates; // triangles sharing vertex with current meshlet
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+
+    uint32_t cursor = 0;
+    while (true)
+    {
+        while (cursor < triangleCount && emitted[cursor])
+        {
+            ++cursor;
+        }
+        if (cursor == triangleCount)
+        {
+            break;
+        }
+
+        const uint32_t meshletIndex = (uint32_t)meshlets.size();
+        Meshlet meshlet{};
+        meshlet.mIndex = (uint32_t)result.size();
+        meshletVertices.clear();
+        candidates.clear();
+        glm::float3 positionSum(0.0f);
+        uint32_t triangle = cursor;
+        uint32_t meshletTriangles = 0;
+        while (triangle != kNoVertex)
+        {
+            emitted[triangle] = 1;
+            ++meshletTriangles;
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const uint32_t v = indices[triangle * 3 + k];
+                result.push_back(v);
+                if (vertexMeshlet[v] != meshletIndex)
+                {
+                    vertexMeshlet[v] = meshletIndex;
+                    meshletVertices.push_back(v);
+                    positionSum += vertices[v].pos;
+                    candidates.insert(candidates.end(), adjacency.begin() + adjacencyOffset[v], adjacency.begin() + adjacencyOffset[v + 1]);
+                }
+            }
+            if (meshletTriangles == maxTriangles)
+            {
+                break;
+            }
+
+            // adjacent triangle adding fewest vertices which still fits, closest to meshlet center keeps meshlet compact
+            const glm::float3 center = positionSum / (float)meshletVertices.size();
+            triangle = kNoVertex;
+            uint32_t bestNewVertices = 4;
+            float bestDistance = 0.0f;
+            for (size_t c = 0; c < candidates.size();)
+            {
+                const uint32_t t = candidates[c];
+                if (emitted[t])
+                {
+                    candidates[c] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                uint32_t newVertices = 0;
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    newVertices += vertexMeshlet[indices[t * 3 + k]] != meshletIndex;
+                }
+                if (newVertices <= bestNewVertices && meshletVertices.size() + newVertices <= maxVertices)
+                {
+                    const glm::float3 offset = vertices[indices[t * 3]].pos + vertices[indices[t * 3 + 1]].pos + vertices[indices[t * 3 + 2]].pos - 3.0f * center;
+                    const float distance = glm::dot(offset, offset);
+                    if (newVertices < bestNewVertices || distance < bestDistance)
+                    {
+                        bestNewVertices = newVertices;
+                        bestDistance = distance;
+                        triangle = t;
+                    }
+                }
+                ++c;
+            }
+        }
+        meshlet.mCount = (uint32_t)result.size() - meshlet.mIndex;
+        meshlet.mVertexCount = (uint32_t)meshletVertices.size();
+        computeMeshletBounds(vertices, result.data() + meshlet.mIndex, meshletVertices, meshlet);
+        meshlets.push_back(meshlet);
+    }
+    indices.swap(result);
+}
+
+void optimizeMeshletVertexCache(std::vector<uint32_t>& indices, const size_t vertexCount, const std::vector<Meshlet>& meshlets, const uint32_t cacheSize)
+{
+    // meshlet is optimized on own compact vertex range, so work does not grow with whole mesh vertex count
+    std::vector<uint32_t> localIndex(vertexCount, kNoVertex);
+    std::vector<uint32_t> meshletVertices;
+    std::vector<uint32_t> local;
+    for (const Meshlet& meshlet : meshlets)
+    {
+        uint32_t* range = indices.data() + meshlet.mIndex;
+        meshletVertices.clear();
+        local.resize(meshlet.mCount);
+        for (uint32_t i = 0; i < meshlet.mCount; ++i)
+        {
+            const uint32_t v = range[i];
+            if (localIndex[v] == kNoVertex)
+            {
+                localIndex[v] = (uint32_t)meshletVertices.size();
+                meshletVertices.push_back(v);
+            }
+            local[i] = localIndex[v];
+        }
+        optimizeVertexCache(local, meshletVertices.size(), cacheSize);
+        for (uint32_t i = 0; i < meshlet.mCount; ++i)
+        {
+            range[i] = meshletVertices[local[i]];
+        }
+        for (const uint32_t v : meshletVertices)
+        {
+            localIndex[v] = kNoVertex;
+        }
+    }
+}
+
+namespace
+{
+
+// Symmetric 4x4 matrix of summed squared distances to planes, error of point p is (p, 1) * Q * (p, 1)
+struct Quadric
+{
+    double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+    double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+    double a22 = 0.0, a23 = 0.0;
+    double a33 = 0.0;
+    double weight = 0.0; // summed area of triangle planes, error is normalized by it
+
+    void addPlane(const glm::float3& n, const float d, const double w)
+    {
+        a00 += w * n.x * n.x;
+        a01 += w * n.x * n.y;
+        a02 += w * n.x * n.z;
+        a03 += w * n.x * d;
+        a11 += w * n.y * n.y;
+        a12 += w * n.y * n.z;
+        a13 += w * n.y * d;
+        a22 += w * n.z * n.z;
+        a23 += w * n.z * d;
+        a33 += w * d * d;
+    }
+
+    Quadric& operator+=(const Quadric& q)
+    {
+        a00 += q.a00;
+        a01 += q.a01;
+        a02 += q.a02;
+        a03 += q.a03;
+        a11 += q.a11;
+        a12 += q.a12;
+        a13 += q.a13;
+        a22 += q.a22;
+        a23 += q.a23;
+        a33 += q.a33;
+        weight += q.weight;
+        return *this;
+    }
+
+    double error(const glm::float3& p) const
+    {
+        const double x = p.x, y = p.y, z = p.z;
+        const double e = x * (a00 * x + 2.0 * (a01 * y + a02 * z + a03)) +
+                         y * (a11 * y + 2.0 * (a12 * z + a13)) +
+                         z * (a22 * z + 2.0 * a23) + a33;
+        return std::max(e, 0.0);
+    }
+};
+
+enum class VertexKind : uint8_t
+{
+    eManifold, // interior vertex, may collapse into any neighbor
+    eBorder, // on open edge, may only slide along it
+    eLocked, // seam, corner or non-manifold vertex, never removed
+};
+
+struct Collapse
+{
+    double cost;
+    uint32_t source;
+    uint32_t target;
+};
+
+uint64_t edgeKey(const uint32_t a, const uint32_t b)
+{
+    return ((uint64_t)a << 32) | b;
+}
+
+} // namespace
+
+std::vector<uint32_t> simplifyMesh(const std::vector<Scene::Vertex>& vertices,
+                                   const std::vector<uint32_t>& indices,
+                                   const size_t targetIndexCount,
+                                   const float targetError,
+                                   float& resultError)
+{
+    resultError = 0.0f;
+    std::vector<uint32_t> result(indices.begin(), indices.begin() + indices.size() / 3 * 3);
+    const size_t vertexCount = vertices.size();
+    if (result.size() <= targetIndexCount)
+    {
+        return result;
+    }
+
+    // vertices sharing position differ by UV, normal or tangent: they form seam and are locked
+    std::vector<uint32_t> positionId(vertexCount);
+    std::vector<uint32_t> order(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; ++v)
+    {
+        order[v] = v;
+    }
+    auto lessPosition = [&vertices](const uint32_t a, const uint32_t b) {
+        const glm::float3& pa = vertices[a].pos;
+        const glm::float3& pb = vertices[b].pos;
+        return pa.x != pb.x ? pa.x < pb.x : (pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z);
+    };
+    std::sort(order.begin(), order.end(), lessPosition);
+    std::vector<uint8_t> seam(vertexCount, 0);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const bool same = i > 0 && !lessPosition(order[i - 1], order[i]);
+        positionId[order[i]] = same ? positionId[order[i - 1]] : order[i];
+        if (same)
+        {
+            seam[order[i]] = 1;
+            seam[order[i - 1]] = 1;
+        }
+    }
+
+    // plane quadrics weighted by triangle area, accumulated per position
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        const glm::float3& p0 = vertices[result[i + 0]].pos;
+        const glm::float3& p1 = vertices[result[i + 1]].pos;
+        const glm::float3& p2 = vertices[result[i + 2]].pos;
+        const glm::float3 normal = glm::cross(p1 - p0, p2 - p0);
+        const float length = glm::length(normal);
+        if (length == 0.0f)
+        {
+            continue;
+        }
+        const glm::float3 n = normal / length;
+        const double area = 0.5 * length;
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            Quadric& q = quadrics[positionId[result[i + k]]];
+            q.addPlane(n, -glm::dot(n, p0), area);
+            q.weight += area;
+        }
+    }
+
+    // border edges get plane through edge, perpendicular to triangle, so borders keep their shape
+    const float kBorderWeight = 10.0f;
+    std::vector<uint64_t> halfEdges;
+    auto findHalfEdges = [&]() {
+        halfEdges.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                halfEdges.push_back(edgeKey(positionId[result[i + k]], positionId[result[i + (k + 1) % 3]]));
+            }
+        }
+        std::sort(halfEdges.begin(), halfEdges.end());
+    };
+    auto hasHalfEdge = [&halfEdges](const uint32_t a, const uint32_t b) {
+        return std::binary_search(halfEdges.begin(), halfEdges.end(), edgeKey(a, b));
+    };
+    findHalfEdges();
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        const glm::float3& p0 = vertices[result[i + 0]].pos;
+        const glm::float3 normal = glm::cross(vertices[result[i + 1]].pos - p0, vertices[result[i + 2]].pos - p0);
+        for (uint32_t k = 0; k < 3; ++k)
+        {
+            const uint32_t a = positionId[result[i + k]];
+            const uint32_t b = positionId[result[i + (k + 1) % 3]];
+            if (hasHalfEdge(b, a))
+            {
+                continue;
+            }
+            const glm::float3 edge = vertices[b].pos - vertices[a].pos;
+            const glm::float3 perpendicular = glm::cross(edge, normal);
+            const float length = glm::length(perpendicular);
+            if (length == 0.0f)
+            {
+                continue;
+            }
+            const glm::float3 n = perpendicular / length;
+            const double edgeLength = glm::length(edge);
+            Quadric edgeQuadric;
+            edgeQuadric.addPlane(n, -glm::dot(n, vertices[a].pos), kBorderWeight * edgeLength * edgeLength);
+            quadrics[a] += edgeQuadric;
+            quadrics[b] += edgeQuadric;
+        }
+    }
+
+    const double maxCost = (double)targetError * targetError;
+    const float kMaxNormalTurn = 0.5f; // cosine of largest allowed rotation of triangle normal
+    std::vector<VertexKind> kinds(vertexCount);
+    std::vector<uint32_t> borderOut(vertexCount);
+    std::vector<uint32_t> borderIn(vertexCount);
+    std::vector<uint32_t> adjacencyOffset;
+    std::vector<uint32_t> adjacency;
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<uint8_t> touched(vertexCount);
+    while (result.size() > targetIndexCount)
+    {
+        // classify by current topology, collapses create new border edges
+        findHalfEdges();
+        std::fill(borderOut.begin(), borderOut.end(), 0);
+        std::fill(borderIn.begin(), borderIn.end(), 0);
+        std::vector<uint8_t> nonManifold(vertexCount, 0);
+        for (size_t e = 0; e < halfEdges.size(); ++e)
+        {
+            const uint32_t a = (uint32_t)(halfEdges[e] >> 32);
+            const uint32_t b = (uint32_t)halfEdges[e];
+            if (e > 0 && halfEdges[e - 1] == halfEdges[e])
+            {
+                nonManifold[a] = 1;
+                nonManifold[b] = 1;
+            }
+            else if (!hasHalfEdge(b, a))
+            {
+                ++borderOut[a];
+                ++borderIn[b];
+            }
+        }
+        for (uint32_t v = 0; v < vertexCount; ++v)
+        {
+            const uint32_t p = positionId[v];
+            if (seam[v] || nonManifold[p])
+            {
+                kinds[v] = VertexKind::eLocked;
+            }
+            else if (borderOut[p] == 0 && borderIn[p] == 0)
+            {
+                kinds[v] = VertexKind::eManifold;
+            }
+            else
+            {
+                kinds[v] = borderOut[p] == 1 && borderIn[p] == 1 ? VertexKind::eBorder : VertexKind::eLocked;
+            }
+        }
+
+        // collapse candidates: source moves to target position, target keeps its attributes
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            for (uint32_t k = 0; k < 3; ++k)
+            {
+                const uint32_t a = result[i + k];
+                const uint32_t b = result[i + (k + 1) % 3];
+                const uint32_t pa = positionId[a];
+                const uint32_t pb = positionId[b];
+                const bool borderEdge = !hasHalfEdge(pb, pa);
+                const uint32_t ends[2][2] = { { a, b }, { b, a } };
+                for (const auto& end : ends)
+                {
+                    const uint32_t source = end[0];
+                    const uint32_t target = end[1];
+                    const VertexKind kind = kinds[source];
+                    if (kind == VertexKind::eLocked || (kind == VertexKind::eBorder && !borderEdge))
+                    {
+                        continue;
+                    }
+                    Quadric q = quadrics[positionId[source]];
+                    q += quadrics[positionId[target]];
+                    collapses.push_back({ q.weight > 0.0 ? q.error(vertices[target].pos) / q.weight : 0.0, source, target });
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        // independent collapses in cost order, neighborhoods of applied ones are frozen until next pass
+        buildAdjacency(result, vertexCount, adjacencyOffset, adjacency);
+        for (uint32_t v = 0; v < vertexCount; ++v)
+        {
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+        const size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+        size_t removedTriangles = 0;
+        bool collapsed = false;
+        if (collapses.empty())
+        {
+            break;
+        }
+        // frozen neighborhoods must not push pass to expensive collapses, next pass has cheaper ones again.
+        // Collapse removes about two triangles and every edge is listed up to four times
+        const double kPassCostBound = 1.5;
+        const double passCost = kPassCostBound * collapses[std::min(collapses.size() - 1, trianglesToRemove * 2)].cost;
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.cost > maxCost || (collapse.cost > passCost && collapsed) || removedTriangles >= trianglesToRemove)
+            {
+                break;
+            }
+            const uint32_t source = collapse.source;
+            const uint32_t target = collapse.target;
+            if (touched[source] || touched[target])
+            {
+                continue;
+            }
+            // remaining triangles around source must not flip or turn sharply, e.g. into vertical slivers along border
+            const glm::float3& moved = vertices[target].pos;
+            bool flips = false;
+            size_t removed = 0;
+            for (uint32_t a = adjacencyOffset[source]; a < adjacencyOffset[source + 1] && !flips; ++a)
+            {
+                const uint32_t* triangle = &result[adjacency[a] * 3];
+                if (triangle[0] == target || triangle[1] == target || triangle[2] == target)
+                {
+                    ++removed;
+                    continue;
+                }
+                glm::float3 before[3];
+                glm::float3 after[3];
+                for (uint32_t k = 0; k < 3; ++k)
+                {
+                    before[k] = vertices[triangle[k]].pos;
+                    after[k] = triangle[k] == source ? moved : before[k];
+                }
+                const glm::float3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                const glm::float3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(normalBefore, normalAfter) <= kMaxNormalTurn * glm::length(normalBefore) * glm::length(normalAfter);
+            }
+            if (flips)
+            {
+                continue;
+            }
+            for (uint32_t a = adjacencyOffset[source]; a < adjacencyOffset[source + 1]; ++a)
+            {
+                const uint32_t* triangle = &result[adjacency[a] * 3];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+            }
+            remap[source] = target;
+            quadrics[positionId[target]] += quadrics[positionId[source]];
+            resultError = std::max(resultError, (float)std::sqrt(collapse.cost));
+            removedTriangles += std::max<size_t>(removed, 1);
+            collapsed = true;
+        }
+        if (!collapsed)
+        {
+            break;
+        }
+
+        // drop triangles which lost area, also ones reduced to two corners of same position
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            const uint32_t a = remap[result[i + 0]];
+            const uint32_t b = remap[result[i + 1]];
+            const uint32_t c = remap[result[i + 2]];
+            if (positionId[a] != positionId[b] && positionId[b] != positionId[c] && positionId[a] != positionId[c])
+            {
+                result[write++] = a;
+                result[write++] = b;
+                result[write++] = c;
+            }
+        }
+        result.resize(write);
+    }
+    return result;
+}
+
+std::vector<Scene::LodGeometry> buildLodChain(const std::vector<Scene::Vertex>& vertices, const std::vector<uint32_t>& indices, const float maxError)
+{
+    std::vector<Scene::LodGeometry> lods;
+    size_t indexCount = indices.size();
+    while (lods.size() < kMaxMeshLods)
+    {
+        const size_t target = indexCount / 6 * 3;
+        if (target < 3 * kMinLodTriangles)
+        {
+            break;
+        }
+        Scene::LodGeometry lod;
+        lod.indices = simplifyMesh(vertices, indices, target, maxError, lod.error);
+        // not worth own draw range when simplification stalls on locked vertices
+        if (lod.indices.empty() || lod.indices.size() * 4 > indexCount * 3)
+        {
+            break;
+        }
+        indexCount = lod.indices.size();
+        lods.push_back(std::move(lod));
+    }
+    return lods;
+}
+
+size_t optimizeVertexFetch(std::vector<Scene::Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+    std::vector<uint32_t> remap(vertices.size(), kNoVertex);
+    std::vector<Scene::Vertex> result;
+    result.reserve(vertices.size());
+    for (uint32_t& index : indices)
+    {
+        if (remap[index] == kNoVertex)
+        {
+            remap[index] = (uint32_t)result.size();
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+    return vertices.size();
+}
+
+} // namespace nevk
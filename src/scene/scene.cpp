@@ -1,73 +1,355 @@
 #include "scene.h"
 
-#include <glm/gtx/norm.hpp>
+#include "simd.h"
 
 #include <algorithm>
+#include <cstring>
 #include <utility>
 
 namespace nevk
 {
 
-uint32_t Scene::createMesh(const std::vector<Vertex>& vb, const std::vector<uint32_t>& ib)
+// 64-bit hash of raw bytes, 8 bytes per step
+static uint64_t hashBytes(const void* data, const size_t size, uint64_t hash)
+{
+    constexpr uint64_t kMul = 0x9E3779B97F4A7C15ull;
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = (hash ^ word) * kMul;
+        hash ^= hash >> 29;
+    }
+    for (; i < size; ++i)
+    {
+        hash = (hash ^ bytes[i]) * kMul;
+    }
+    return hash ^ (hash >> 32);
+}
+
+// dst[i] = src[i] + offset
+static void rebaseIndices(const uint32_t* src, uint32_t* dst, const size_t count, const uint32_t offset)
+{
+    size_t i = 0;
+#if defined(NEVK_SSE)
+    const __m128i offset4 = _mm_set1_epi32((int)offset);
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128i idx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(idx, offset4));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+        dst[i] = src[i] + offset;
+    }
+}
+
+uint32_t Scene::allocateMesh()
 {
-    Mesh* mesh = nullptr;
     uint32_t meshId = -1;
     if (mDelMesh.empty())
     {
         meshId = mMeshes.size(); // add mesh to storage
         mMeshes.push_back({});
-        mesh = &mMeshes.back();
+        mMeshGenerations.push_back(0);
+        mMeshHashes.push_back(0);
+        mMeshInstanceCounts.push_back(0);
     }
     else
     {
         meshId = mDelMesh.top(); // get index from stack
         mDelMesh.pop(); // del taken index from stack
-        mesh = &mMeshes[meshId];
     }
+    return meshId;
+}
+
+void Scene::setMappedGeometry(std::shared_ptr<const void> owner, const MeshView& geometry)
+{
+    mVertices.clear();
+    mIndices.clear();
+    mMappedGeometryOwner = std::move(owner);
+    mMappedGeometry = geometry;
+}
+
+void Scene::materializeGeometry()
+{
+    if (!mMappedGeometryOwner)
+    {
+        return;
+    }
+    mVertices.assign(mMappedGeometry.vertices, mMappedGeometry.vertices + mMappedGeometry.vertexCount);
+    mIndices.assign(mMappedGeometry.indices, mMappedGeometry.indices + mMappedGeometry.indexCount);
+    mMappedGeometry = MeshView{};
+    mMappedGeometryOwner.reset();
+}
+
+// mesh record for geometry placed at the end of vertex and index storage
+void Scene::initMeshRange(const uint32_t meshIndex, const MeshView& view)
+{
+    Mesh& mesh = mMeshes[meshIndex];
+    mesh.mIndex = mIndices.size(); // Index of 1st index in index buffer
+    mesh.mCount = view.indexCount; // amount of indices in mesh
+    mesh.mVertexOffset = mVertices.size();
+    mesh.mVertexCount = view.vertexCount;
+    mesh.mBounds = AABB{};
+    mesh.mMeshletOffset = (uint32_t)mMeshlets.size();
+    mesh.mMeshletCount = 0;
+    mesh.mLodCount = 0;
+    if (view.vertexCount > 0)
+    {
+        mesh.mBounds = AABB::empty();
+        for (size_t i = 0; i < view.vertexCount; ++i)
+        {
+            mesh.mBounds.expand(view.vertices[i].pos);
+        }
+    }
+}
+
+void Scene::appendGeometry(const uint32_t meshIndex, const MeshView& view)
+{
+    materializeGeometry();
+    initMeshRange(meshIndex, view);
+    const Mesh& mesh = mMeshes[meshIndex];
+
+    // adjust indices for global index buffer
+    mIndices.resize(mesh.mIndex + view.indexCount);
+    rebaseIndices(view.indices, mIndices.data() + mesh.mIndex, view.indexCount, mesh.mVertexOffset);
+    mVertices.insert(mVertices.end(), view.vertices, view.vertices + view.vertexCount); // copy vertices
+}
+
+uint32_t Scene::createMesh(const std::vector<Vertex>& vb, const std::vector<uint32_t>& ib)
+{
+    return createMesh(MeshView{ vb.data(), vb.size(), ib.data(), ib.size() });
+}
+
+uint32_t Scene::createMesh(const MeshView& mesh)
+{
+    const uint32_t meshId = allocateMesh();
+    appendGeometry(meshId, mesh);
+    return makeHandle(meshId, mMeshGenerations[meshId]);
+}
+
+uint32_t Scene::createMesh(std::vector<Vertex>&& vb, std::vector<uint32_t>&& ib)
+{
+    // reserved storage is kept, appending into it does not reallocate later
+    if (mMappedGeometryOwner || !mVertices.empty() || !mIndices.empty() ||
+        mVertices.capacity() > vb.capacity() || mIndices.capacity() > ib.capacity())
+    {
+        const uint32_t meshId = createMesh(MeshView{ vb.data(), vb.size(), ib.data(), ib.size() });
+        // storage holds copy now, caller gave buffers away so their memory is freed before next mesh
+        std::vector<Vertex>().swap(vb);
+        std::vector<uint32_t>().swap(ib);
+        return meshId;
+    }
+    // first mesh: geometry is already in place, indices need no rebase
+    const uint32_t meshId = allocateMesh();
+    initMeshRange(meshId, MeshView{ vb.data(), vb.size(), ib.data(), ib.size() });
+    mVertices = std::move(vb);
+    mIndices = std::move(ib);
+    return makeHandle(meshId, mMeshGenerations[meshId]);
+}
+
+std::vector<uint32_t> Scene::createMeshes(const std::vector<MeshView>& meshes)
+{
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    for (const MeshView& mesh : meshes)
+    {
+        vertexCount += mesh.vertexCount;
+        indexCount += mesh.indexCount;
+    }
+    reserveGeometry(vertexCount, indexCount);
+
+    std::vector<uint32_t> res;
+    res.reserve(meshes.size());
+    for (const MeshView& mesh : meshes)
+    {
+        res.push_back(createMesh(mesh));
+    }
+    return res;
+}
+
+void Scene::reserveGeometry(const size_t vertexCount, const size_t indexCount)
+{
+    materializeGeometry();
+    mVertices.reserve(mVertices.size() + vertexCount);
+    mIndices.reserve(mIndices.size() + indexCount);
+}
+
+bool Scene::isMeshEqual(const uint32_t meshIndex, const MeshView& view) const
+{
+    const Mesh& mesh = mMeshes[meshIndex];
+    if (mesh.mVertexCount != view.vertexCount || mesh.mCount != view.indexCount)
+    {
+        return false;
+    }
+    if (view.vertexCount > 0 && memcmp(getVertexData() + mesh.mVertexOffset, view.vertices, view.vertexCount * sizeof(Vertex)) != 0)
+    {
+        return false;
+    }
+    const uint32_t* indices = getIndexData() + mesh.mIndex;
+    for (size_t i = 0; i < view.indexCount; ++i)
+    {
+        if (indices[i] - mesh.mVertexOffset != view.indices[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-    mesh->mIndex = mIndices.size(); // Index of 1st index in index buffer
-    mesh->mCount = ib.size(); // amount of indices in mesh
+uint64_t Scene::hashMesh(const MeshView& mesh) const
+{
+    uint64_t hash = hashBytes(mesh.vertices, mesh.vertexCount * sizeof(Vertex), mesh.vertexCount);
+    hash = hashBytes(mesh.indices, mesh.indexCount * sizeof(uint32_t), hash);
+    return hash ? hash : 1; // 0 marks uncached slot
+}
+
+uint32_t Scene::findMesh(const uint64_t hash, const MeshView& mesh) const
+{
+    const auto range = mMeshCache.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (isMeshValid(it->second) && isMeshEqual(handleIndex(it->second), mesh))
+        {
+            return it->second;
+        }
+    }
+    return kInvalidId;
+}
+
+void Scene::addToMeshCache(const uint64_t hash, const uint32_t meshId)
+{
+    mMeshCache.emplace(hash, meshId);
+    mMeshHashes[handleIndex(meshId)] = hash;
+}
+
+uint32_t Scene::getOrCreateMesh(const std::vector<Vertex>& vb, const std::vector<uint32_t>& ib)
+{
+    const MeshView view{ vb.data(), vb.size(), ib.data(), ib.size() };
+    const uint64_t hash = hashMesh(view);
+    uint32_t meshId = findMesh(hash, view);
+    if (meshId == kInvalidId)
+    {
+        meshId = createMesh(view);
+        addToMeshCache(hash, meshId);
+    }
+    return meshId;
+}
 
-    const uint32_t ibOffset = mVertices.size(); // adjust indices for global index buffer
-    for (int i = 0; i < ib.size(); ++i)
+uint32_t Scene::getOrCreateMesh(std::vector<Vertex>&& vb, std::vector<uint32_t>&& ib)
+{
+    const MeshView view{ vb.data(), vb.size(), ib.data(), ib.size() };
+    const uint64_t hash = hashMesh(view);
+    uint32_t meshId = findMesh(hash, view);
+    if (meshId == kInvalidId)
     {
-        mIndices.push_back(ibOffset + ib[i]);
+        meshId = createMesh(std::move(vb), std::move(ib));
+        addToMeshCache(hash, meshId);
     }
-    mVertices.insert(mVertices.end(), vb.begin(), vb.end()); // copy vertices
     return meshId;
 }
 
+bool Scene::setMeshlets(const uint32_t meshId, const std::vector<Meshlet>& meshlets)
+{
+    if (!isMeshValid(meshId))
+    {
+        return false;
+    }
+    Mesh& mesh = mMeshes[handleIndex(meshId)];
+    for (const Meshlet& meshlet : meshlets)
+    {
+        if ((uint64_t)meshlet.mIndex + meshlet.mCount > mesh.mCount)
+        {
+            return false;
+        }
+    }
+    mDeadMeshletCount += mesh.mMeshletCount;
+    mesh.mMeshletOffset = (uint32_t)mMeshlets.size();
+    mesh.mMeshletCount = (uint32_t)meshlets.size();
+    mMeshlets.insert(mMeshlets.end(), meshlets.begin(), meshlets.end());
+    return true;
+}
+
+bool Scene::setMeshLods(const uint32_t meshId, const std::vector<LodGeometry>& lods)
+{
+    if (!isMeshValid(meshId) || lods.size() > kMaxMeshLods)
+    {
+        return false;
+    }
+    Mesh& mesh = mMeshes[handleIndex(meshId)];
+    for (const LodGeometry& lod : lods)
+    {
+        for (const uint32_t index : lod.indices)
+        {
+            if (index >= mesh.mVertexCount)
+            {
+                return false;
+            }
+        }
+    }
+    materializeGeometry();
+    for (uint32_t i = 0; i < mesh.mLodCount; ++i)
+    {
+        mDeadIndexCount += mesh.mLods[i].mCount;
+    }
+    mesh.mLodCount = (uint32_t)lods.size();
+    for (uint32_t i = 0; i < mesh.mLodCount; ++i)
+    {
+        MeshLod& meshLod = mesh.mLods[i];
+        meshLod.mIndex = (uint32_t)mIndices.size();
+        meshLod.mCount = (uint32_t)lods[i].indices.size();
+        meshLod.mError = lods[i].error;
+        mIndices.resize(meshLod.mIndex + meshLod.mCount);
+        rebaseIndices(lods[i].indices.data(), mIndices.data() + meshLod.mIndex, meshLod.mCount, mesh.mVertexOffset);
+    }
+    return true;
+}
+
 uint32_t Scene::createInstance(const uint32_t meshId, const uint32_t materialId, const glm::mat4& transform, const glm::float3& massCenter)
 {
-    Instance* inst = nullptr;
+    if (!isMeshValid(meshId) || !isMaterialValid(materialId))
+    {
+        return kInvalidId;
+    }
+    const uint32_t meshIndex = handleIndex(meshId);
+    const uint32_t materialIndex = handleIndex(materialId);
+
     uint32_t instId = -1;
     if (mDelInstances.empty())
     {
         instId = mInstances.size(); // add instance to storage
-        mInstances.push_back({});
-        inst = &mInstances.back();
+        mInstances.resize(instId + 1);
+        mInstanceGenerations.push_back(0);
+        mInstanceBounds.resize(instId + 1);
+        mRenderListPos.resize(instId + 1);
     }
     else
     {
         instId = mDelInstances.top(); // get index from stack
         mDelInstances.pop(); // del taken index from stack
-        inst = &mInstances[instId];
     }
-    inst->mMaterialId = materialId;
-    inst->mMeshId = meshId;
-    inst->transform = transform;
-    inst->massCenter = massCenter;
+    Instance inst;
+    inst.mMaterialId = materialIndex;
+    inst.mMeshId = meshIndex;
+    inst.transform = transform;
+    inst.massCenter = massCenter;
+    const bool isTransparent = mMaterials[materialIndex].isTransparent();
+    mInstances.set(instId, inst, isTransparent ? InstanceStorage::eTransparent : InstanceStorage::eNone);
+    ++mMeshInstanceCounts[meshIndex];
+    ++mMaterialInstanceCounts[materialIndex];
 
-    if (mMaterials[materialId].isTransparent())
-    {
-        mTransparentInstances.push_back(instId);
-    }
-    else
-    {
-        mOpaqueInstances.push_back(instId);
-    }
+    mInstanceBounds[instId] = mMeshes[meshIndex].mBounds.transform(transform);
+    mNeedBvhRebuild = true;
 
-    return instId;
+    std::vector<uint32_t>& renderList = isTransparent ? mTransparentInstances : mOpaqueInstances;
+    mRenderListPos[instId] = renderList.size();
+    renderList.push_back(instId);
+
+    return makeHandle(instId, mInstanceGenerations[instId]);
 }
 
 
@@ -91,6 +373,8 @@ uint32_t Scene::createMaterial(const glm::float4& ambient,
     {
         materialId = mMaterials.size(); // add material to storage
         mMaterials.push_back({});
+        mMaterialGenerations.push_back(0);
+        mMaterialInstanceCounts.push_back(0);
         material = &mMaterials.back();
     }
     else
@@ -113,7 +397,7 @@ uint32_t Scene::createMaterial(const glm::float4& ambient,
     material->texNormalId = texNormalId;
     material->d = d;
 
-    return materialId;
+    return makeHandle(materialId, mMaterialGenerations[materialId]);
 }
 
 uint32_t Scene::addMaterial(const Material& material)
@@ -121,47 +405,343 @@ uint32_t Scene::addMaterial(const Material& material)
     // TODO: fix here
     uint32_t res = mMaterials.size();
     mMaterials.push_back(material);
+    mMaterialGenerations.push_back(0);
+    mMaterialInstanceCounts.push_back(0);
     return res;
 }
 
-void Scene::removeInstance(const uint32_t instId)
+bool Scene::removeInstance(const uint32_t instId)
+{
+    if (!isInstanceValid(instId))
+    {
+        return false;
+    }
+    const uint32_t index = handleIndex(instId);
+    const uint8_t flags = mInstances.getFlags(index);
+
+    // swap with last element of render list
+    std::vector<uint32_t>& renderList = (flags & InstanceStorage::eTransparent) ? mTransparentInstances : mOpaqueInstances;
+    const uint32_t pos = mRenderListPos[index];
+    const uint32_t last = renderList.back();
+    renderList[pos] = last;
+    mRenderListPos[last] = pos;
+    renderList.pop_back();
+
+    mInstances.setFlags(index, flags | InstanceStorage::eRemoved);
+    --mMeshInstanceCounts[mInstances.getMeshId(index)];
+    --mMaterialInstanceCounts[mInstances.getMaterialId(index)];
+    mDirtyInstances.erase(index);
+    mNeedBvhRebuild = true;
+    if (bumpGeneration(mInstanceGenerations, index))
+    {
+        mDelInstances.push(index); // marked as removed
+    }
+    return true;
+}
+
+bool Scene::removeMesh(const uint32_t meshId)
+{
+    if (!isMeshValid(meshId))
+    {
+        return false;
+    }
+    const uint32_t index = handleIndex(meshId);
+    // instances keep slot index, they would draw mesh which reuses the slot
+    if (mMeshInstanceCounts[index] > 0)
+    {
+        return false;
+    }
+    if (mMeshHashes[index])
+    {
+        const auto range = mMeshCache.equal_range(mMeshHashes[index]);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == meshId)
+            {
+                mMeshCache.erase(it);
+                break;
+            }
+        }
+        mMeshHashes[index] = 0;
+    }
+    Mesh& mesh = mMeshes[index];
+    mDeadVertexCount += mesh.mVertexCount;
+    mDeadIndexCount += mesh.mCount;
+    mDeadMeshletCount += mesh.mMeshletCount;
+    for (uint32_t i = 0; i < mesh.mLodCount; ++i)
+    {
+        mDeadIndexCount += mesh.mLods[i].mCount;
+    }
+    // empty slot draws nothing until reused
+    mesh.mCount = 0;
+    mesh.mVertexCount = 0;
+    mesh.mMeshletCount = 0;
+    mesh.mLodCount = 0;
+    mesh.mBounds = AABB{};
+
+    if (bumpGeneration(mMeshGenerations, index))
+    {
+        mDelMesh.push(index); // marked as removed
+    }
+    return true;
+}
+
+bool Scene::removeMaterial(const uint32_t materialId)
+{
+    if (!isMaterialValid(materialId))
+    {
+        return false;
+    }
+    const uint32_t index = handleIndex(materialId);
+    // instances keep slot index and render list chosen by this material, reused slot would change both
+    if (mMaterialInstanceCounts[index] > 0)
+    {
+        return false;
+    }
+    if (bumpGeneration(mMaterialGenerations, index))
+    {
+        mDelMaterial.push(index); // marked as removed
+    }
+    return true;
+}
+
+bool Scene::needsCompaction() const
+{
+    return (mDeadVertexCount > 0 && mDeadVertexCount * 2 > getVertexCount()) ||
+           (mDeadIndexCount > 0 && mDeadIndexCount * 2 > getIndexCount()) ||
+           (mDeadMeshletCount > 0 && mDeadMeshletCount * 2 > mMeshlets.size());
+}
+
+void Scene::compactGeometry()
+{
+    if (mDeadVertexCount == 0 && mDeadIndexCount == 0 && mDeadMeshletCount == 0)
+    {
+        return;
+    }
+
+    // reads mapped geometry directly, so it is copied only once
+    const Vertex* srcVertices = getVertexData();
+    const uint32_t* srcIndices = getIndexData();
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<Meshlet> meshlets;
+    vertices.reserve(getVertexCount() - mDeadVertexCount);
+    indices.reserve(getIndexCount() - mDeadIndexCount);
+    meshlets.reserve(mMeshlets.size() - mDeadMeshletCount);
+    for (Mesh& mesh : mMeshes)
+    {
+        // meshlet ranges are relative to mesh, they are only moved
+        const uint32_t meshletOffset = (uint32_t)meshlets.size();
+        meshlets.insert(meshlets.end(), mMeshlets.begin() + mesh.mMeshletOffset, mMeshlets.begin() + mesh.mMeshletOffset + mesh.mMeshletCount);
+        mesh.mMeshletOffset = meshletOffset;
+
+        const uint32_t vertexOffset = vertices.size();
+        vertices.insert(vertices.end(), srcVertices + mesh.mVertexOffset, srcVertices + mesh.mVertexOffset + mesh.mVertexCount);
+        // levels follow full detail range, rebased to new vertex range
+        auto moveRange = [&](uint32_t& index, const uint32_t count) {
+            const uint32_t indexOffset = indices.size();
+            for (uint32_t i = index; i < index + count; ++i)
+            {
+                indices.push_back(srcIndices[i] - mesh.mVertexOffset + vertexOffset);
+            }
+            index = indexOffset;
+        };
+        moveRange(mesh.mIndex, mesh.mCount);
+        for (uint32_t i = 0; i < mesh.mLodCount; ++i)
+        {
+            moveRange(mesh.mLods[i].mIndex, mesh.mLods[i].mCount);
+        }
+        mesh.mVertexOffset = vertexOffset;
+    }
+    mVertices.swap(vertices);
+    mIndices.swap(indices);
+    mMeshlets.swap(meshlets);
+    mMappedGeometry = MeshView{};
+    mMappedGeometryOwner.reset();
+    mDeadVertexCount = 0;
+    mDeadIndexCount = 0;
+    mDeadMeshletCount = 0;
+}
+
+void Scene::updateBvh()
+{
+    if (!mNeedBvhRebuild && !mBvhRefitInstances.empty())
+    {
+        mOpaqueBvh.refit(mBvhRefitInstances, mInstanceBounds);
+        mTransparentBvh.refit(mBvhRefitInstances, mInstanceBounds);
+        mNeedBvhRebuild = mOpaqueBvh.needsRebuild() || mTransparentBvh.needsRebuild();
+    }
+    mBvhRefitInstances.clear();
+
+    if (mNeedBvhRebuild)
+    {
+        mOpaqueBvh.build(mOpaqueInstances, mInstanceBounds);
+        mTransparentBvh.build(mTransparentInstances, mInstanceBounds);
+        mNeedBvhRebuild = false;
+    }
+}
+
+void Scene::collectInstances(const Bvh& bvh, const std::vector<uint32_t>& instances, const Frustum& frustum, std::vector<uint32_t>& result) const
 {
-    mDelInstances.push(instId); // marked as removed
+    result.clear();
+    if (frustumCulling)
+    {
+        bvh.cull(frustum, mInstanceBounds, result);
+    }
+    else
+    {
+        result = instances;
+    }
 }
 
-void Scene::removeMesh(const uint32_t meshId)
+std::vector<uint32_t>& Scene::getOpaqueInstancesToRender(const glm::float3& camPos, const glm::float4x4& viewToClip)
 {
-    mDelMesh.push(meshId); // marked as removed
+    if (frustumCulling)
+    {
+        updateBvh();
+    }
+    collectInstances(mOpaqueBvh, mOpaqueInstances, Frustum(viewToClip), mVisibleOpaqueInstances);
+
+    mInstanceDistances.resize(mInstances.size());
+    mInstances.computeDistances2(camPos, mInstanceDistances.data());
+    mOpaqueSorter.sort(mVisibleOpaqueInstances, mInstances, mInstanceDistances.data(), camPos,
+              stateSorting ? InstanceSorter::Mode::eState : InstanceSorter::Mode::eFrontToBack);
+
+    return mVisibleOpaqueInstances;
 }
 
-void Scene::removeMaterial(const uint32_t materialId)
+std::vector<uint32_t>& Scene::getTransparentInstancesToRender(const glm::float3& camPos, const glm::float4x4& viewToClip)
 {
-    mDelMaterial.push(materialId); // marked as removed
+    if (frustumCulling)
+    {
+        updateBvh();
+    }
+    collectInstances(mTransparentBvh, mTransparentInstances, Frustum(viewToClip), mVisibleTransparentInstances);
+
+    mInstanceDistances.resize(mInstances.size());
+    mInstances.computeDistances2(camPos, mInstanceDistances.data());
+    mTransparentSorter.sort(mVisibleTransparentInstances, mInstances, mInstanceDistances.data(), camPos,
+              InstanceSorter::Mode::eBackToFront);
+
+    return mVisibleTransparentInstances;
 }
 
-std::vector<uint32_t>& Scene::getOpaqueInstancesToRender(const glm::float3& camPos)
+const std::vector<Scene::VisibleInstances>& Scene::computeVisibility(const std::vector<View>& views)
 {
-    sort(mOpaqueInstances.begin(), mOpaqueInstances.end(),
-         [&camPos, this](const uint32_t& instId1, const uint32_t& instId2) {
-             return glm::distance2(camPos, getInstances()[instId1].massCenter) <
-                    glm::distance2(camPos, getInstances()[instId2].massCenter);
-         });
+    // BVH is shared by all views, it is brought up to date before tasks start and only read by them
+    if (frustumCulling)
+    {
+        updateBvh();
+    }
+    if (mViewStates.size() < views.size())
+    {
+        mViewStates.resize(views.size());
+    }
+    mVisibility.resize(views.size());
 
-    return mOpaqueInstances;
+    const InstanceSorter::Mode opaqueMode = stateSorting ? InstanceSorter::Mode::eState : InstanceSorter::Mode::eFrontToBack;
+    auto processViews = [&](const uint32_t begin, const uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const View& view = views[i];
+            ViewState& state = mViewStates[i];
+            VisibleInstances& visible = mVisibility[i];
+            const Frustum frustum(view.viewToClip);
+            collectInstances(mOpaqueBvh, mOpaqueInstances, frustum, visible.opaque);
+            collectInstances(mTransparentBvh, mTransparentInstances, frustum, visible.transparent);
+
+            state.distances.resize(mInstances.size());
+            mInstances.computeDistances2(view.position, state.distances.data());
+            state.opaqueSorter.sort(visible.opaque, mInstances, state.distances.data(), view.position, opaqueMode);
+            state.transparentSorter.sort(visible.transparent, mInstances, state.distances.data(), view.position,
+                                         InstanceSorter::Mode::eBackToFront);
+        }
+    };
+    if (mThreadPool)
+    {
+        mThreadPool->parallelFor((uint32_t)views.size(), 1, processViews);
+    }
+    else
+    {
+        processViews(0, (uint32_t)views.size());
+    }
+    return mVisibility;
 }
 
-std::vector<uint32_t>& Scene::getTransparentInstancesToRender(const glm::float3& camPos)
+void Scene::getVisibleMeshlets(const uint32_t instId, const View& view, std::vector<uint32_t>& result) const
 {
-    sort(mTransparentInstances.begin(), mTransparentInstances.end(),
-         [&camPos, this](const uint32_t& instId1, const uint32_t& instId2) {
-             return glm::distance2(camPos, getInstances()[instId1].massCenter) >
-                    glm::distance2(camPos, getInstances()[instId2].massCenter);
-         });
+    result.clear();
+    if (!isInstanceValid(instId))
+    {
+        return;
+    }
+    const uint32_t index = handleIndex(instId);
+    const Mesh& mesh = mMeshes[mInstances.getMeshId(index)];
+    const glm::float4x4& transform = mInstances.getTransform(index);
+    const glm::float3x3 rotationScale(transform);
+    const float scale = std::max(glm::length(rotationScale[0]), std::max(glm::length(rotationScale[1]), glm::length(rotationScale[2])));
+    // mirroring flips triangle winding, cones are not valid then. Non-uniform scale or shear turns normals
+    // differently than positions and changes angles between them, so cutoff would not hold either
+    const float scale2 = scale * scale;
+    bool coneCulling = glm::determinant(rotationScale) > 0.0f;
+    for (int c = 0; c < 3; ++c)
+    {
+        // columns are orthogonal and of equal length
+        for (int r = c; r < 3; ++r)
+        {
+            const float dot = glm::dot(rotationScale[c], rotationScale[r]);
+            coneCulling &= std::fabs(dot - (c == r ? scale2 : 0.0f)) <= 1e-4f * scale2;
+        }
+    }
+    const Frustum frustum(view.viewToClip);
+    for (uint32_t i = mesh.mMeshletOffset; i < mesh.mMeshletOffset + mesh.mMeshletCount; ++i)
+    {
+        const Meshlet& meshlet = mMeshlets[i];
+        const glm::float3 center = glm::float3(transform * glm::float4(glm::float3(meshlet.mBoundingSphere), 1.0f));
+        const float radius = meshlet.mBoundingSphere.w * scale;
+        const AABB bounds{ center - glm::float3(radius), center + glm::float3(radius) };
+        if (frustum.test(bounds) == Frustum::Result::eOutside)
+        {
+            continue;
+        }
+        if (coneCulling && meshlet.mCone.w < 1.0f)
+        {
+            // rotation with uniform scale, it transforms normals same as positions
+            const glm::float3 axis = glm::normalize(rotationScale * glm::float3(meshlet.mCone));
+            const glm::float3 toCenter = center - view.position;
+            if (glm::dot(toCenter, axis) >= meshlet.mCone.w * glm::length(toCenter) + radius)
+            {
+                continue;
+            }
+        }
+        result.push_back(i);
+    }
+}
 
-    return mTransparentInstances;
+uint32_t Scene::selectLod(const uint32_t instanceIndex, const glm::float3& eye, const float pixelScale, const float maxPixelError) const
+{
+    const Mesh& mesh = mMeshes[mInstances.getMeshId(instanceIndex)];
+    if (mesh.mLodCount == 0 || maxPixelError <= 0.0f)
+    {
+        return 0;
+    }
+    // nearest point of world bounds, eye inside bounds gets full detail
+    const AABB& bounds = mInstanceBounds[instanceIndex];
+    const glm::float3 nearest = glm::clamp(eye, bounds.minimum, bounds.maximum);
+    const float distance = glm::length(nearest - eye);
+    const glm::float3x3 rotationScale(mInstances.getTransform(instanceIndex));
+    const float scale = std::max(glm::length(rotationScale[0]), std::max(glm::length(rotationScale[1]), glm::length(rotationScale[2])));
+    // level error e is visible as e * scale * pixelScale / distance pixels
+    const float maxError = maxPixelError * distance / (scale * pixelScale);
+    uint32_t lod = 0;
+    while (lod < mesh.mLodCount && mesh.mLods[lod].mError <= maxError)
+    {
+        ++lod;
+    }
+    return lod;
 }
 
-std::set<uint32_t> Scene::getDirtyInstances()
+const std::set<uint32_t>& Scene::getDirtyInstances() const
 {
     return this->mDirtyInstances;
 }
@@ -171,11 +751,51 @@ bool Scene::getFrMod()
     return this->FrMod;
 }
 
-void Scene::updateInstanceTransform(uint32_t instId, glm::float4x4 newTransform)
+bool Scene::updateInstanceTransform(uint32_t instId, glm::float4x4 newTransform)
+{
+    if (!isInstanceValid(instId))
+    {
+        return false;
+    }
+    const uint32_t index = handleIndex(instId);
+    mInstances.setTransform(index, newTransform);
+    mInstanceBounds[index] = mMeshes[mInstances.getMeshId(index)].mBounds.transform(newTransform);
+    mBvhRefitInstances.push_back(index);
+    mDirtyInstances.insert(index);
+    return true;
+}
+
+uint32_t Scene::createNode(const uint32_t parentId, const glm::float4x4& localTransform)
 {
-    Instance& inst = mInstances[instId];
-    inst.transform = newTransform;
-    mDirtyInstances.insert(instId);
+    mNodeInstances.emplace_back();
+    return mHierarchy.createNode(parentId, localTransform);
+}
+
+void Scene::attachInstance(const uint32_t nodeId, const uint32_t instId)
+{
+    mNodeInstances[nodeId].push_back(instId);
+}
+
+void Scene::setNodeLocalTransform(const uint32_t nodeId, const glm::float4x4& localTransform)
+{
+    mHierarchy.setLocalTransform(nodeId, localTransform);
+}
+
+void Scene::updateTransforms()
+{
+    if (!mHierarchy.hasDirtyNodes())
+    {
+        return;
+    }
+    for (const uint32_t nodeId : mHierarchy.update(mThreadPool))
+    {
+        const glm::float4x4& world = mHierarchy.getWorldTransform(nodeId);
+        // removed instances have stale handles and are skipped
+        for (const uint32_t instId : mNodeInstances[nodeId])
+        {
+            updateInstanceTransform(instId, world);
+        }
+    }
 }
 
 void Scene::beginFrame()
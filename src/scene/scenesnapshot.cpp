@@ -0,0 +1,431 @@
+#include "scenesnapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace nevk
+{
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+    const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    mFile = file;
+    mMapping = mapping;
+    mData = static_cast<const uint8_t*>(data);
+    mSize = (size_t)fileSize.QuadPart;
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // mapping stays valid
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+    // geometry is read front to back once, when buffers are uploaded
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+    mData = static_cast<const uint8_t*>(data);
+    mSize = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (!mData)
+    {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(mData);
+    CloseHandle(mMapping);
+    CloseHandle(mFile);
+    mMapping = nullptr;
+    mFile = nullptr;
+#else
+    munmap(const_cast<uint8_t*>(mData), mSize);
+#endif
+    mData = nullptr;
+    mSize = 0;
+}
+
+namespace
+{
+
+enum SectionId : uint32_t
+{
+    eVertices = 0,
+    eIndices,
+    eMeshes,
+    eMeshlets,
+    eMaterials,
+    eInstances,
+    eCameras,
+    eTextures,
+    eStrings,
+    eSectionCount
+};
+
+struct Section
+{
+    uint64_t offset; // from file start, aligned to kSectionAlignment
+    uint64_t count; // records
+    uint32_t stride; // record size, must match sizeof of record type
+    uint32_t pad;
+};
+
+struct Header
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    uint64_t fileSize;
+    glm::float4 lightPosition;
+    Section sections[eSectionCount];
+};
+
+// substring of strings section
+struct StringRef
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct CameraRecord
+{
+    StringRef name;
+    uint32_t type;
+    float fov;
+    float znear;
+    float zfar;
+    float rotationSpeed;
+    float movementSpeed;
+    glm::float4 orientation; // x, y, z, w
+    glm::float3 position;
+};
+
+struct TextureRecord
+{
+    StringRef path; // empty for embedded image
+};
+
+constexpr char kMagic[8] = { 'N', 'E', 'V', 'K', 'S', 'C', 'N', '\0' };
+constexpr uint64_t kSectionAlignment = 64;
+
+static_assert(std::is_trivially_copyable<Scene::Vertex>::value, "vertices are stored as raw memory");
+static_assert(std::is_trivially_copyable<Mesh>::value, "meshes are stored as raw memory");
+static_assert(std::is_trivially_copyable<Meshlet>::value, "meshlets are stored as raw memory");
+static_assert(std::is_trivially_copyable<Scene::Material>::value, "materials are stored as raw memory");
+static_assert(std::is_trivially_copyable<Instance>::value, "instances are stored as raw memory");
+
+uint64_t alignOffset(const uint64_t offset)
+{
+    return (offset + kSectionAlignment - 1) & ~(kSectionAlignment - 1);
+}
+
+StringRef addString(std::string& strings, const std::string& str)
+{
+    const StringRef res = { (uint32_t)strings.size(), (uint32_t)str.size() };
+    strings += str;
+    return res;
+}
+
+template <typename T>
+const T* sectionData(const MappedFile& file, const Header& header, const SectionId id)
+{
+    const Section& section = header.sections[id];
+    if (section.count == 0)
+    {
+        return nullptr;
+    }
+    return reinterpret_cast<const T*>(file.data() + section.offset);
+}
+
+} // namespace
+
+bool SceneSnapshot::save(const Scene& scene, const std::string& path)
+{
+    const fs::path baseDir = fs::absolute(path).parent_path();
+
+    std::vector<Instance> instances;
+    instances.reserve(scene.mInstances.size());
+    for (uint32_t i = 0; i < (uint32_t)scene.mInstances.size(); ++i)
+    {
+        if (!(scene.mInstances.getFlags(i) & InstanceStorage::eRemoved))
+        {
+            instances.push_back(scene.mInstances[i]);
+        }
+    }
+
+    std::string strings;
+    std::vector<CameraRecord> cameras;
+    for (const Camera& camera : scene.getCameras())
+    {
+        CameraRecord record{};
+        record.name = addString(strings, camera.name);
+        record.type = (uint32_t)camera.type;
+        record.fov = camera.fov;
+        record.znear = camera.znear;
+        record.zfar = camera.zfar;
+        record.rotationSpeed = camera.rotationSpeed;
+        record.movementSpeed = camera.movementSpeed;
+        record.orientation = glm::float4(camera.mOrientation.x, camera.mOrientation.y, camera.mOrientation.z, camera.mOrientation.w);
+        record.position = camera.position;
+        cameras.push_back(record);
+    }
+    std::vector<TextureRecord> textures;
+    for (const std::string& texturePath : scene.mTexturePaths)
+    {
+        // relative to snapshot, so snapshot can be moved together with textures
+        const std::string relative = texturePath.empty() ? std::string() : fs::proximate(fs::absolute(texturePath), baseDir).generic_string();
+        textures.push_back({ addString(strings, relative) });
+    }
+
+    Header header{};
+    memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.sectionCount = eSectionCount;
+    header.lightPosition = scene.mLightPosition;
+
+    const void* sectionSources[eSectionCount] = {};
+    auto addSection = [&](const SectionId id, const void* data, const size_t count, const uint32_t stride) {
+        header.sections[id].count = count;
+        header.sections[id].stride = stride;
+        sectionSources[id] = data;
+    };
+    addSection(eVertices, scene.getVertexData(), scene.getVertexCount(), sizeof(Scene::Vertex));
+    addSection(eIndices, scene.getIndexData(), scene.getIndexCount(), sizeof(uint32_t));
+    addSection(eMeshes, scene.mMeshes.data(), scene.mMeshes.size(), sizeof(Mesh));
+    addSection(eMeshlets, scene.mMeshlets.data(), scene.mMeshlets.size(), sizeof(Meshlet));
+    addSection(eMaterials, scene.mMaterials.data(), scene.mMaterials.size(), sizeof(Scene::Material));
+    addSection(eInstances, instances.data(), instances.size(), sizeof(Instance));
+    addSection(eCameras, cameras.data(), cameras.size(), sizeof(CameraRecord));
+    addSection(eTextures, textures.data(), textures.size(), sizeof(TextureRecord));
+    addSection(eStrings, strings.data(), strings.size(), 1);
+
+    uint64_t offset = sizeof(Header);
+    for (Section& section : header.sections)
+    {
+        offset = alignOffset(offset);
+        section.offset = offset;
+        offset += section.count * section.stride;
+    }
+    header.fileSize = offset;
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cerr << "Unable to write scene snapshot: " << path << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t written = sizeof(Header);
+    const char padding[kSectionAlignment] = {};
+    for (uint32_t i = 0; i < eSectionCount; ++i)
+    {
+        const Section& section = header.sections[i];
+        out.write(padding, (std::streamsize)(section.offset - written));
+        out.write(static_cast<const char*>(sectionSources[i]), (std::streamsize)(section.count * section.stride));
+        written = section.offset + section.count * section.stride;
+    }
+    return (bool)out;
+}
+
+bool SceneSnapshot::load(const std::string& path, Scene& scene)
+{
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(path))
+    {
+        std::cerr << "Unable to open scene snapshot: " << path << std::endl;
+        return false;
+    }
+
+    Header header;
+    if (file->size() < sizeof(Header))
+    {
+        std::cerr << "Scene snapshot is truncated: " << path << std::endl;
+        return false;
+    }
+    memcpy(&header, file->data(), sizeof(Header));
+    if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.sectionCount != eSectionCount)
+    {
+        std::cerr << "Unsupported scene snapshot version: " << path << std::endl;
+        return false;
+    }
+    const uint32_t strides[eSectionCount] = { sizeof(Scene::Vertex), sizeof(uint32_t), sizeof(Mesh), sizeof(Meshlet),
+                                              sizeof(Scene::Material), sizeof(Instance), sizeof(CameraRecord), sizeof(TextureRecord), 1 };
+    for (uint32_t i = 0; i < eSectionCount; ++i)
+    {
+        const Section& section = header.sections[i];
+        if (section.stride != strides[i] || section.offset % kSectionAlignment != 0 ||
+            section.offset > file->size() || section.count > (file->size() - section.offset) / section.stride)
+        {
+            std::cerr << "Scene snapshot is corrupted or written by incompatible build: " << path << std::endl;
+            return false;
+        }
+    }
+
+    const Section& stringSection = header.sections[eStrings];
+    const char* strings = sectionData<char>(*file, header, eStrings);
+    auto getString = [&](const StringRef& ref) {
+        if (ref.length == 0 || (uint64_t)ref.offset + ref.length > stringSection.count)
+        {
+            return std::string();
+        }
+        return std::string(strings + ref.offset, ref.length);
+    };
+
+    // small sections are copied, records may be unaligned for their types
+    const Section& meshSection = header.sections[eMeshes];
+    scene.mMeshes.resize(meshSection.count);
+    if (meshSection.count)
+    {
+        memcpy(scene.mMeshes.data(), file->data() + meshSection.offset, meshSection.count * sizeof(Mesh));
+    }
+    const Section& meshletSection = header.sections[eMeshlets];
+    scene.mMeshlets.resize(meshletSection.count);
+    if (meshletSection.count)
+    {
+        memcpy(scene.mMeshlets.data(), file->data() + meshletSection.offset, meshletSection.count * sizeof(Meshlet));
+    }
+    for (const Mesh& mesh : scene.mMeshes)
+    {
+        bool valid = (uint64_t)mesh.mVertexOffset + mesh.mVertexCount <= header.sections[eVertices].count &&
+                     (uint64_t)mesh.mIndex + mesh.mCount <= header.sections[eIndices].count &&
+                     (uint64_t)mesh.mMeshletOffset + mesh.mMeshletCount <= meshletSection.count &&
+                     mesh.mLodCount <= kMaxMeshLods;
+        for (uint32_t i = 0; valid && i < mesh.mLodCount; ++i)
+        {
+            valid = (uint64_t)mesh.mLods[i].mIndex + mesh.mLods[i].mCount <= header.sections[eIndices].count;
+        }
+        for (uint32_t i = 0; valid && i < mesh.mMeshletCount; ++i)
+        {
+            const Meshlet& meshlet = scene.mMeshlets[mesh.mMeshletOffset + i];
+            valid = (uint64_t)meshlet.mIndex + meshlet.mCount <= mesh.mCount;
+        }
+        if (!valid)
+        {
+            std::cerr << "Scene snapshot has mesh outside of geometry: " << path << std::endl;
+            scene.mMeshes.clear();
+            scene.mMeshlets.clear();
+            return false;
+        }
+    }
+    scene.mMeshGenerations.assign(meshSection.count, 0);
+    scene.mMeshHashes.assign(meshSection.count, 0);
+    scene.mMeshInstanceCounts.assign(meshSection.count, 0); // counted by createInstance()
+
+    const Section& materialSection = header.sections[eMaterials];
+    for (uint64_t i = 0; i < materialSection.count; ++i)
+    {
+        Scene::Material material;
+        memcpy(&material, file->data() + materialSection.offset + i * sizeof(Scene::Material), sizeof(material));
+        scene.addMaterial(material);
+    }
+
+    const Section& instanceSection = header.sections[eInstances];
+    for (uint64_t i = 0; i < instanceSection.count; ++i)
+    {
+        Instance inst;
+        memcpy(&inst, file->data() + instanceSection.offset + i * sizeof(Instance), sizeof(inst));
+        // fresh scene: handles of generation 0 are equal to slot indices
+        scene.createInstance(inst.mMeshId, inst.mMaterialId, inst.transform, inst.massCenter);
+    }
+
+    const Section& cameraSection = header.sections[eCameras];
+    for (uint64_t i = 0; i < cameraSection.count; ++i)
+    {
+        CameraRecord record;
+        memcpy(&record, file->data() + cameraSection.offset + i * sizeof(CameraRecord), sizeof(record));
+        Camera camera;
+        camera.name = getString(record.name);
+        camera.type = (Camera::CameraType)record.type;
+        camera.fov = record.fov;
+        camera.znear = record.znear;
+        camera.zfar = record.zfar;
+        camera.rotationSpeed = record.rotationSpeed;
+        camera.movementSpeed = record.movementSpeed;
+        camera.mOrientation = glm::quat(record.orientation.w, record.orientation.x, record.orientation.y, record.orientation.z);
+        camera.position = record.position;
+        camera.updateViewMatrix();
+        scene.addCamera(camera);
+    }
+
+    const fs::path baseDir = fs::absolute(path).parent_path();
+    const Section& textureSection = header.sections[eTextures];
+    for (uint64_t i = 0; i < textureSection.count; ++i)
+    {
+        TextureRecord record;
+        memcpy(&record, file->data() + textureSection.offset + i * sizeof(TextureRecord), sizeof(record));
+        const std::string relative = getString(record.path);
+        scene.mTexturePaths.push_back(relative.empty() ? std::string() : (baseDir / relative).lexically_normal().string());
+    }
+    scene.mLightPosition = header.lightPosition;
+
+    // geometry stays in mapping, file is unmapped when scene releases it
+    Scene::MeshView geometry;
+    geometry.vertices = sectionData<Scene::Vertex>(*file, header, eVertices);
+    geometry.vertexCount = header.sections[eVertices].count;
+    geometry.indices = sectionData<uint32_t>(*file, header, eIndices);
+    geometry.indexCount = header.sections[eIndices].count;
+    scene.setMappedGeometry(file, geometry);
+    return true;
+}
+
+} // namespace nevk
@@ -0,0 +1,207 @@
+#include "sort.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace nevk
+{
+
+void radixSort(std::vector<uint32_t>& keys,
+               std::vector<uint32_t>& values,
+               std::vector<uint32_t>& tmpKeys,
+               std::vector<uint32_t>& tmpValues)
+{
+    const size_t count = keys.size();
+    if (count < 2)
+    {
+        return;
+    }
+    tmpKeys.resize(count);
+    tmpValues.resize(count);
+
+    // all histograms in one pass over keys
+    uint32_t histograms[4][256] = {};
+    for (const uint32_t key : keys)
+    {
+        ++histograms[0][key & 0xFF];
+        ++histograms[1][(key >> 8) & 0xFF];
+        ++histograms[2][(key >> 16) & 0xFF];
+        ++histograms[3][key >> 24];
+    }
+
+    for (uint32_t pass = 0; pass < 4; ++pass)
+    {
+        uint32_t* histogram = histograms[pass];
+        const uint32_t shift = pass * 8;
+        // all keys have same digit, pass would not change order
+        if (histogram[(keys[0] >> shift) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < 256; ++digit)
+        {
+            const uint32_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            const uint32_t dst = histogram[(keys[i] >> shift) & 0xFF]++;
+            tmpKeys[dst] = keys[i];
+            tmpValues[dst] = values[i];
+        }
+        keys.swap(tmpKeys);
+        values.swap(tmpValues);
+    }
+}
+
+InstanceSorter::History* InstanceSorter::findHistory(const glm::float3& camPos, const Mode mode)
+{
+    for (History& history : mHistory)
+    {
+        const glm::float3 camDelta = camPos - history.camPos;
+        if (!history.order.empty() && history.mode == mode &&
+            glm::dot(camDelta, camDelta) <= coherenceThreshold * coherenceThreshold)
+        {
+            return &history;
+        }
+    }
+    return nullptr;
+}
+
+void InstanceSorter::fillFromLastOrder(const std::vector<uint32_t>& ids, const std::vector<uint32_t>& lastOrder)
+{
+    const uint32_t maxId = *std::max_element(ids.begin(), ids.end());
+    if (mMarks.size() <= maxId)
+    {
+        mMarks.resize(maxId + 1, 0);
+    }
+    if (mStamp >= std::numeric_limits<uint32_t>::max() - 2)
+    {
+        std::fill(mMarks.begin(), mMarks.end(), 0);
+        mStamp = 0;
+    }
+    mStamp += 2;
+    const uint32_t present = mStamp;
+    const uint32_t consumed = mStamp + 1;
+
+    for (const uint32_t id : ids)
+    {
+        mMarks[id] = present;
+    }
+    // ids still in list keep their last frame place, new ones go to the end
+    mValues.clear();
+    for (const uint32_t id : lastOrder)
+    {
+        if (id < mMarks.size() && mMarks[id] == present)
+        {
+            mValues.push_back(id);
+            mMarks[id] = consumed;
+        }
+    }
+    for (const uint32_t id : ids)
+    {
+        if (mMarks[id] == present)
+        {
+            mValues.push_back(id);
+            mMarks[id] = consumed;
+        }
+    }
+}
+
+bool InstanceSorter::insertionSort(const uint32_t maxMoves)
+{
+    uint32_t moves = 0;
+    for (size_t i = 1; i < mKeys.size(); ++i)
+    {
+        const uint32_t key = mKeys[i];
+        const uint32_t value = mValues[i];
+        size_t j = i;
+        while (j > 0 && mKeys[j - 1] > key)
+        {
+            mKeys[j] = mKeys[j - 1];
+            mValues[j] = mValues[j - 1];
+            --j;
+            if (++moves > maxMoves)
+            {
+                mKeys[j] = key;
+                mValues[j] = value;
+                return false;
+            }
+        }
+        mKeys[j] = key;
+        mValues[j] = value;
+    }
+    return true;
+}
+
+void InstanceSorter::sort(std::vector<uint32_t>& ids,
+                          const InstanceStorage& instances,
+                          const float* distances2,
+                          const glm::float3& camPos,
+                          const Mode mode)
+{
+    mUsedFastPath = false;
+    if (ids.size() < 2)
+    {
+        return;
+    }
+
+    if (mode == Mode::eState)
+    {
+        // 64-bit key as two stable 32-bit passes: low part first, then high part
+        mValues = ids;
+        mKeys.resize(mValues.size());
+        for (size_t i = 0; i < mValues.size(); ++i)
+        {
+            const uint32_t id = mValues[i];
+            mKeys[i] = (uint32_t)makeDrawSortKey(distances2[id], instances.getMaterialId(id), instances.getMeshId(id));
+        }
+        radixSort(mKeys, mValues, mTmpKeys, mTmpValues);
+        for (size_t i = 0; i < mValues.size(); ++i)
+        {
+            mKeys[i] = (uint32_t)(makeDrawSortKey(distances2[mValues[i]], 0, 0) >> 32);
+        }
+        radixSort(mKeys, mValues, mTmpKeys, mTmpValues);
+    }
+    else
+    {
+        History* history = findHistory(camPos, mode);
+        if (history)
+        {
+            fillFromLastOrder(ids, history->order);
+        }
+        else
+        {
+            mValues = ids;
+        }
+
+        const uint32_t flip = mode == Mode::eBackToFront ? 0xFFFFFFFF : 0;
+        mKeys.resize(mValues.size());
+        for (size_t i = 0; i < mValues.size(); ++i)
+        {
+            mKeys[i] = depthSortKey(distances2[mValues[i]]) ^ flip;
+        }
+
+        mUsedFastPath = history && insertionSort((uint32_t)mValues.size() * maxMovesPerInstance);
+        if (!mUsedFastPath)
+        {
+            radixSort(mKeys, mValues, mTmpKeys, mTmpValues);
+        }
+
+        if (!history)
+        {
+            history = &mHistory[mNextHistory];
+            mNextHistory = (mNextHistory + 1) % kMaxHistory;
+        }
+        history->order = mValues;
+        history->camPos = camPos;
+        history->mode = mode;
+    }
+
+    ids.assign(mValues.begin(), mValues.end());
+}
+
+} // namespace nevk
@@ -0,0 +1,109 @@
+#include "threadpool.h"
+
+#include <algorithm>
+#include <atomic>
+
+namespace nevk
+{
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+    mWorkers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i)
+    {
+        mWorkers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mCondition.notify_all();
+    for (std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    while (true)
+    {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this] { return mStop || !mTasks.empty(); });
+            if (mStop && mTasks.empty())
+            {
+                return;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop();
+        }
+        task();
+    }
+}
+
+std::future<void> ThreadPool::enqueue(std::function<void()> task)
+{
+    std::packaged_task<void()> packagedTask(std::move(task));
+    std::future<void> res = packagedTask.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push(std::move(packagedTask));
+    }
+    mCondition.notify_one();
+    return res;
+}
+
+void ThreadPool::parallelFor(const uint32_t count, uint32_t grainSize, const std::function<void(uint32_t, uint32_t)>& func)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    grainSize = std::max(grainSize, 1u);
+    const uint32_t chunkCount = std::min((count + grainSize - 1) / grainSize, getThreadCount() + 1);
+    if (chunkCount <= 1)
+    {
+        func(0, count);
+        return;
+    }
+
+    // chunks are grabbed dynamically, so calling thread never waits for work it could do itself
+    const uint32_t chunkSize = (count + chunkCount - 1) / chunkCount;
+    std::atomic<uint32_t> nextChunk{ 0 };
+    auto runChunks = [&]() {
+        for (uint32_t chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+        {
+            const uint32_t begin = chunk * chunkSize;
+            const uint32_t end = std::min(begin + chunkSize, count);
+            if (begin < end)
+            {
+                func(begin, end);
+            }
+        }
+    };
+
+    std::vector<std::future<void>> futures;
+    futures.reserve(chunkCount - 1);
+    for (uint32_t i = 0; i < chunkCount - 1; ++i)
+    {
+        futures.push_back(enqueue(runChunks));
+    }
+    runChunks();
+    for (std::future<void>& f : futures)
+    {
+        f.get();
+    }
+}
+
+} // namespace nevk
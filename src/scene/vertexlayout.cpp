@@ -0,0 +1,129 @@
+#include "vertexlayout.h"
+
+#include <cstddef>
+#include <cstring>
+
+namespace nevk
+{
+
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must match shader vertex input");
+// vertex pulling reads both layouts as 32 bit words, see pullVertex() in shaders/vertexlayout.h
+static_assert(sizeof(Scene::Vertex) == 24 && offsetof(Scene::Vertex, tangent) == 12 && offsetof(Scene::Vertex, normal) == 16 && offsetof(Scene::Vertex, uv) == 20,
+              "Scene::Vertex must match word offsets of shader vertex pulling");
+
+const VertexLayoutDesc& getVertexLayoutDesc(const VertexLayout layout)
+{
+    static const VertexLayoutDesc full = {
+        "full",
+        nullptr,
+        sizeof(Scene::Vertex),
+        {
+            { 0, VertexAttributeFormat::eFloat3, offsetof(Scene::Vertex, pos) },
+            { 1, VertexAttributeFormat::eUInt, offsetof(Scene::Vertex, tangent) },
+            { 2, VertexAttributeFormat::eUInt, offsetof(Scene::Vertex, normal) },
+            { 3, VertexAttributeFormat::eUInt, offsetof(Scene::Vertex, uv) },
+        },
+        sizeof(glm::float3)
+    };
+    // tangent is read together with position as 4th component
+    static const VertexLayoutDesc compact = {
+        "compact",
+        "NEVK_VERTEX_COMPACT",
+        sizeof(CompactVertex),
+        {
+            { 0, VertexAttributeFormat::eUShort4, offsetof(CompactVertex, pos) },
+            { 1, VertexAttributeFormat::eUInt, offsetof(CompactVertex, normal) },
+            { 2, VertexAttributeFormat::eUInt, offsetof(CompactVertex, uv) },
+        },
+        offsetof(CompactVertex, normal)
+    };
+    return layout == VertexLayout::eCompact ? compact : full;
+}
+
+bool findVertexLayout(const std::string& name, VertexLayout& layout)
+{
+    for (const VertexLayout candidate : { VertexLayout::eFull, VertexLayout::eCompact })
+    {
+        if (name == getVertexLayoutDesc(candidate).name)
+        {
+            layout = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void getPositionQuantization(const AABB& bounds, glm::float3& scale, glm::float3& bias)
+{
+    bias = bounds.minimum;
+    scale = glm::max(bounds.maximum - bounds.minimum, glm::float3(0.0f)) / 65535.0f;
+}
+
+void extractPositions(const VertexLayoutDesc& layout, const void* vertices, const size_t count, void* positions)
+{
+    static_assert(offsetof(Scene::Vertex, pos) == 0 && offsetof(CompactVertex, pos) == 0, "position stream is prefix of vertex");
+    const uint8_t* src = static_cast<const uint8_t*>(vertices);
+    uint8_t* dst = static_cast<uint8_t*>(positions);
+    for (size_t i = 0; i < count; ++i)
+    {
+        memcpy(dst + i * layout.positionStride, src + i * layout.stride, layout.positionStride);
+    }
+}
+
+GpuIndices buildGpuIndices(const std::vector<Mesh>& meshes, const uint32_t* indices, const size_t indexCount)
+{
+    GpuIndices res;
+    size_t count16 = 0;
+    size_t count32 = 0;
+    for (const Mesh& mesh : meshes)
+    {
+        size_t meshIndexCount = mesh.mCount;
+        for (uint32_t lod = 0; lod < mesh.mLodCount; ++lod)
+        {
+            meshIndexCount += mesh.mLods[lod].mCount;
+        }
+        (mesh.mVertexCount < 65536 ? count16 : count32) += meshIndexCount;
+    }
+    res.indices16.reserve(count16);
+    res.indices32.reserve(count32);
+    res.draws.resize(meshes.size());
+
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        const Mesh& mesh = meshes[i];
+        MeshDraw& draw = res.draws[i];
+        draw.vertexOffset = (int32_t)mesh.mVertexOffset;
+        draw.index16 = mesh.mVertexCount < 65536;
+        for (uint32_t lod = 0; lod <= kMaxMeshLods; ++lod)
+        {
+            uint32_t offset = 0;
+            uint32_t count = 0;
+            if (lod <= mesh.mLodCount)
+            {
+                Scene::getLodRange(mesh, lod, offset, count);
+            }
+            // ranges of removed meshes may be stale
+            if ((size_t)offset + count > indexCount)
+            {
+                count = 0;
+            }
+            draw.firstIndex[lod] = (uint32_t)(draw.index16 ? res.indices16.size() : res.indices32.size());
+            draw.indexCount[lod] = count;
+            for (uint32_t j = offset; j < offset + count; ++j)
+            {
+                const uint32_t index = indices[j] - mesh.mVertexOffset;
+                if (draw.index16)
+                {
+                    res.indices16.push_back((uint16_t)index);
+                }
+                else
+                {
+                    res.indices32.push_back(index);
+                }
+            }
+        }
+    }
+    return res;
+}
+
+} // namespace nevk
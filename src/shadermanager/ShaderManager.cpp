@@ -24,6 +24,10 @@ ShaderManager::ShaderDesc ShaderManager::compileShader(const char* fileName, con
     int targetIndex = spAddCodeGenTarget(slangRequest, SLANG_SPIRV);
     SlangProfileID profileID = spFindProfile(mSlangSession, "sm_6_3");
     spSetTargetProfile(slangRequest, targetIndex, profileID);
+    for (const auto& define : mDefines)
+    {
+        spAddPreprocessorDefine(slangRequest, define.first.c_str(), define.second.c_str());
+    }
     int translationUnitIndex = spAddTranslationUnit(slangRequest, SLANG_SOURCE_LANGUAGE_SLANG, nullptr);
     spAddTranslationUnitSourceFile(slangRequest, translationUnitIndex, fileName);
 
@@ -73,6 +77,10 @@ ShaderManager::ShaderDesc ShaderManager::compileShader(const char* fileName, con
     //spDestroyCompileRequest(slangRequest);
     return desc;
 }
+void ShaderManager::addDefine(const std::string& name, const std::string& value)
+{
+    mDefines.emplace_back(name, value);
+}
 uint32_t ShaderManager::loadShader(const char* fileName, const char* entryPointName, Stage stage)
 {
     ShaderDesc sd = compileShader(fileName, entryPointName, stage);
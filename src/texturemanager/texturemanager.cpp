@@ -19,6 +19,11 @@ int nevk::TextureManager::loadTexture(const std::string& texture_path, const std
     if (path.find(backslash) < path.size())
         path.replace(path.find(backslash), backslash.length(), fslash);
 
+    return loadTextureFile(path);
+}
+
+int nevk::TextureManager::loadTextureFile(const std::string& path)
+{
     if (mNameToID.count(path) == 0)
     {
         mNameToID[path] = textures.size();
@@ -45,6 +50,114 @@ int nevk::TextureManager::loadTextureGltf(const void* pixels, const uint32_t wid
     return mNameToID.find(name)->second;
 }
 
+static VkImageMemoryBarrier imageBarrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = srcAccess;
+    barrier.dstAccessMask = dstAccess;
+    return barrier;
+}
+
+std::vector<int> nevk::TextureManager::loadTextureBatch(const std::vector<TextureData>& batch)
+{
+    std::vector<int> ids(batch.size(), -1);
+    std::vector<size_t> created; // batch entries which become new textures
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        auto it = mNameToID.find(batch[i].name);
+        if (it == mNameToID.end())
+        {
+            it = mNameToID.emplace(batch[i].name, (uint32_t)(textures.size() + created.size())).first;
+            created.push_back(i);
+        }
+        ids[i] = it->second;
+    }
+
+    // staging memory is limited, so large batch is split into several submits
+    const VkDeviceSize maxStagingSize = 256ull << 20;
+    size_t begin = 0;
+    while (begin < created.size())
+    {
+        size_t end = begin;
+        VkDeviceSize stagingSize = 0;
+        while (end < created.size())
+        {
+            const TextureData& data = batch[created[end]];
+            const VkDeviceSize imageSize = (VkDeviceSize)data.width * data.height * 4;
+            if (end > begin && stagingSize + imageSize > maxStagingSize)
+            {
+                break;
+            }
+            stagingSize += imageSize;
+            ++end;
+        }
+
+        Buffer* stagingBuffer = mResManager->createBuffer(stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        uint8_t* stagingBufferMemory = static_cast<uint8_t*>(mResManager->getMappedMemory(stagingBuffer));
+
+        std::vector<Texture> newTextures;
+        std::vector<VkBufferImageCopy> regions;
+        std::vector<VkImageMemoryBarrier> toTransfer;
+        std::vector<VkImageMemoryBarrier> toShaderRead;
+        VkDeviceSize offset = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            const TextureData& data = batch[created[i]];
+            const VkDeviceSize imageSize = (VkDeviceSize)data.width * data.height * 4;
+            memcpy(stagingBufferMemory + offset, data.pixels, static_cast<size_t>(imageSize));
+
+            Image* textureImage = mResManager->createImage(data.width, data.height, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            const VkImage image = mResManager->getVkImage(textureImage);
+            newTextures.push_back(Texture{ textureImage, data.width, data.height });
+
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = { data.width, data.height, 1 };
+            regions.push_back(region);
+
+            toTransfer.push_back(imageBarrier(image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT));
+            toShaderRead.push_back(imageBarrier(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+            offset += imageSize;
+        }
+
+        VkCommandBuffer commandBuffer = mResManager->beginSingleTimeCommands();
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                             (uint32_t)toTransfer.size(), toTransfer.data());
+        for (size_t i = 0; i < newTextures.size(); ++i)
+        {
+            vkCmdCopyBufferToImage(commandBuffer, mResManager->getVkBuffer(stagingBuffer), mResManager->getVkImage(newTextures[i].textureImage),
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &regions[i]);
+        }
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr,
+                             (uint32_t)toShaderRead.size(), toShaderRead.data());
+        mResManager->endSingleTimeCommands(commandBuffer);
+
+        mResManager->destroyBuffer(stagingBuffer);
+
+        for (Texture& tex : newTextures)
+        {
+            textures.push_back(tex);
+            createTextureImageView(tex);
+        }
+        begin = end;
+    }
+
+    return ids;
+}
+
 nevk::TextureManager::Texture nevk::TextureManager::createTextureImage(const std::string& texture_path)
 {
     int texWidth, texHeight, texChannels;
@@ -233,7 +233,7 @@ void Ui::updateUI(Scene& scene, DepthPass& depthPass, double msPerFrame, std::st
 
     // open Dialog Simple
     if (ImGui::Button("Open File Dialog"))
-        ImGuiFileDialog::Instance()->OpenDialog("ChooseFileDlgKey", "Choose File", ".gltf,.obj", ".");
+        ImGuiFileDialog::Instance()->OpenDialog("ChooseFileDlgKey", "Choose File", ".gltf,.glb,.obj,.nevk", ".");
     // display
     if (ImGuiFileDialog::Instance()->Display("ChooseFileDlgKey"))
     {
@@ -298,6 +298,10 @@ void Ui::updateUI(Scene& scene, DepthPass& depthPass, double msPerFrame, std::st
     //     transparency settings
     ImGui::Checkbox("Transparent Mode", &scene.transparentMode);
     ImGui::Checkbox("Opaque Mode", &scene.opaqueMode);
+    ImGui::Checkbox("Frustum Culling", &scene.frustumCulling);
+    ImGui::Checkbox("Sort by Material", &scene.stateSorting);
+    ImGui::SliderFloat("LOD Pixel Error", &scene.lodPixelError, 0.0f, 16.0f);
+    ImGui::SliderFloat("Shadow LOD Pixel Error", &scene.shadowLodPixelError, 0.0f, 32.0f);
 
 
     ImGui::End(); // end window
@@ -2,7 +2,12 @@
 #include <render/render.h>
 
 #include <doctest.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <regex>
 
 const std::string MODELPATH = "misc/test_data/cube.obj";
 const std::string MODELPATHR = "misc/Cube/Cube.gltf";
@@ -13,30 +18,210 @@ const std::string TEXPATH3 = "textures/container.jpg";
 
 TEST_CASE("load model")
 {
-    Render r;
-    r.MODEL_PATH = MODELPATHR;
-    r.MTL_PATH = MTLPATH;
-    r.HEIGHT = 600;
-    r.WIDTH = 800;
-    r.initWindow();
-    r.initVulkan();
-
-    nevk::TextureManager* mTexManager = new nevk::TextureManager(r.getDevice(), r.getPhysicalDevice(), r.getResManager());
+    // import is CPU only, no device is needed
     nevk::Scene scene;
+    std::vector<nevk::ImportedImage> images;
 
-    nevk::ModelLoader model(mTexManager);
-    bool loaded = model.loadModel(MODELPATH, MTLPATH, scene);
+    nevk::ModelLoader model;
+    bool loaded = model.loadModel(MODELPATH, MTLPATH, scene, &images);
 
     CHECK(loaded == true);
     CHECK(scene.getIndices().size() == 36);
-    CHECK(scene.getVertices().size() == 36);
+    CHECK(scene.getVertices().size() == 24); // corners shared by two triangles of each side are welded
 
-    CHECK(mTexManager->textures.size() == 1);
-    CHECK(mTexManager->textures[0].texWidth == 512);
-    CHECK(mTexManager->textures[0].texHeight == 512);
+    REQUIRE(images.size() == 1);
+    CHECK(images[0].width == 512);
+    CHECK(images[0].height == 512);
+    CHECK(images[0].pixels.size() == 512 * 512 * 4);
+    CHECK(scene.mTexturePaths == std::vector<std::string>{ images[0].name });
+}
 
-    mTexManager->textureDestroy();
-    r.cleanup();
+TEST_CASE("load gltf images")
+{
+    nevk::Scene scene;
+    std::vector<nevk::ImportedImage> images;
+
+    nevk::ModelLoader model;
+    REQUIRE(model.loadModelGltf(MODELPATHR, scene, &images));
+
+    // texture ids of materials are image indices
+    REQUIRE(images.size() == 2);
+    CHECK(scene.mTexturePaths.size() == 2);
+    for (const nevk::ImportedImage& image : images)
+    {
+        CHECK(image.width > 0);
+        CHECK(image.pixels.size() == (size_t)image.width * image.height * 4);
+    }
+    CHECK(scene.getMaterials()[0].texBaseColor == 0);
+    CHECK(scene.getMaterials()[0].texNormalId == -1);
+
+    // without image list only paths are kept
+    nevk::Scene pathsOnly;
+    REQUIRE(model.loadModelGltf(MODELPATHR, pathsOnly));
+    CHECK(pathsOnly.mTexturePaths == scene.mTexturePaths);
+}
+
+TEST_CASE("weld vertices")
+{
+    std::vector<nevk::Scene::Vertex> vertices(6);
+    for (uint32_t i = 0; i < vertices.size(); ++i)
+    {
+        vertices[i].pos = glm::float3((float)(i % 4), 0.0f, 0.0f);
+    }
+    vertices[5].normal = 1; // same position, different attribute stays separate
+    std::vector<uint32_t> indices = { 0, 1, 2, 3, 4, 5 };
+
+    CHECK(nevk::ModelLoader::weldVertices(vertices, indices) == 5);
+    CHECK(vertices.size() == 5);
+    CHECK((indices == std::vector<uint32_t>{ 0, 1, 2, 3, 0, 4 }));
+    CHECK(vertices[4].normal == 1);
+}
+
+TEST_CASE("load glb")
+{
+    // pack Cube.gltf and its buffer into .glb, buffer becomes BIN chunk without uri
+    std::ifstream jsonFile(MODELPATHR);
+    std::string json((std::istreambuf_iterator<char>(jsonFile)), std::istreambuf_iterator<char>());
+    json = std::regex_replace(json, std::regex(R"(,\s*"uri"\s*:\s*"Cube\.bin")"), "");
+    json.resize((json.size() + 3) & ~3, ' ');
+    std::ifstream binFile("misc/Cube/Cube.bin", std::ios::binary);
+    std::vector<char> bin((std::istreambuf_iterator<char>(binFile)), std::istreambuf_iterator<char>());
+    bin.resize((bin.size() + 3) & ~3, 0);
+    REQUIRE(bin.size() > 0);
+
+    const std::string glbPath = (std::filesystem::temp_directory_path() / "nevk_test_cube.glb").string();
+    {
+        const uint32_t header[5] = { 0x46546C67, 2, (uint32_t)(28 + json.size() + bin.size()), (uint32_t)json.size(), 0x4E4F534A };
+        const uint32_t binHeader[2] = { (uint32_t)bin.size(), 0x004E4942 };
+        std::ofstream glb(glbPath, std::ios::binary);
+        glb.write(reinterpret_cast<const char*>(header), sizeof(header));
+        glb.write(json.data(), json.size());
+        glb.write(reinterpret_cast<const char*>(binHeader), sizeof(binHeader));
+        glb.write(bin.data(), bin.size());
+    }
+
+    nevk::ModelLoader loader;
+    nevk::Scene gltfScene;
+    nevk::Scene glbScene;
+    CHECK(loader.loadModelGltf(MODELPATHR, gltfScene));
+    CHECK(loader.loadModelGltf(glbPath, glbScene));
+
+    const std::vector<nevk::Scene::Vertex>& gltfVertices = gltfScene.getVertices();
+    const std::vector<nevk::Scene::Vertex>& glbVertices = glbScene.getVertices();
+    REQUIRE(glbVertices.size() == gltfVertices.size());
+    CHECK(memcmp(glbVertices.data(), gltfVertices.data(), gltfVertices.size() * sizeof(nevk::Scene::Vertex)) == 0);
+    CHECK(glbScene.getIndices() == gltfScene.getIndices());
+    CHECK(glbScene.getInstances().size() == gltfScene.getInstances().size());
+
+    std::filesystem::remove(glbPath);
+}
+
+// thread pool must not change import result or order of ids
+static void checkSameImport(nevk::Scene& serial, nevk::Scene& parallel)
+{
+    const std::vector<nevk::Scene::Vertex>& serialVertices = serial.getVertices();
+    const std::vector<nevk::Scene::Vertex>& parallelVertices = parallel.getVertices();
+    REQUIRE(parallelVertices.size() == serialVertices.size());
+    CHECK(memcmp(parallelVertices.data(), serialVertices.data(), serialVertices.size() * sizeof(nevk::Scene::Vertex)) == 0);
+    CHECK(parallel.getIndices() == serial.getIndices());
+
+    const std::vector<nevk::Mesh>& serialMeshes = serial.getMeshes();
+    const std::vector<nevk::Mesh>& parallelMeshes = parallel.getMeshes();
+    REQUIRE(parallelMeshes.size() == serialMeshes.size());
+    bool sameMeshes = true;
+    for (size_t i = 0; i < serialMeshes.size(); ++i)
+    {
+        sameMeshes &= parallelMeshes[i].mIndex == serialMeshes[i].mIndex && parallelMeshes[i].mCount == serialMeshes[i].mCount &&
+                      parallelMeshes[i].mVertexOffset == serialMeshes[i].mVertexOffset && parallelMeshes[i].mVertexCount == serialMeshes[i].mVertexCount;
+    }
+    CHECK(sameMeshes);
+
+    const std::vector<nevk::Scene::Material>& serialMaterials = serial.getMaterials();
+    const std::vector<nevk::Scene::Material>& parallelMaterials = parallel.getMaterials();
+    REQUIRE(parallelMaterials.size() == serialMaterials.size());
+    CHECK(memcmp(parallelMaterials.data(), serialMaterials.data(), serialMaterials.size() * sizeof(nevk::Scene::Material)) == 0);
+
+    const nevk::InstanceStorage& serialInstances = serial.getInstances();
+    const nevk::InstanceStorage& parallelInstances = parallel.getInstances();
+    REQUIRE(parallelInstances.size() == serialInstances.size());
+    bool sameInstances = true;
+    for (uint32_t i = 0; i < (uint32_t)serialInstances.size(); ++i)
+    {
+        sameInstances &= parallelInstances.getMeshId(i) == serialInstances.getMeshId(i) && parallelInstances.getMaterialId(i) == serialInstances.getMaterialId(i) &&
+                         parallelInstances.getTransform(i) == serialInstances.getTransform(i);
+    }
+    CHECK(sameInstances);
+    CHECK(parallel.mTexturePaths == serial.mTexturePaths);
+}
+
+TEST_CASE("parallel import matches serial")
+{
+    nevk::ThreadPool pool(4);
+    nevk::ModelLoader loader;
+
+    // several shapes and materials
+    {
+        const std::string objPath = "misc/CornellBox-Sphere.obj";
+        nevk::Scene serial;
+        serial.setThreadPool(nullptr);
+        nevk::Scene parallel;
+        parallel.setThreadPool(&pool);
+        REQUIRE(loader.loadModel(objPath, "misc/", serial));
+        REQUIRE(loader.loadModel(objPath, "misc/", parallel));
+        CHECK(serial.getMeshes().size() > 1);
+        checkSameImport(serial, parallel);
+    }
+
+    // Cube.gltf with several meshes and primitives, written next to its buffer and images
+    {
+        std::ifstream jsonFile(MODELPATHR);
+        std::string json((std::istreambuf_iterator<char>(jsonFile)), std::istreambuf_iterator<char>());
+        const std::smatch primitive = [&json]() {
+            std::smatch match;
+            std::regex_search(json, match, std::regex(R"(\{\s*"attributes"[^}]*\}[^}]*\})"));
+            return match;
+        }();
+        REQUIRE(!primitive.empty());
+        // primitive without tangents gets them generated, so meshes differ in content
+        const std::string noTangent = std::regex_replace(primitive.str(), std::regex(R"("TANGENT"\s*:\s*3,)"), "");
+        const std::string primitives = primitive.str() + "," + noTangent + "," + primitive.str();
+        std::string meshes = R"("meshes" : [ { "name" : "A", "primitives" : [ )" + primitives + R"( ] }, { "name" : "B", "primitives" : [ )" + noTangent + R"( ] } ],)";
+        json = std::regex_replace(json, std::regex(R"("meshes"\s*:\s*\[[\s\S]*?\}\s*\]\s*\}\s*\],)"), meshes);
+        json = std::regex_replace(json, std::regex(R"("nodes"\s*:\s*\[)"),
+                                  R"("nodes" : [ { "mesh" : 1, "translation" : [ 3.0, 0.0, 0.0 ] }, { "mesh" : 0, "translation" : [ 0.0, 3.0, 0.0 ] }, { "mesh" : 1 },)",
+                                  std::regex_constants::format_first_only);
+        json = std::regex_replace(json, std::regex(R"("nodes"\s*:\s*\[\s*0, 1, 2\s*\])"), R"("nodes" : [ 0, 1, 2, 3, 4, 5 ])");
+        REQUIRE(json.find(R"("name" : "B")") != std::string::npos);
+
+        const std::filesystem::path dir = std::filesystem::temp_directory_path() / "nevk_test_parallel";
+        std::filesystem::create_directories(dir);
+        for (const char* file : { "Cube.bin", "Cube_BaseColor.png", "Cube_MetallicRoughness.png" })
+        {
+            std::filesystem::copy_file(std::filesystem::path("misc/Cube") / file, dir / file, std::filesystem::copy_options::overwrite_existing);
+        }
+        const std::string gltfPath = (dir / "Cubes.gltf").string();
+        std::ofstream(gltfPath) << json;
+
+        nevk::Scene serial;
+        serial.setThreadPool(nullptr);
+        nevk::Scene parallel;
+        parallel.setThreadPool(&pool);
+        std::vector<nevk::ImportedImage> serialImages;
+        std::vector<nevk::ImportedImage> parallelImages;
+        REQUIRE(loader.loadModelGltf(gltfPath, serial, &serialImages));
+        REQUIRE(loader.loadModelGltf(gltfPath, parallel, &parallelImages));
+        CHECK(serial.getInstances().size() >= 4);
+        checkSameImport(serial, parallel);
+        REQUIRE(parallelImages.size() == serialImages.size());
+        bool sameImages = true;
+        for (size_t i = 0; i < serialImages.size(); ++i)
+        {
+            sameImages &= parallelImages[i].name == serialImages[i].name && parallelImages[i].pixels == serialImages[i].pixels;
+        }
+        CHECK(sameImages);
+
+        std::filesystem::remove_all(dir);
+    }
 }
 
 TEST_CASE("load textures")
@@ -73,3 +258,177 @@ TEST_CASE("load textures")
     mTexManager->textureDestroy();
     r.cleanup();
 }
+
+TEST_CASE("compute tangents")
+{
+    // quad in XY plane facing +z, UV origin is top left so v grows towards -y
+    std::vector<nevk::Scene::Vertex> vertices(4);
+    const glm::float2 corners[4] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        vertices[i].pos = glm::float3(corners[i], 0.0f);
+        vertices[i].normal = nevk::packNormal(glm::float3(0.0f, 0.0f, 1.0f));
+        vertices[i].uv = nevk::packUV(glm::float2(corners[i].x, 1.0f - corners[i].y));
+    }
+    const std::vector<uint32_t> indices = { 0, 1, 2, 0, 2, 3 };
+    // handedness in bit 30
+    auto tangentOf = [](const nevk::Scene::Vertex& v) { return glm::float3(nevk::unpackTangent(v.tangent)); };
+
+    nevk::ModelLoader::computeTangents(vertices, indices);
+    for (const nevk::Scene::Vertex& v : vertices)
+    {
+        const glm::float3 tangent = tangentOf(v);
+        CHECK(tangent.x > 0.99f);
+        CHECK(std::abs(tangent.y) < 0.01f);
+        CHECK(std::abs(tangent.z) < 0.01f);
+        CHECK((v.tangent & 0x40000000) == 0);
+    }
+
+    // mirrored U flips tangent and handedness, bitangent stays
+    for (uint32_t i = 0; i < 4; ++i)
+    {
+        vertices[i].uv = nevk::packUV(glm::float2(1.0f - corners[i].x, 1.0f - corners[i].y));
+    }
+    nevk::ModelLoader::computeTangents(vertices, indices);
+    for (const nevk::Scene::Vertex& v : vertices)
+    {
+        CHECK(tangentOf(v).x < -0.99f);
+        CHECK((v.tangent & 0x40000000) != 0);
+    }
+
+    // vertex shared by triangles with different UV scale gets unit tangent orthogonal to its normal
+    vertices[2].normal = nevk::packNormal(glm::normalize(glm::float3(0.0f, 1.0f, 1.0f)));
+    vertices[3].uv = nevk::packUV(glm::float2(4.0f, 0.0f));
+    nevk::ModelLoader::computeTangents(vertices, indices);
+    const glm::float3 shared = tangentOf(vertices[2]);
+    CHECK(glm::length(shared) == doctest::Approx(1.0f).epsilon(0.01f));
+    CHECK(std::abs(glm::dot(shared, nevk::unpackNormal(vertices[2].normal))) < 0.01f);
+}
+
+TEST_CASE("octahedral normal and tangent packing")
+{
+    // directions spread over sphere plus axes, diagonals and vectors near folded corners
+    std::vector<glm::float3> normals = { { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+                                         { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }, { -1e-6f, -1e-6f, -1.0f }, { 1.0f, 1.0f, -1.0f } };
+    for (uint32_t i = 0; i < 1000; ++i)
+    {
+        // Fibonacci sphere, scaled because input does not need to be unit
+        const float z = 1.0f - 2.0f * (i + 0.5f) / 1000.0f;
+        const float r = std::sqrt(1.0f - z * z);
+        const float phi = 2.39996323f * i;
+        normals.push_back(glm::float3(r * std::cos(phi), r * std::sin(phi), z) * (0.5f + (i % 7)));
+    }
+    normals.push_back(glm::float3(0.0f)); // missing normal
+    std::vector<glm::float4> tangents(normals.size());
+    for (size_t i = 0; i < normals.size(); ++i)
+    {
+        tangents[i] = glm::float4(normals[(i + 1) % normals.size()], i % 2 ? -1.0f : 1.0f);
+    }
+
+    std::vector<nevk::Scene::Vertex> vertices(normals.size());
+    nevk::packNormals(normals.data(), normals.size(), vertices.data());
+    nevk::packTangents(tangents.data(), tangents.size(), vertices.data());
+    std::vector<glm::float3> unpackedNormals(normals.size());
+    std::vector<glm::float4> unpackedTangents(normals.size());
+    nevk::unpackNormals(vertices.data(), vertices.size(), unpackedNormals.data());
+    nevk::unpackTangents(vertices.data(), vertices.size(), unpackedTangents.data());
+
+    float maxNormalError = 0.0f;
+    float maxTangentError = 0.0f;
+    for (size_t i = 0; i < normals.size(); ++i)
+    {
+        // batched kernels are bitwise equal to single vertex functions, modelloader is built without FP contraction
+        CHECK(vertices[i].normal == nevk::packNormal(normals[i]));
+        CHECK(vertices[i].tangent == nevk::packTangent(glm::float3(tangents[i]), tangents[i].w));
+        const glm::float3 normal = nevk::unpackNormal(vertices[i].normal);
+        const glm::float4 tangent = nevk::unpackTangent(vertices[i].tangent);
+        CHECK(memcmp(&unpackedNormals[i], &normal, sizeof(normal)) == 0);
+        CHECK(memcmp(&unpackedTangents[i], &tangent, sizeof(tangent)) == 0);
+
+        CHECK(tangent.w == tangents[i].w);
+        CHECK(glm::length(normal) == doctest::Approx(1.0f).epsilon(1e-5f));
+        if (glm::length(normals[i]) > 0.0f)
+        {
+            CHECK(vertices[i].normal != 0);
+            maxNormalError = std::max(maxNormalError, glm::length(normal - glm::normalize(normals[i])));
+        }
+        if (glm::length(glm::float3(tangents[i])) > 0.0f)
+        {
+            maxTangentError = std::max(maxTangentError, glm::length(glm::float3(tangent) - glm::normalize(glm::float3(tangents[i]))));
+        }
+    }
+    CHECK(vertices[normals.size() - 1].normal == 0);
+    // measured about 6e-5 for 16 bits and twice that for 15 bits, 10 bits per axis of cube encoding gave over 1e-3
+    CHECK(maxNormalError < 1e-4f);
+    CHECK(maxTangentError < 2e-4f);
+}
+
+TEST_CASE("compact vertex layout")
+{
+    nevk::VertexLayout layout = nevk::VertexLayout::eFull;
+    CHECK(nevk::findVertexLayout("compact", layout));
+    CHECK(layout == nevk::VertexLayout::eCompact);
+    CHECK(!nevk::findVertexLayout("unknown", layout));
+    CHECK(nevk::getVertexLayoutDesc(nevk::VertexLayout::eCompact).stride == sizeof(nevk::CompactVertex));
+    CHECK(nevk::getVertexLayoutDesc(nevk::VertexLayout::eFull).stride == sizeof(nevk::Scene::Vertex));
+
+    // meshes with different bounds, second one is flat in z
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> curved(500);
+    std::vector<nevk::Scene::Vertex> flat(100);
+    for (uint32_t i = 0; i < curved.size(); ++i)
+    {
+        const float z = 1.0f - 2.0f * (i + 0.5f) / curved.size();
+        const float r = std::sqrt(1.0f - z * z);
+        const float phi = 2.39996323f * i;
+        const glm::float3 normal(r * std::cos(phi), r * std::sin(phi), z);
+        const glm::float3 up = std::abs(normal.y) < 0.9f ? glm::float3(0.0f, 1.0f, 0.0f) : glm::float3(1.0f, 0.0f, 0.0f);
+        curved[i].pos = glm::float3(std::sin(phi) * 10.0f + 3.0f, std::cos(phi * 0.7f) * 0.01f, i * 0.25f - 20.0f);
+        curved[i].normal = nevk::packNormal(normal);
+        curved[i].tangent = nevk::packTangent(glm::cross(normal, up), i % 2 ? -1.0f : 1.0f);
+        curved[i].uv = nevk::packUV(glm::float2(z, r));
+    }
+    for (uint32_t i = 0; i < flat.size(); ++i)
+    {
+        flat[i].pos = glm::float3((float)i, i * -2.0f, 5.0f);
+        flat[i].normal = nevk::packNormal(glm::float3(0.0f, 0.0f, 1.0f));
+        flat[i].tangent = nevk::packTangent(glm::float3(1.0f, 0.0f, 0.0f), 1.0f);
+    }
+    scene.createMesh(curved, { 0, 1, 2 });
+    scene.createMesh(flat, { 0, 1, 2 });
+
+    const std::vector<nevk::CompactVertex> compact = nevk::packCompactVertices(scene.getMeshes(), scene.getVertexData(), scene.getVertexCount());
+    REQUIRE(compact.size() == scene.getVertexCount());
+    float maxTangentError = 0.0f;
+    for (const nevk::Mesh& mesh : scene.getMeshes())
+    {
+        glm::float3 scale, bias;
+        nevk::getPositionQuantization(mesh.mBounds, scale, bias);
+        for (uint32_t i = mesh.mVertexOffset; i < mesh.mVertexOffset + mesh.mVertexCount; ++i)
+        {
+            const nevk::Scene::Vertex& vertex = scene.getVertexData()[i];
+            // rounding error is half of quantization step
+            for (uint32_t axis = 0; axis < 3; ++axis)
+            {
+                const float decoded = compact[i].pos[axis] * scale[axis] + bias[axis];
+                CHECK(std::abs(decoded - vertex.pos[axis]) <= scale[axis] * 0.5f + 1e-5f);
+            }
+            CHECK(compact[i].normal == vertex.normal);
+            CHECK(compact[i].uv == vertex.uv);
+
+            const glm::float3 normal = nevk::unpackNormal(vertex.normal);
+            const glm::float4 expected = nevk::unpackTangent(vertex.tangent);
+            const glm::float4 tangent = nevk::unpackTangentAngle(normal, compact[i].tangent);
+            CHECK(tangent.w == expected.w);
+            CHECK(std::abs(glm::dot(glm::float3(tangent), normal)) < 1e-5f);
+            const glm::float3 projected = glm::normalize(glm::float3(expected) - glm::dot(glm::float3(expected), normal) * normal);
+            maxTangentError = std::max(maxTangentError, glm::length(glm::float3(tangent) - projected));
+        }
+    }
+    // flat axis has no scale, all vertices get 0
+    const nevk::Mesh& flatMesh = scene.getMeshes()[1];
+    CHECK(compact[flatMesh.mVertexOffset].pos[2] == 0);
+    CHECK(compact[flatMesh.mVertexOffset + flatMesh.mVertexCount - 1].pos[0] == 65535);
+    // measured about 1e-4, half of angle step
+    CHECK(maxTangentError < 2e-4f);
+}
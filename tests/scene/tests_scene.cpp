@@ -1,6 +1,15 @@
+#include <scene/meshoptimizer.h>
 #include <scene/scene.h>
+#include <scene/scenesnapshot.h>
+#include <scene/vertexlayout.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <doctest.h>
+#include <filesystem>
+#include <numeric>
 
 TEST_CASE("test checkBeginFrameStatus")
 {
@@ -36,7 +45,11 @@ TEST_CASE("test createMesh complex")
     CHECK(meshIdFst != meshIdSnd);
     scene.removeMesh(meshIdFst);
     uint32_t meshIdThd = scene.createMesh(vb, ib);
-    CHECK(meshIdFst == meshIdThd);
+    // slot is reused with new generation
+    CHECK(meshIdFst != meshIdThd);
+    CHECK(nevk::Scene::handleIndex(meshIdFst) == nevk::Scene::handleIndex(meshIdThd));
+    CHECK(!scene.isMeshValid(meshIdFst));
+    CHECK(scene.isMeshValid(meshIdThd));
 }
 
 TEST_CASE("test createInstance")
@@ -96,9 +109,13 @@ TEST_CASE("test createInstance complex")
     uint32_t firstId = scene.createInstance(meshId, matId, transform, massCenter);
     uint32_t secondId = scene.createInstance(meshId, matId, transform, massCenter);
     CHECK(firstId != secondId);
-    scene.removeInstance(firstId);
+    CHECK(scene.removeInstance(firstId));
+    CHECK(!scene.removeInstance(firstId));
     uint32_t thirdId = scene.createInstance(meshId, matId, transform, massCenter);
-    CHECK(firstId == thirdId);
+    CHECK(firstId != thirdId);
+    CHECK(nevk::Scene::handleIndex(firstId) == nevk::Scene::handleIndex(thirdId));
+    CHECK(!scene.updateInstanceTransform(firstId, transform));
+    CHECK(scene.updateInstanceTransform(thirdId, transform));
 }
 
 TEST_CASE("test createMaterial")
@@ -149,7 +166,8 @@ TEST_CASE("test createMaterial complex")
                                              1.0f,
                                              0, 0, 0, 0, 0,
                                              1.0f);
-    CHECK(matIdFst == matIdThd);
+    CHECK(matIdFst != matIdThd);
+    CHECK(nevk::Scene::handleIndex(matIdFst) == nevk::Scene::handleIndex(matIdThd));
 }
 
 TEST_CASE("test checkMesh")
@@ -207,3 +225,1017 @@ TEST_CASE("test checkMaterial")
     CHECK(matId == 0);
     CHECK(scene.mMaterials.size() == 1);
 }
+
+TEST_CASE("test frustum culling")
+{
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> vb(3);
+    vb[0].pos = glm::float3(-1.0f, -1.0f, 0.0f);
+    vb[1].pos = glm::float3(1.0f, -1.0f, 0.0f);
+    vb[2].pos = glm::float3(0.0f, 1.0f, 0.0f);
+    std::vector<uint32_t> ib = { 0, 1, 2 };
+    uint32_t meshId = scene.createMesh(vb, ib);
+    uint32_t matId = scene.createMaterial(glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          1.0f,
+                                          1.0f,
+                                          2, 0, 0, 0, 0,
+                                          1.0f);
+
+    nevk::Camera camera;
+    camera.setPerspective(45.0f, 1.0f, 0.1f, 100.0f);
+    camera.setPosition(glm::float3(0.0f, 0.0f, 10.0f));
+    const glm::float4x4 viewToClip = camera.getPerspective() * camera.getView();
+
+    const glm::float3 zero = glm::float3(0.0f);
+    uint32_t visibleId = scene.createInstance(meshId, matId, glm::translate(glm::float4x4(1.0f), glm::float3(0.0f, 0.0f, 0.0f)), zero);
+    uint32_t behindId = scene.createInstance(meshId, matId, glm::translate(glm::float4x4(1.0f), glm::float3(0.0f, 0.0f, 20.0f)), zero);
+    uint32_t asideId = scene.createInstance(meshId, matId, glm::translate(glm::float4x4(1.0f), glm::float3(1000.0f, 0.0f, 0.0f)), zero);
+    for (int i = 0; i < 100; ++i)
+    {
+        scene.createInstance(meshId, matId, glm::translate(glm::float4x4(1.0f), glm::float3(0.0f, 0.0f, 30.0f + i)), zero);
+    }
+
+    std::vector<uint32_t> visible = scene.getOpaqueInstancesToRender(camera.getPosition(), viewToClip);
+    CHECK(visible.size() == 1);
+    CHECK(visible[0] == visibleId);
+    CHECK(scene.getTransparentInstancesToRender(camera.getPosition(), viewToClip).empty());
+
+    // refit after transform update
+    scene.updateInstanceTransform(behindId, glm::translate(glm::float4x4(1.0f), glm::float3(0.0f, 0.0f, -5.0f)));
+    visible = scene.getOpaqueInstancesToRender(camera.getPosition(), viewToClip);
+    CHECK(visible.size() == 2);
+    CHECK(std::find(visible.begin(), visible.end(), behindId) != visible.end());
+    CHECK(std::find(visible.begin(), visible.end(), asideId) == visible.end());
+
+    scene.frustumCulling = false;
+    CHECK(scene.getOpaqueInstancesToRender(camera.getPosition(), viewToClip).size() == 103);
+}
+
+TEST_CASE("test visibility of multiple views")
+{
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> vb(3);
+    vb[0].pos = glm::float3(-1.0f, -1.0f, 0.0f);
+    vb[1].pos = glm::float3(1.0f, -1.0f, 0.0f);
+    vb[2].pos = glm::float3(0.0f, 1.0f, 0.0f);
+    std::vector<uint32_t> ib = { 0, 1, 2 };
+    uint32_t meshId = scene.createMesh(vb, ib);
+    uint32_t matId = scene.createMaterial(glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          1.0f,
+                                          1.0f,
+                                          2, 0, 0, 0, 0,
+                                          1.0f);
+
+    const glm::float3 zero = glm::float3(0.0f);
+    for (int i = 0; i < 50; ++i)
+    {
+        scene.createInstance(meshId, matId, glm::translate(glm::float4x4(1.0f), glm::float3(0.0f, 0.0f, -(float)i)), zero);
+        scene.createInstance(meshId, matId, glm::translate(glm::float4x4(1.0f), glm::float3(1000.0f, 0.0f, -(float)i)), zero);
+    }
+
+    std::vector<nevk::Scene::View> views;
+    for (int i = 0; i < 3; ++i)
+    {
+        nevk::Camera camera;
+        camera.setPerspective(45.0f, 1.0f, 0.1f, 100.0f);
+        camera.setPosition(glm::float3(i == 1 ? 1000.0f : 0.0f, 0.0f, 10.0f + i));
+        views.push_back({ camera.getPosition(), camera.getPerspective() * camera.getView() });
+    }
+
+    nevk::ThreadPool pool(2);
+    scene.setThreadPool(&pool);
+    const std::vector<nevk::Scene::VisibleInstances>& visibility = scene.computeVisibility(views);
+    REQUIRE(visibility.size() == views.size());
+    for (size_t i = 0; i < views.size(); ++i)
+    {
+        // parallel result matches single view path
+        CHECK(visibility[i].opaque.size() == 50);
+        CHECK(visibility[i].opaque == scene.getOpaqueInstancesToRender(views[i].position, views[i].viewToClip));
+        CHECK(visibility[i].transparent.empty());
+    }
+    CHECK(visibility[0].opaque != visibility[1].opaque);
+
+    scene.setThreadPool(nullptr);
+    views.pop_back();
+    CHECK(scene.computeVisibility(views).size() == 2);
+}
+
+TEST_CASE("test instance storage")
+{
+    nevk::InstanceStorage storage;
+    const uint32_t count = 13; // not multiple of SIMD width
+    storage.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        nevk::Instance inst;
+        inst.transform = glm::translate(glm::float4x4(1.0f), glm::float3((float)i, 0.0f, 0.0f));
+        inst.mMeshId = i;
+        inst.mMaterialId = count - i;
+        inst.massCenter = glm::float3((float)i, 1.0f, 2.0f);
+        storage.set(i, inst, i % 2 ? nevk::InstanceStorage::eTransparent : nevk::InstanceStorage::eNone);
+    }
+    CHECK(storage.size() == count);
+    CHECK(storage.getMeshId(5) == 5);
+    CHECK(storage.getMaterialId(5) == count - 5);
+    CHECK(storage.getFlags(5) == nevk::InstanceStorage::eTransparent);
+    CHECK(storage[7].massCenter.x == 7.0f);
+    CHECK(storage[7].transform[3][0] == 7.0f);
+
+    std::vector<float> distances(count);
+    storage.computeDistances2(glm::float3(0.0f), distances.data());
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        CHECK(distances[i] == doctest::Approx((float)(i * i) + 5.0f));
+    }
+}
+
+TEST_CASE("test radix sort")
+{
+    std::vector<uint32_t> keys = { 0x30000000, 5, 0xFFFFFFFF, 5, 0x00010000, 0 };
+    std::vector<uint32_t> values = { 0, 1, 2, 3, 4, 5 };
+    std::vector<uint32_t> tmpKeys, tmpValues;
+    nevk::radixSort(keys, values, tmpKeys, tmpValues);
+    CHECK(std::is_sorted(keys.begin(), keys.end()));
+    CHECK((values == std::vector<uint32_t>{ 5, 1, 3, 4, 0, 2 })); // stable for equal keys
+}
+
+TEST_CASE("test instance sorter")
+{
+    const uint32_t count = 1000;
+    nevk::InstanceStorage storage;
+    storage.resize(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        nevk::Instance inst;
+        inst.mMeshId = i % 3;
+        inst.mMaterialId = i % 7;
+        inst.massCenter = glm::float3((float)((i * 7919) % count), 0.0f, 0.0f);
+        storage.set(i, inst, nevk::InstanceStorage::eNone);
+    }
+    std::vector<float> distances(count);
+    auto isSorted = [&distances](const std::vector<uint32_t>& ids, bool frontToBack) {
+        for (size_t i = 1; i < ids.size(); ++i)
+        {
+            if (frontToBack ? distances[ids[i - 1]] > distances[ids[i]] : distances[ids[i - 1]] < distances[ids[i]])
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    std::vector<uint32_t> ids(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        ids[i] = i;
+    }
+
+    nevk::InstanceSorter sorter;
+    glm::float3 camPos = glm::float3(0.0f);
+    storage.computeDistances2(camPos, distances.data());
+    sorter.sort(ids, storage, distances.data(), camPos, nevk::InstanceSorter::Mode::eFrontToBack);
+    CHECK(!sorter.usedFastPath());
+    CHECK(isSorted(ids, true));
+
+    // small camera move reuses previous order
+    camPos = glm::float3(0.1f, 0.0f, 0.0f);
+    storage.computeDistances2(camPos, distances.data());
+    std::vector<uint32_t> shuffled(ids.rbegin(), ids.rend());
+    sorter.sort(shuffled, storage, distances.data(), camPos, nevk::InstanceSorter::Mode::eFrontToBack);
+    CHECK(sorter.usedFastPath());
+    CHECK(isSorted(shuffled, true));
+
+    // opposite side of scene, order changes a lot
+    camPos = glm::float3((float)count, 0.0f, 0.0f);
+    storage.computeDistances2(camPos, distances.data());
+    sorter.sort(shuffled, storage, distances.data(), camPos, nevk::InstanceSorter::Mode::eBackToFront);
+    CHECK(!sorter.usedFastPath());
+    CHECK(isSorted(shuffled, false));
+
+    sorter.sort(shuffled, storage, distances.data(), camPos, nevk::InstanceSorter::Mode::eState);
+    CHECK(shuffled.size() == count);
+    for (size_t i = 1; i < shuffled.size(); ++i)
+    {
+        const uint64_t prev = nevk::makeDrawSortKey(distances[shuffled[i - 1]], storage.getMaterialId(shuffled[i - 1]), storage.getMeshId(shuffled[i - 1]));
+        const uint64_t curr = nevk::makeDrawSortKey(distances[shuffled[i]], storage.getMaterialId(shuffled[i]), storage.getMeshId(shuffled[i]));
+        CHECK(prev <= curr);
+    }
+}
+
+TEST_CASE("test remove and compact")
+{
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> vb(3);
+    vb[0].pos = glm::float3(-1.0f, -1.0f, 0.0f);
+    vb[1].pos = glm::float3(1.0f, -1.0f, 0.0f);
+    vb[2].pos = glm::float3(0.0f, 1.0f, 0.0f);
+    std::vector<uint32_t> ib = { 0, 1, 2 };
+    uint32_t matId = scene.createMaterial(glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          1.0f,
+                                          1.0f,
+                                          2, 0, 0, 0, 0,
+                                          1.0f);
+    const glm::float3 zero = glm::float3(0.0f);
+    uint32_t firstMesh = scene.createMesh(vb, ib);
+    uint32_t secondMesh = scene.createMesh(vb, ib);
+    uint32_t thirdMesh = scene.createMesh(vb, ib);
+    uint32_t firstInst = scene.createInstance(firstMesh, matId, glm::float4x4(1.0f), zero);
+    uint32_t secondInst = scene.createInstance(thirdMesh, matId, glm::float4x4(1.0f), zero);
+    CHECK(scene.mOpaqueInstances.size() == 2);
+
+    CHECK(scene.removeInstance(firstInst));
+    CHECK(scene.mOpaqueInstances.size() == 1);
+    CHECK(scene.mOpaqueInstances[0] == nevk::Scene::handleIndex(secondInst));
+    scene.frustumCulling = false;
+    CHECK(scene.getOpaqueInstancesToRender(zero, glm::float4x4(1.0f)).size() == 1);
+
+    CHECK(scene.removeMesh(firstMesh));
+    CHECK(scene.removeMesh(secondMesh));
+    CHECK(scene.createInstance(firstMesh, matId, glm::float4x4(1.0f), zero) == nevk::Scene::kInvalidId);
+    CHECK(scene.mVertices.size() == 9);
+    CHECK(scene.needsCompaction());
+
+    scene.compactGeometry();
+    CHECK(!scene.needsCompaction());
+    CHECK(scene.mVertices.size() == 3);
+    CHECK(scene.mIndices.size() == 3);
+    const nevk::Mesh& mesh = scene.mMeshes[nevk::Scene::handleIndex(thirdMesh)];
+    CHECK(mesh.mIndex == 0);
+    CHECK(mesh.mVertexOffset == 0);
+    CHECK((scene.mIndices == ib));
+}
+
+TEST_CASE("test remove and recreate mesh")
+{
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> small(3);
+    std::vector<nevk::Scene::Vertex> large(3);
+    large[1].pos = glm::float3(10.0f, 0.0f, 0.0f);
+    std::vector<uint32_t> ib = { 0, 1, 2 };
+    uint32_t matId = scene.createMaterial(glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          1.0f,
+                                          1.0f,
+                                          2, 0, 0, 0, 0,
+                                          1.0f);
+    const glm::float3 zero = glm::float3(0.0f);
+    uint32_t usedMesh = scene.createMesh(small, ib);
+    uint32_t otherMesh = scene.createMesh(small, ib);
+    uint32_t firstInst = scene.createInstance(usedMesh, matId, glm::float4x4(1.0f), zero);
+    uint32_t secondInst = scene.createInstance(usedMesh, matId, glm::float4x4(1.0f), zero);
+    uint32_t otherInst = scene.createInstance(otherMesh, matId, glm::float4x4(1.0f), zero);
+
+    // slot of mesh with instances must not be reused by next mesh
+    CHECK(!scene.removeMesh(usedMesh));
+    CHECK(scene.isMeshValid(usedMesh));
+    CHECK(scene.removeInstance(firstInst));
+    CHECK(!scene.removeMesh(usedMesh));
+    CHECK(scene.removeInstance(secondInst));
+    CHECK(scene.removeMesh(usedMesh));
+
+    uint32_t newMesh = scene.createMesh(large, ib);
+    CHECK(nevk::Scene::handleIndex(newMesh) == nevk::Scene::handleIndex(usedMesh));
+    CHECK(scene.createInstance(usedMesh, matId, glm::float4x4(1.0f), zero) == nevk::Scene::kInvalidId);
+    uint32_t newInst = scene.createInstance(newMesh, matId, glm::float4x4(1.0f), zero);
+    CHECK(scene.getInstances().getMeshId(nevk::Scene::handleIndex(newInst)) == nevk::Scene::handleIndex(newMesh));
+    // surviving instance keeps its mesh
+    CHECK(scene.isInstanceValid(otherInst));
+    CHECK(scene.getInstances().getMeshId(nevk::Scene::handleIndex(otherInst)) == nevk::Scene::handleIndex(otherMesh));
+    CHECK(scene.removeInstance(newInst));
+    CHECK(scene.removeMesh(newMesh));
+}
+
+TEST_CASE("test remove and recreate material")
+{
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> vb(3);
+    std::vector<uint32_t> ib = { 0, 1, 2 };
+    auto createMaterial = [&scene](const uint32_t illum) {
+        return scene.createMaterial(glm::float4(1.0),
+                                    glm::float4(1.0),
+                                    glm::float4(1.0),
+                                    glm::float4(1.0),
+                                    glm::float4(1.0),
+                                    1.0f,
+                                    1.0f,
+                                    illum, 0, 0, 0, 0,
+                                    1.0f);
+    };
+    const glm::float3 zero = glm::float3(0.0f);
+    uint32_t meshId = scene.createMesh(vb, ib);
+    uint32_t opaqueMat = createMaterial(2);
+    uint32_t otherMat = createMaterial(2);
+    uint32_t firstInst = scene.createInstance(meshId, opaqueMat, glm::float4x4(1.0f), zero);
+    uint32_t secondInst = scene.createInstance(meshId, opaqueMat, glm::float4x4(1.0f), zero);
+    uint32_t otherInst = scene.createInstance(meshId, otherMat, glm::float4x4(1.0f), zero);
+
+    // slot of material with instances must not be reused by next material
+    CHECK(!scene.removeMaterial(opaqueMat));
+    CHECK(scene.isMaterialValid(opaqueMat));
+    CHECK(scene.removeInstance(firstInst));
+    CHECK(!scene.removeMaterial(opaqueMat));
+    CHECK(scene.removeInstance(secondInst));
+    CHECK(scene.removeMaterial(opaqueMat));
+
+    // reused slot is transparent, instance created with it goes to transparent list
+    uint32_t transparentMat = createMaterial(1);
+    CHECK(nevk::Scene::handleIndex(transparentMat) == nevk::Scene::handleIndex(opaqueMat));
+    CHECK(scene.createInstance(meshId, opaqueMat, glm::float4x4(1.0f), zero) == nevk::Scene::kInvalidId);
+    uint32_t newInst = scene.createInstance(meshId, transparentMat, glm::float4x4(1.0f), zero);
+    CHECK(scene.getInstances().getMaterialId(nevk::Scene::handleIndex(newInst)) == nevk::Scene::handleIndex(transparentMat));
+    CHECK((scene.getInstances().getFlags(nevk::Scene::handleIndex(newInst)) & nevk::InstanceStorage::eTransparent) != 0);
+    // surviving instance keeps its opaque material
+    CHECK(scene.isInstanceValid(otherInst));
+    CHECK(scene.getInstances().getMaterialId(nevk::Scene::handleIndex(otherInst)) == nevk::Scene::handleIndex(otherMat));
+    CHECK((scene.getInstances().getFlags(nevk::Scene::handleIndex(otherInst)) & nevk::InstanceStorage::eTransparent) == 0);
+    CHECK(scene.removeInstance(newInst));
+    CHECK(scene.removeMaterial(transparentMat));
+    CHECK(scene.removeMesh(meshId) == false);
+    CHECK(scene.removeInstance(otherInst));
+    CHECK(scene.removeMaterial(otherMat));
+    CHECK(scene.removeMesh(meshId));
+}
+
+TEST_CASE("test handle generation wrap")
+{
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> vb;
+    std::vector<uint32_t> ib;
+    const uint32_t first = scene.createMesh(vb, ib);
+    std::vector<uint32_t> stale = { first };
+    uint32_t current = first;
+    for (uint32_t i = 0; i < 300; ++i)
+    {
+        CHECK(scene.removeMesh(current));
+        current = scene.createMesh(vb, ib);
+        stale.push_back(current);
+    }
+    // slot is retired instead of wrapping back to generation of old handles
+    bool staleRejected = true;
+    for (size_t i = 0; i + 1 < stale.size(); ++i)
+    {
+        staleRejected &= !scene.isMeshValid(stale[i]);
+    }
+    CHECK(staleRejected);
+    CHECK(scene.isMeshValid(current));
+    CHECK(nevk::Scene::handleIndex(current) != nevk::Scene::handleIndex(first));
+    CHECK(scene.getMeshes().size() == 2);
+}
+
+TEST_CASE("test transform hierarchy")
+{
+    nevk::Scene scene;
+    nevk::ThreadPool pool(2);
+    scene.setThreadPool(&pool);
+
+    std::vector<nevk::Scene::Vertex> vb(1);
+    std::vector<uint32_t> ib = { 0, 0, 0 };
+    uint32_t meshId = scene.createMesh(vb, ib);
+    uint32_t matId = scene.createMaterial(glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          1.0f,
+                                          1.0f,
+                                          2, 0, 0, 0, 0,
+                                          1.0f);
+
+    const glm::float4x4 offset = glm::translate(glm::float4x4(1.0f), glm::float3(1.0f, 0.0f, 0.0f));
+    uint32_t root = scene.createNode(nevk::TransformHierarchy::kInvalidNode, glm::float4x4(1.0f));
+    uint32_t child = scene.createNode(root, offset);
+    uint32_t grandChild = scene.createNode(child, offset);
+    CHECK(scene.getHierarchy().getWorldTransform(grandChild)[3][0] == 2.0f);
+
+    // wide level to go through parallel path
+    std::vector<uint32_t> leaves;
+    for (uint32_t i = 0; i < 5000; ++i)
+    {
+        leaves.push_back(scene.createNode(child, offset));
+    }
+
+    uint32_t instId = scene.createInstance(meshId, matId, scene.getHierarchy().getWorldTransform(grandChild), glm::float3(0.0f));
+    scene.attachInstance(grandChild, instId);
+
+    scene.setNodeLocalTransform(root, glm::translate(glm::float4x4(1.0f), glm::float3(0.0f, 5.0f, 0.0f)));
+    scene.setNodeLocalTransform(grandChild, offset); // dirty descendant of dirty node
+    scene.updateTransforms();
+    CHECK(scene.getHierarchy().getWorldTransform(grandChild)[3][0] == 2.0f);
+    CHECK(scene.getHierarchy().getWorldTransform(grandChild)[3][1] == 5.0f);
+    CHECK(scene.getInstances().getTransform(instId)[3][1] == 5.0f);
+    CHECK(scene.getDirtyInstances().count(instId) == 1);
+    bool leavesUpdated = true;
+    for (const uint32_t leaf : leaves)
+    {
+        const glm::float4x4& world = scene.getHierarchy().getWorldTransform(leaf);
+        leavesUpdated = leavesUpdated && world[3][0] == 2.0f && world[3][1] == 5.0f;
+    }
+    CHECK(leavesUpdated);
+
+    // only subtree of changed node is recomputed
+    nevk::TransformHierarchy hierarchy;
+    uint32_t a = hierarchy.createNode(nevk::TransformHierarchy::kInvalidNode, glm::float4x4(1.0f));
+    uint32_t b = hierarchy.createNode(a, offset);
+    hierarchy.createNode(a, offset);
+    hierarchy.setLocalTransform(b, offset);
+    CHECK(hierarchy.update(nullptr).size() == 1);
+    CHECK(hierarchy.update(nullptr).empty());
+}
+
+TEST_CASE("test mesh deduplication")
+{
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> vb(3);
+    vb[0].pos = glm::float3(-1.0f, -1.0f, 0.0f);
+    vb[1].pos = glm::float3(1.0f, -1.0f, 0.0f);
+    vb[2].pos = glm::float3(0.0f, 1.0f, 0.0f);
+    std::vector<uint32_t> ib = { 0, 1, 2 };
+
+    uint32_t first = scene.getOrCreateMesh(vb, ib);
+    uint32_t second = scene.getOrCreateMesh(vb, ib);
+    CHECK(first == second);
+    CHECK(scene.mVertices.size() == 3);
+    CHECK(scene.mIndices.size() == 3);
+
+    std::vector<uint32_t> flipped = { 0, 2, 1 };
+    uint32_t third = scene.getOrCreateMesh(vb, flipped);
+    CHECK(third != first);
+    CHECK(scene.getOrCreateMesh(vb, flipped) == third); // indices rebased by vertex offset still match
+    CHECK(scene.mVertices.size() == 6);
+
+    scene.removeMesh(first);
+    uint32_t fourth = scene.getOrCreateMesh(vb, ib);
+    CHECK(fourth != first);
+    CHECK(scene.isMeshValid(fourth));
+}
+
+TEST_CASE("test bulk mesh creation")
+{
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> vb(5);
+    for (uint32_t i = 0; i < vb.size(); ++i)
+    {
+        vb[i].pos = glm::float3((float)i, 0.0f, 0.0f);
+    }
+    std::vector<uint32_t> ib = { 0, 1, 2, 2, 3, 4, 4, 0, 1 }; // not multiple of SIMD width
+
+    // moved in buffers are taken over by empty scene
+    std::vector<nevk::Scene::Vertex> movedVb = vb;
+    std::vector<uint32_t> movedIb = ib;
+    const nevk::Scene::Vertex* movedData = movedVb.data();
+    const size_t movedCapacity = movedVb.capacity();
+    uint32_t first = scene.createMesh(std::move(movedVb), std::move(movedIb));
+    CHECK(scene.mVertices.data() == movedData);
+    CHECK(scene.mVertices.capacity() == movedCapacity);
+    CHECK(scene.mMeshes[first].mCount == ib.size());
+    CHECK(scene.mMeshes[first].mBounds.maximum.x == 4.0f);
+
+    // reserved storage is kept, moved buffers are appended into it without reallocation
+    {
+        nevk::Scene reserved;
+        reserved.reserveGeometry(64, 64);
+        const nevk::Scene::Vertex* reservedData = reserved.mVertices.data();
+        const size_t reservedCapacity = reserved.mVertices.capacity();
+        std::vector<nevk::Scene::Vertex> vbCopy = vb;
+        std::vector<uint32_t> ibCopy = ib;
+        reserved.createMesh(std::move(vbCopy), std::move(ibCopy));
+        // copied into reserved storage, moved buffers are released
+        CHECK(vbCopy.capacity() == 0);
+        CHECK(ibCopy.capacity() == 0);
+        reserved.createMesh(vb, ib);
+        CHECK(reserved.mVertices.data() == reservedData);
+        CHECK(reserved.mVertices.capacity() == reservedCapacity);
+        CHECK(reserved.mIndices.capacity() >= 64);
+        CHECK(reserved.mVertices.size() == 2 * vb.size());
+        CHECK(reserved.mIndices[ib.size()] == ib[0] + vb.size());
+    }
+
+    std::vector<nevk::Scene::MeshView> views = {
+        { vb.data(), vb.size(), ib.data(), ib.size() },
+        { vb.data() + 1, 3, ib.data(), 3 },
+    };
+    std::vector<uint32_t> ids = scene.createMeshes(views);
+    CHECK(ids.size() == 2);
+    CHECK(scene.mVertices.size() == 13);
+    CHECK(scene.mIndices.size() == 21);
+    const nevk::Mesh& second = scene.mMeshes[ids[0]];
+    CHECK(second.mVertexOffset == 5);
+    CHECK(second.mIndex == 9);
+    bool rebased = true;
+    for (uint32_t i = 0; i < ib.size(); ++i)
+    {
+        rebased = rebased && scene.mIndices[second.mIndex + i] == ib[i] + 5;
+    }
+    CHECK(rebased);
+    const nevk::Mesh& third = scene.mMeshes[ids[1]];
+    CHECK(scene.mIndices[third.mIndex] == 10);
+    CHECK(third.mBounds.minimum.x == 1.0f);
+    CHECK(third.mBounds.maximum.x == 3.0f);
+}
+
+TEST_CASE("test scene snapshot")
+{
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> vb(4);
+    for (uint32_t i = 0; i < vb.size(); ++i)
+    {
+        vb[i].pos = glm::float3((float)i, 1.0f, 2.0f);
+        vb[i].normal = i;
+    }
+    std::vector<uint32_t> ib = { 0, 1, 2, 2, 3, 0 };
+    const uint32_t firstMesh = scene.createMesh(vb, ib);
+    const uint32_t secondMesh = scene.createMesh(vb, std::vector<uint32_t>{ 0, 1, 2 });
+    nevk::Scene::Material material{};
+    material.illum = 1; // transparent
+    material.texBaseColor = 0;
+    const uint32_t matId = scene.addMaterial(material);
+    scene.createInstance(firstMesh, matId, glm::translate(glm::float4x4(1.0f), glm::float3(5.0f, 0.0f, 0.0f)), glm::float3(5.0f, 0.0f, 0.0f));
+    const uint32_t removed = scene.createInstance(firstMesh, matId, glm::float4x4(1.0f), glm::float3(0.0f));
+    scene.createInstance(secondMesh, matId, glm::float4x4(1.0f), glm::float3(1.0f));
+    scene.removeInstance(removed);
+    nevk::Camera camera;
+    camera.name = "snapshot camera";
+    camera.setPosition(glm::float3(1.0f, 2.0f, 3.0f));
+    scene.addCamera(camera);
+    scene.mLightPosition = glm::float4(1.0f, 2.0f, 3.0f, 1.0f);
+    scene.mTexturePaths = { "", "textures/albedo.png" };
+
+    const std::string path = (std::filesystem::temp_directory_path() / "nevk_test_snapshot.nevk").string();
+    REQUIRE(nevk::SceneSnapshot::save(scene, path));
+
+    {
+        nevk::Scene loaded;
+        REQUIRE(nevk::SceneSnapshot::load(path, loaded));
+        // geometry is used in place, not copied
+        CHECK(loaded.hasMappedGeometry());
+        CHECK(loaded.mVertices.empty());
+        REQUIRE(loaded.getVertexCount() == scene.mVertices.size());
+        REQUIRE(loaded.getIndexCount() == scene.mIndices.size());
+        CHECK(memcmp(loaded.getVertexData(), scene.mVertices.data(), scene.mVertices.size() * sizeof(nevk::Scene::Vertex)) == 0);
+        CHECK(std::equal(scene.mIndices.begin(), scene.mIndices.end(), loaded.getIndexData()));
+
+        CHECK(loaded.mMeshes.size() == 2);
+        CHECK(loaded.mMeshes[1].mCount == 3);
+        CHECK(loaded.mMeshes[1].mVertexOffset == 4);
+        CHECK(loaded.mMaterials.size() == 1);
+        CHECK(loaded.mMaterials[0].texBaseColor == 0);
+        REQUIRE(loaded.mInstances.size() == 2); // removed instance is not stored
+        CHECK(loaded.mInstances.getMeshId(0) == 0);
+        CHECK(loaded.mInstances.getMeshId(1) == 1);
+        CHECK(loaded.mInstances.getTransform(0)[3][0] == 5.0f);
+        CHECK(loaded.mTransparentInstances.size() == 2);
+        REQUIRE(loaded.getCameraCount() == 1);
+        CHECK(loaded.getCamera(0).name == "snapshot camera");
+        CHECK(loaded.getCamera(0).getPosition().z == 3.0f);
+        CHECK(loaded.mLightPosition.y == 2.0f);
+        REQUIRE(loaded.mTexturePaths.size() == 2);
+        CHECK(loaded.mTexturePaths[0].empty());
+        CHECK(std::filesystem::path(loaded.mTexturePaths[1]).filename() == "albedo.png");
+
+        // modification copies geometry out of mapping
+        const uint32_t added = loaded.createMesh(vb, ib);
+        CHECK(!loaded.hasMappedGeometry());
+        CHECK(loaded.mVertices.size() == 12);
+        CHECK(loaded.mIndices[loaded.mMeshes[added].mIndex] == 8);
+        CHECK(loaded.mIndices[loaded.mMeshes[1].mIndex + 2] == 6);
+    }
+
+    nevk::Scene broken;
+    CHECK(!nevk::SceneSnapshot::load(path + ".missing", broken));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("test mesh optimization")
+{
+    // grid with shuffled triangles
+    const uint32_t size = 32;
+    std::vector<nevk::Scene::Vertex> vertices(size * size);
+    for (uint32_t i = 0; i < vertices.size(); ++i)
+    {
+        vertices[i].pos = glm::float3((float)(i % size), (float)(i / size), 0.0f);
+    }
+    std::vector<std::vector<uint32_t>> triangles;
+    for (uint32_t y = 0; y + 1 < size; ++y)
+    {
+        for (uint32_t x = 0; x + 1 < size; ++x)
+        {
+            const uint32_t v = y * size + x;
+            triangles.push_back({ v, v + 1, v + size });
+            triangles.push_back({ v + 1, v + size + 1, v + size });
+        }
+    }
+    uint32_t seed = 1;
+    for (size_t i = triangles.size() - 1; i > 0; --i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        std::swap(triangles[i], triangles[seed % (i + 1)]);
+    }
+    std::vector<uint32_t> indices;
+    for (const std::vector<uint32_t>& triangle : triangles)
+    {
+        indices.insert(indices.end(), triangle.begin(), triangle.end());
+    }
+
+    // triangles with winding kept, independent of order and first corner
+    auto canonical = [](const std::vector<nevk::Scene::Vertex>& vb, const std::vector<uint32_t>& ib) {
+        std::vector<std::vector<float>> result;
+        for (size_t t = 0; t < ib.size(); t += 3)
+        {
+            std::vector<float> rotations[3];
+            for (size_t first = 0; first < 3; ++first)
+            {
+                for (size_t k = 0; k < 3; ++k)
+                {
+                    const glm::float3& pos = vb[ib[t + (first + k) % 3]].pos;
+                    rotations[first].insert(rotations[first].end(), { pos.x, pos.y });
+                }
+            }
+            result.push_back(*std::min_element(rotations, rotations + 3));
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+    const std::vector<std::vector<float>> original = canonical(vertices, indices);
+
+    const nevk::VertexCacheStats before = nevk::analyzeVertexCache(indices, vertices.size());
+    CHECK(before.triangles == triangles.size());
+    CHECK(before.vertices == vertices.size());
+
+    nevk::optimizeVertexCache(indices, vertices.size());
+    const nevk::VertexCacheStats optimized = nevk::analyzeVertexCache(indices, vertices.size());
+    CHECK(optimized.acmr() < 0.5f * before.acmr());
+    CHECK(optimized.atvr() < 1.5f);
+    CHECK(canonical(vertices, indices) == original);
+
+    nevk::optimizeOverdraw(vertices, indices, 1.05f);
+    CHECK(nevk::analyzeVertexCache(indices, vertices.size()).acmr() < 0.5f * before.acmr());
+    CHECK(canonical(vertices, indices) == original);
+
+    CHECK(nevk::optimizeVertexFetch(vertices, indices) == size * size);
+    uint32_t nextNew = 0;
+    bool firstUseOrder = true;
+    for (const uint32_t index : indices)
+    {
+        firstUseOrder &= index <= nextNew;
+        nextNew = std::max(nextNew, index + 1);
+    }
+    CHECK(firstUseOrder);
+    CHECK(canonical(vertices, indices) == original);
+}
+
+TEST_CASE("test meshlets")
+{
+    const uint32_t size = 32;
+    std::vector<nevk::Scene::Vertex> vb(size * size);
+    for (uint32_t i = 0; i < vb.size(); ++i)
+    {
+        vb[i].pos = glm::float3((float)(i % size) / size, (float)(i / size) / size, 0.0f);
+    }
+    std::vector<uint32_t> ib;
+    for (uint32_t y = 0; y + 1 < size; ++y)
+    {
+        for (uint32_t x = 0; x + 1 < size; ++x)
+        {
+            const uint32_t v = y * size + x;
+            ib.insert(ib.end(), { v, v + 1, v + size, v + 1, v + size + 1, v + size });
+        }
+    }
+    auto sortedTriangles = [](const std::vector<uint32_t>& indices) {
+        std::vector<std::vector<uint32_t>> result;
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            // rotate smallest index first, winding is kept
+            const size_t first = std::min_element(indices.begin() + t, indices.begin() + t + 3) - (indices.begin() + t);
+            result.push_back({ indices[t + first], indices[t + (first + 1) % 3], indices[t + (first + 2) % 3] });
+        }
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+    const std::vector<std::vector<uint32_t>> original = sortedTriangles(ib);
+
+    std::vector<nevk::Meshlet> meshlets;
+    nevk::buildMeshlets(vb, ib, meshlets);
+    CHECK(sortedTriangles(ib) == original);
+    CHECK(meshlets.size() < original.size() / 64);
+    uint32_t next = 0;
+    bool valid = true;
+    for (const nevk::Meshlet& meshlet : meshlets)
+    {
+        std::vector<uint32_t> distinct(ib.begin() + meshlet.mIndex, ib.begin() + meshlet.mIndex + meshlet.mCount);
+        std::sort(distinct.begin(), distinct.end());
+        distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+        valid &= meshlet.mIndex == next && meshlet.mCount % 3 == 0 && meshlet.mCount / 3 <= nevk::kMeshletMaxTriangles;
+        valid &= meshlet.mVertexCount == distinct.size() && distinct.size() <= nevk::kMeshletMaxVertices;
+        for (const uint32_t v : distinct)
+        {
+            valid &= glm::length(vb[v].pos - glm::float3(meshlet.mBoundingSphere)) <= meshlet.mBoundingSphere.w * 1.0001f;
+        }
+        // flat grid facing +z
+        valid &= meshlet.mCone.z > 0.999f && meshlet.mCone.w < 0.01f;
+        next = meshlet.mIndex + meshlet.mCount;
+    }
+    CHECK(valid);
+    CHECK(next == ib.size());
+
+    // cache order inside meshlets keeps triangles of every range
+    const std::vector<uint32_t> clustered = ib;
+    nevk::optimizeMeshletVertexCache(ib, vb.size(), meshlets);
+    bool sameRanges = true;
+    for (const nevk::Meshlet& meshlet : meshlets)
+    {
+        const std::vector<uint32_t> before(clustered.begin() + meshlet.mIndex, clustered.begin() + meshlet.mIndex + meshlet.mCount);
+        const std::vector<uint32_t> after(ib.begin() + meshlet.mIndex, ib.begin() + meshlet.mIndex + meshlet.mCount);
+        sameRanges &= sortedTriangles(before) == sortedTriangles(after);
+    }
+    CHECK(sameRanges);
+    CHECK(nevk::analyzeVertexCache(ib, vb.size()).acmr() <= nevk::analyzeVertexCache(clustered, vb.size()).acmr());
+
+    nevk::Scene scene;
+    uint32_t matId = scene.createMaterial(glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          1.0f,
+                                          1.0f,
+                                          2, 0, 0, 0, 0,
+                                          1.0f);
+    std::vector<nevk::Scene::Vertex> triangleVb(vb.begin(), vb.begin() + 3);
+    std::vector<uint32_t> triangleIb = { 0, 1, 2 };
+    uint32_t removedMesh = scene.createMesh(triangleVb, triangleIb);
+    CHECK(scene.setMeshlets(removedMesh, { nevk::Meshlet{ glm::float4(0.0f), glm::float4(0.0f, 0.0f, 1.0f, 1.0f), 0, 3, 3, 0 } }));
+    uint32_t meshId = scene.createMesh(vb, ib);
+    CHECK(!scene.setMeshlets(meshId, { nevk::Meshlet{ glm::float4(0.0f), glm::float4(0.0f), (uint32_t)ib.size(), 3, 3, 0 } }));
+    CHECK(scene.setMeshlets(meshId, meshlets));
+    CHECK(scene.getMeshlets().size() == meshlets.size() + 1);
+
+    const glm::float3 zero = glm::float3(0.0f);
+    uint32_t frontId = scene.createInstance(meshId, matId, glm::float4x4(1.0f), zero);
+    // rotated by 180 degrees around y, back faces camera
+    glm::float4x4 flip(1.0f);
+    flip[0][0] = -1.0f;
+    flip[2][2] = -1.0f;
+    uint32_t backId = scene.createInstance(meshId, matId, flip, zero);
+    uint32_t asideId = scene.createInstance(meshId, matId, glm::translate(glm::float4x4(1.0f), glm::float3(1000.0f, 0.0f, 0.0f)), zero);
+
+    nevk::Camera camera;
+    camera.setPerspective(45.0f, 1.0f, 0.1f, 100.0f);
+    camera.setPosition(glm::float3(0.0f, 0.0f, 10.0f));
+    const nevk::Scene::View view = { camera.getPosition(), camera.getPerspective() * camera.getView() };
+    std::vector<uint32_t> visible;
+    scene.getVisibleMeshlets(frontId, view, visible);
+    CHECK(visible.size() == meshlets.size());
+    scene.getVisibleMeshlets(backId, view, visible);
+    CHECK(visible.empty());
+    scene.getVisibleMeshlets(asideId, view, visible);
+    CHECK(visible.empty());
+    // rotated away from camera and squashed along x: rotated cone axis would face away, actual normal faces aside
+    // scale(0.01, 1, 1) * rotation by 225 degrees around y
+    const float halfSqrt2 = 0.70710678f;
+    glm::float4x4 squashed(1.0f);
+    squashed[0] = glm::float4(-0.01f * halfSqrt2, 0.0f, halfSqrt2, 0.0f);
+    squashed[2] = glm::float4(-0.01f * halfSqrt2, 0.0f, -halfSqrt2, 0.0f);
+    uint32_t squashedId = scene.createInstance(meshId, matId, squashed, zero);
+    scene.getVisibleMeshlets(squashedId, view, visible);
+    CHECK(visible.size() == meshlets.size());
+    // uniform scale keeps cone culling
+    uint32_t scaledBackId = scene.createInstance(meshId, matId, glm::scale(flip, glm::float3(2.0f)), zero);
+    scene.getVisibleMeshlets(scaledBackId, view, visible);
+    CHECK(visible.empty());
+
+    CHECK(scene.removeMesh(removedMesh));
+    scene.compactGeometry();
+    CHECK(scene.getMeshlets().size() == meshlets.size());
+    const nevk::Mesh& mesh = scene.mMeshes[nevk::Scene::handleIndex(meshId)];
+    CHECK(mesh.mMeshletOffset == 0);
+    CHECK(mesh.mMeshletCount == meshlets.size());
+    scene.getVisibleMeshlets(frontId, view, visible);
+    CHECK(visible.size() == meshlets.size());
+}
+
+TEST_CASE("test mesh lods")
+{
+    // height field, left and right halves have own vertices along x = 0.5 with different UVs
+    const uint32_t size = 33;
+    auto height = [](const float x, const float y) { return 0.05f * std::sin(x * 6.0f) * std::cos(y * 4.0f); };
+    std::vector<nevk::Scene::Vertex> vb;
+    std::vector<uint32_t> grid(size * size);
+    std::vector<uint32_t> seamRight(size);
+    for (uint32_t i = 0; i < size * size; ++i)
+    {
+        const float x = (float)(i % size) / (size - 1);
+        const float y = (float)(i / size) / (size - 1);
+        nevk::Scene::Vertex vertex{};
+        vertex.pos = glm::float3(x, y, height(x, y));
+        grid[i] = (uint32_t)vb.size();
+        vb.push_back(vertex);
+        if (i % size == size / 2)
+        {
+            vertex.uv = 1;
+            seamRight[i / size] = (uint32_t)vb.size();
+            vb.push_back(vertex);
+        }
+    }
+    std::vector<uint32_t> ib;
+    for (uint32_t y = 0; y + 1 < size; ++y)
+    {
+        for (uint32_t x = 0; x + 1 < size; ++x)
+        {
+            auto corner = [&](const uint32_t cx, const uint32_t cy) {
+                return cx == size / 2 && x >= size / 2 ? seamRight[cy] : grid[cy * size + cx];
+            };
+            ib.insert(ib.end(), { corner(x, y), corner(x + 1, y), corner(x, y + 1) });
+            ib.insert(ib.end(), { corner(x + 1, y), corner(x + 1, y + 1), corner(x, y + 1) });
+        }
+    }
+
+    float error = 0.0f;
+    std::vector<uint32_t> simplified = nevk::simplifyMesh(vb, ib, ib.size() / 4, 1.0f, error);
+    CHECK(simplified.size() <= ib.size() / 4);
+    CHECK(error > 0.0f);
+    bool facesUp = true;
+    for (size_t i = 0; i < simplified.size(); i += 3)
+    {
+        const glm::float3& p0 = vb[simplified[i]].pos;
+        facesUp &= glm::cross(vb[simplified[i + 1]].pos - p0, vb[simplified[i + 2]].pos - p0).z > 0.0f;
+    }
+    CHECK(facesUp);
+    // seam vertices stay, both sides keep own UVs
+    bool seamKept = true;
+    for (uint32_t y = 0; y < size; ++y)
+    {
+        seamKept &= std::count(simplified.begin(), simplified.end(), grid[y * size + size / 2]) > 0;
+        seamKept &= std::count(simplified.begin(), simplified.end(), seamRight[y]) > 0;
+    }
+    CHECK(seamKept);
+
+    // error limit is respected
+    std::vector<uint32_t> limited = nevk::simplifyMesh(vb, ib, 0, 0.0001f, error);
+    CHECK(error <= 0.0001f);
+    CHECK(limited.size() < ib.size());
+    CHECK(limited.size() > simplified.size());
+
+    const std::vector<nevk::Scene::LodGeometry> lods = nevk::buildLodChain(vb, ib);
+    REQUIRE(lods.size() >= 2);
+    CHECK(lods.size() <= nevk::kMaxMeshLods);
+    for (size_t i = 1; i < lods.size(); ++i)
+    {
+        CHECK(lods[i].indices.size() < lods[i - 1].indices.size());
+        CHECK(lods[i].error >= lods[i - 1].error);
+    }
+
+    nevk::Scene scene;
+    uint32_t matId = scene.createMaterial(glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          glm::float4(1.0),
+                                          1.0f,
+                                          1.0f,
+                                          2, 0, 0, 0, 0,
+                                          1.0f);
+    std::vector<nevk::Scene::Vertex> triangleVb(vb.begin(), vb.begin() + 3);
+    std::vector<uint32_t> triangleIb = { 0, 1, 2 };
+    uint32_t removedMesh = scene.createMesh(triangleVb, triangleIb);
+    uint32_t meshId = scene.createMesh(vb, ib);
+    CHECK(!scene.setMeshLods(meshId, { nevk::Scene::LodGeometry{ { 0, 1, (uint32_t)vb.size() }, 0.0f } }));
+    CHECK(!scene.setMeshLods(meshId, std::vector<nevk::Scene::LodGeometry>(nevk::kMaxMeshLods + 1)));
+    CHECK(scene.setMeshLods(meshId, lods));
+    CHECK(scene.mMeshes[nevk::Scene::handleIndex(meshId)].mLodCount == lods.size());
+
+    const glm::float3 zero = glm::float3(0.0f);
+    uint32_t instId = scene.createInstance(meshId, matId, glm::float4x4(1.0f), zero);
+    const uint32_t instIndex = nevk::Scene::handleIndex(instId);
+    nevk::Camera camera;
+    camera.setPerspective(45.0f, 1.0f, 0.1f, 10000.0f);
+    const float pixelScale = camera.getPixelScale(1080.0f);
+    const glm::float3 near = glm::float3(0.5f, 0.5f, 0.5f);
+    const glm::float3 far = glm::float3(0.5f, 0.5f, 5000.0f);
+    CHECK(scene.selectLod(instIndex, near, pixelScale, scene.lodPixelError) == 0);
+    CHECK(scene.selectLod(instIndex, far, pixelScale, scene.lodPixelError) == lods.size());
+    CHECK(scene.selectLod(instIndex, far, pixelScale, 0.0f) == 0);
+    const glm::float3 middle = glm::float3(0.5f, 0.5f, lods.back().error * pixelScale / scene.lodPixelError * 0.5f);
+    CHECK(scene.selectLod(instIndex, middle, pixelScale, scene.lodPixelError) < lods.size());
+    CHECK(scene.selectLod(instIndex, middle, pixelScale, scene.shadowLodPixelError) >= scene.selectLod(instIndex, middle, pixelScale, scene.lodPixelError));
+    // scaled instance shows larger error from same distance
+    uint32_t scaledId = scene.createInstance(meshId, matId, glm::scale(glm::float4x4(1.0f), glm::float3(100.0f)), zero);
+    CHECK(scene.selectLod(nevk::Scene::handleIndex(scaledId), glm::float3(50.0f, 50.0f, 500.0f), pixelScale, scene.lodPixelError) < lods.size());
+
+    // levels survive compaction, rebased to new vertex range
+    CHECK(scene.removeMesh(removedMesh));
+    scene.compactGeometry();
+    const nevk::Mesh& mesh = scene.mMeshes[nevk::Scene::handleIndex(meshId)];
+    CHECK(mesh.mVertexOffset == 0);
+    bool rebased = true;
+    for (uint32_t l = 0; l < mesh.mLodCount; ++l)
+    {
+        uint32_t indexOffset;
+        uint32_t indexCount;
+        nevk::Scene::getLodRange(mesh, l + 1, indexOffset, indexCount);
+        rebased &= std::equal(lods[l].indices.begin(), lods[l].indices.end(), scene.mIndices.begin() + indexOffset) && indexCount == lods[l].indices.size();
+    }
+    CHECK(rebased);
+    CHECK(scene.mIndices.size() == ib.size() + std::accumulate(lods.begin(), lods.end(), (size_t)0, [](size_t sum, const nevk::Scene::LodGeometry& lod) { return sum + lod.indices.size(); }));
+}
+
+TEST_CASE("test gpu index buffers")
+{
+    // small meshes around big one, last small mesh has simplified level stored after all meshes
+    nevk::Scene scene;
+    std::vector<nevk::Scene::Vertex> quad(4);
+    std::vector<nevk::Scene::Vertex> big(70000);
+    for (uint32_t i = 0; i < big.size(); ++i)
+    {
+        big[i].pos = glm::float3((float)i, 0.0f, 0.0f);
+    }
+    const uint32_t first = scene.createMesh(quad, { 0, 1, 2, 0, 2, 3 });
+    const uint32_t removed = scene.createMesh(quad, { 3, 2, 1 });
+    const uint32_t bigMesh = scene.createMesh(big, { 0, 1, 69999, 69998, 65536, 2 });
+    const uint32_t last = scene.createMesh(quad, { 1, 2, 3, 1, 3, 0 });
+    CHECK(scene.setMeshLods(last, { nevk::Scene::LodGeometry{ { 1, 2, 3 }, 0.5f } }));
+    CHECK(scene.removeMesh(removed));
+
+    const std::vector<nevk::Mesh>& meshes = scene.getMeshes();
+    const nevk::GpuIndices gpu = nevk::buildGpuIndices(meshes, scene.getIndexData(), scene.getIndexCount());
+    REQUIRE(gpu.draws.size() == meshes.size());
+    CHECK(gpu.draws[nevk::Scene::handleIndex(first)].index16);
+    CHECK(gpu.draws[nevk::Scene::handleIndex(last)].index16);
+    CHECK(!gpu.draws[nevk::Scene::handleIndex(bigMesh)].index16);
+    CHECK(gpu.draws[nevk::Scene::handleIndex(removed)].indexCount[0] == 0);
+    CHECK(gpu.indices16.size() == 6 + 6 + 3);
+    CHECK(gpu.indices32.size() == 6);
+
+    // local index plus base vertex gives scene index for every level
+    bool same = true;
+    for (size_t m = 0; m < meshes.size(); ++m)
+    {
+        const nevk::MeshDraw& draw = gpu.draws[m];
+        CHECK(draw.vertexOffset == (int32_t)meshes[m].mVertexOffset);
+        for (uint32_t lod = 0; lod <= meshes[m].mLodCount; ++lod)
+        {
+            uint32_t indexOffset;
+            uint32_t indexCount;
+            nevk::Scene::getLodRange(meshes[m], lod, indexOffset, indexCount);
+            CHECK(draw.indexCount[lod] == indexCount);
+            for (uint32_t i = 0; i < draw.indexCount[lod]; ++i)
+            {
+                const uint32_t local = draw.index16 ? gpu.indices16[draw.firstIndex[lod] + i] : gpu.indices32[draw.firstIndex[lod] + i];
+                same &= local + draw.vertexOffset == scene.getIndexData()[indexOffset + i];
+            }
+        }
+    }
+    CHECK(same);
+    // levels follow their mesh, so streamed prefix of meshes is prefix of buffers
+    const nevk::MeshDraw& lastDraw = gpu.draws[nevk::Scene::handleIndex(last)];
+    CHECK(lastDraw.firstIndex[1] == lastDraw.firstIndex[0] + lastDraw.indexCount[0]);
+    CHECK(lastDraw.firstIndex[0] == gpu.draws[nevk::Scene::handleIndex(first)].indexCount[0]);
+}
+
+TEST_CASE("test position stream")
+{
+    std::vector<nevk::Scene::Vertex> vertices(5);
+    std::vector<nevk::CompactVertex> compact(5);
+    for (uint16_t i = 0; i < vertices.size(); ++i)
+    {
+        vertices[i].pos = glm::float3(i, i * 2.0f, -1.0f * i);
+        vertices[i].normal = 7;
+        compact[i] = nevk::CompactVertex{ { i, (uint16_t)(i + 1), (uint16_t)(i + 2) }, 9, 7, 8 };
+    }
+
+    const nevk::VertexLayoutDesc& full = nevk::getVertexLayoutDesc(nevk::VertexLayout::eFull);
+    REQUIRE(full.positionStride == sizeof(glm::float3));
+    std::vector<glm::float3> positions(vertices.size());
+    nevk::extractPositions(full, vertices.data(), vertices.size(), positions.data());
+    bool same = true;
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        same &= positions[i] == vertices[i].pos;
+    }
+    CHECK(same);
+
+    // compact positions are 4 components wide, 4th one is not used
+    const nevk::VertexLayoutDesc& layout = nevk::getVertexLayoutDesc(nevk::VertexLayout::eCompact);
+    REQUIRE(layout.positionStride == 4 * sizeof(uint16_t));
+    std::vector<uint16_t> compactPositions(compact.size() * 4);
+    nevk::extractPositions(layout, compact.data(), compact.size(), compactPositions.data());
+    for (size_t i = 0; i < compact.size(); ++i)
+    {
+        same &= memcmp(&compactPositions[i * 4], compact[i].pos, sizeof(compact[i].pos)) == 0;
+    }
+    CHECK(same);
+}